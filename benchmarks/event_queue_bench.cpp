@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include "event_queue.h"
+
+using namespace poolsim;
+
+
+// Runs the classic "hold" benchmark: the queue is filled with `pending`
+// events, then each operation pops the earliest event and schedules it
+// again at an exponentially distributed delay, which is exactly what the
+// simulator does for every share
+double hold_ns_per_op(const std::string& name, size_t pending, size_t operations) {
+  std::mt19937_64 engine(42);
+  // mean delay proportional to the number of pending events, as in the
+  // simulator where each miner has a single pending share
+  std::exponential_distribution<double> delay(1.0 / pending);
+  auto queue = EventQueueFactory::create(name);
+  for (size_t i = 0; i < pending; i++) {
+    queue->schedule(Event(i, delay(engine)));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < operations; i++) {
+    auto event = queue->pop();
+    queue->schedule(Event(event.miner_id, event.time + delay(engine)));
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double, std::nano> elapsed = end - start;
+  return elapsed.count() / operations;
+}
+
+int main(int argc, char* argv[]) {
+  // the largest size takes a few seconds per backend to fill
+  size_t max_pending = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+  const size_t operations = 1000000;
+
+  std::printf("%-12s %10s %12s\n", "queue", "pending", "ns/op");
+  for (size_t pending = 1000; pending <= max_pending; pending *= 10) {
+    for (auto name : EventQueueFactory::registered()) {
+      auto ns = hold_ns_per_op(name, pending, operations);
+      std::printf("%-12s %10zu %12.1f\n", name.c_str(), pending, ns);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "fast_math.h"
+#include "random.h"
+#include "simulation.h"
+#include "simulator.h"
+
+using namespace poolsim;
+
+
+// Compares the scalar log with the vectorized kernel, then the shares per
+// second of the simulator drawing one variate at a time with drand48
+// against drawing them in batches with the xoshiro256 generator
+
+template <typename F>
+double elapsed_seconds(F run) {
+  auto start = std::chrono::steady_clock::now();
+  run();
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = end - start;
+  return elapsed.count();
+}
+
+void log_benchmark() {
+  const size_t count = 1 << 12;
+  const size_t rounds = 2000;
+  Xoshiro256Random random(42);
+  std::vector<double> input(count), output(count);
+  random.fill_uniform(input.data(), count);
+
+  double checksum = 0;
+  double std_log = elapsed_seconds([&]() {
+    for (size_t round = 0; round < rounds; round++) {
+      for (size_t i = 0; i < count; i++) {
+        output[i] = std::log(input[i]);
+      }
+      checksum += output[round % count];
+    }
+  });
+  double fast_log_seconds = elapsed_seconds([&]() {
+    for (size_t round = 0; round < rounds; round++) {
+      for (size_t i = 0; i < count; i++) {
+        output[i] = fast_log(input[i]);
+      }
+      checksum += output[round % count];
+    }
+  });
+  double batch = elapsed_seconds([&]() {
+    for (size_t round = 0; round < rounds; round++) {
+      log_batch(input.data(), output.data(), count);
+      checksum += output[round % count];
+    }
+  });
+
+  double values = count * rounds;
+  std::printf("%-12s %12s\n", "log", "ns/value");
+  std::printf("%-12s %12.2f\n", "std::log", 1e9 * std_log / values);
+  std::printf("%-12s %12.2f\n", "fast_log", 1e9 * fast_log_seconds / values);
+  std::printf("%-12s %12.2f %s\n", "log_batch", 1e9 * batch / values,
+              has_avx2_log() ? "(avx2)" : "(scalar)");
+  if (checksum == 0) {
+    std::printf("\n");
+  }
+}
+
+void simulator_benchmark() {
+  auto config = R"({
+    "output": "/dev/null",
+    "blocks": 20000,
+    "seed": 42,
+    "network_difficulty": 1000000,
+    "pools": [{
+      "uncle_block_prob": 0.0,
+      "difficulty": 10000,
+      "reward_scheme": {"type": "pps", "params": {"pool_fee": 0}},
+      "miners": [{
+        "generator": "random",
+        "params": {
+          "behavior": {"name": "default"},
+          "hashrate": {"distribution": "lognormal", "params": {"mean": 1, "stddev": 1.5}},
+          "stop_condition": {"type": "miners_count", "params": {"value": 100}}
+        }
+      }]
+    }]
+  })"_json;
+
+  std::printf("\n%-12s %-12s %14s\n", "engine", "rng", "shares/sec");
+  for (const std::string engine : {"per_miner", "aggregated"}) {
+    for (const std::string rng : {"drand48", "xoshiro256"}) {
+      Simulation simulation = config.get<Simulation>();
+      simulation.engine = engine;
+      simulation.rng = rng;
+      auto simulator = Simulator::from_simulation(simulation);
+      double seconds = elapsed_seconds([&]() { simulator->run(); });
+      uint64_t shares = 0;
+      for (auto pool : simulator->get_pools()) {
+        shares += pool->get_shares_count();
+      }
+      std::printf("%-12s %-12s %14.0f\n", engine.c_str(), rng.c_str(), shares / seconds);
+    }
+  }
+}
+
+int main() {
+  spdlog::set_level(spdlog::level::warn);
+  log_benchmark();
+  simulator_benchmark();
+  return 0;
+}
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "event_queue.h"
+#include "weighted_sampler.h"
+
+using namespace poolsim;
+
+
+// Compares the cost of generating one share with one pending event per
+// miner against drawing the next share at the aggregated rate and
+// picking the miner with an alias table or a Fenwick tree
+
+template <typename F>
+double ns_per_share(F next_share, size_t shares) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < shares; i++) {
+    next_share();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double, std::nano> elapsed = end - start;
+  return elapsed.count() / shares;
+}
+
+int main() {
+  const size_t shares = 2000000;
+  std::printf("%-12s %10s %12s\n", "engine", "miners", "ns/share");
+
+  for (size_t miners = 1000; miners <= 1000000; miners *= 10) {
+    std::mt19937_64 engine(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::lognormal_distribution<double> hashrate(1, 1.5);
+    std::vector<double> rates(miners);
+    for (auto& rate : rates) {
+      rate = hashrate(engine);
+    }
+
+    BinaryHeapEventQueue queue;
+    for (size_t i = 0; i < miners; i++) {
+      queue.schedule(Event(i, -std::log(1 - uniform(engine)) / rates[i]));
+    }
+    double heap_ns = ns_per_share([&]() {
+      auto event = queue.pop();
+      double t = -std::log(1 - uniform(engine)) / rates[event.miner_id];
+      queue.schedule(Event(event.miner_id, event.time + t));
+    }, shares);
+    std::printf("%-12s %10zu %12.1f\n", "per_miner", miners, heap_ns);
+
+    AliasTable alias(rates);
+    FenwickTree fenwick(rates);
+    double now = 0;
+    size_t checksum = 0;
+    double alias_ns = ns_per_share([&]() {
+      now += -std::log(1 - uniform(engine)) / alias.get_total_weight();
+      checksum += alias.sample(uniform(engine));
+    }, shares);
+    std::printf("%-12s %10zu %12.1f\n", "alias", miners, alias_ns);
+
+    double fenwick_ns = ns_per_share([&]() {
+      now += -std::log(1 - uniform(engine)) / fenwick.get_total_weight();
+      checksum += fenwick.sample(uniform(engine));
+    }, shares);
+    std::printf("%-12s %10zu %12.1f\n", "fenwick", miners, fenwick_ns);
+
+    // keeps the samples from being optimized away
+    if (checksum == 0 && now < 0) {
+      std::printf("\n");
+    }
+  }
+  return 0;
+}
@@ -2,14 +2,146 @@
 
 namespace poolsim {
 
-void to_json(nlohmann::json& j, const BlockEvent& data) {
+BlockSchemeData::BlockSchemeData(const BlockMetaData& metadata) : type(Type::base) {
+    static_cast<BlockMetaData&>(data) = metadata;
+}
+
+BlockSchemeData::BlockSchemeData(const QBBlockMetaData& metadata) : type(Type::qb), data(metadata) {}
+
+void to_json(nlohmann::json& j, const BlockSchemeData& scheme_data, const Network& network) {
+    const QBBlockMetaData& b = scheme_data.data;
+    switch (scheme_data.type) {
+    case BlockSchemeData::Type::none:
+        j = nullptr;
+        break;
+    case BlockSchemeData::Type::base:
+        j = nlohmann::json{
+            {"shares_per_block", b.shares_per_block},
+            {"pool_luck", b.pool_luck}
+        };
+        break;
+    case BlockSchemeData::Type::qb:
+        j = nlohmann::json{
+            {"shares_per_block", b.shares_per_block},
+            {"pool_luck", b.pool_luck},
+            {"credit_balance_receiver", b.credit_balance_receiver},
+            {"receiver_address", b.receiver_id == invalid_miner_id ? "" : network.get_miner_address(b.receiver_id)},
+            {"reset_balance_receiver", b.reset_balance_receiver},
+            {"proportion_credits_lost", b.prop_credits_lost},
+            {"total_credits_lost", b.total_credits_lost},
+            {"average_credits_lost", b.average_credits_lost}
+        };
+        break;
+    }
+}
+
+void to_json(nlohmann::json& j, const BlockEvent& data, const Network& network) {
+    nlohmann::json reward_scheme_data;
+    to_json(reward_scheme_data, data.scheme_data, network);
     j = nlohmann::json{
         {"time", data.time},
         {"is_uncle", data.is_uncle},
-        {"pool_name", data.pool_name},
-        {"miner_address", data.miner_address},
-        {"reward_scheme_data", data.reward_scheme_data}
+        {"pool_name", network.get_pool_name(data.pool_id)},
+        {"miner_address", network.get_miner_address(data.miner_id)},
+        {"reward_scheme_data", reward_scheme_data}
     };
 }
 
+void write(JsonWriter& writer, const BlockSchemeData& scheme_data, const Network& network) {
+    // keys in alphabetical order, as in to_json
+    const QBBlockMetaData& b = scheme_data.data;
+    switch (scheme_data.type) {
+    case BlockSchemeData::Type::none:
+        writer.value(nullptr);
+        break;
+    case BlockSchemeData::Type::base:
+        writer.begin_object();
+        writer.field("pool_luck", b.pool_luck);
+        writer.field("shares_per_block", b.shares_per_block);
+        writer.end_object();
+        break;
+    case BlockSchemeData::Type::qb:
+        writer.begin_object();
+        writer.field("average_credits_lost", b.average_credits_lost);
+        writer.field("credit_balance_receiver", b.credit_balance_receiver);
+        writer.field("pool_luck", b.pool_luck);
+        writer.field("proportion_credits_lost", b.prop_credits_lost);
+        writer.field("receiver_address", b.receiver_id == invalid_miner_id ? "" : network.get_miner_address(b.receiver_id));
+        writer.field("reset_balance_receiver", b.reset_balance_receiver);
+        writer.field("shares_per_block", b.shares_per_block);
+        writer.field("total_credits_lost", b.total_credits_lost);
+        writer.end_object();
+        break;
+    }
+}
+
+void write(JsonWriter& writer, const BlockEvent& data, const Network& network, const Selection& fields) {
+    writer.begin_object();
+    if (fields.has("is_uncle")) {
+        writer.field("is_uncle", data.is_uncle);
+    }
+    if (fields.has("miner_address")) {
+        writer.field("miner_address", network.get_miner_address(data.miner_id));
+    }
+    if (fields.has("pool_name")) {
+        writer.field("pool_name", network.get_pool_name(data.pool_id));
+    }
+    if (fields.has("reward_scheme_data")) {
+        writer.key("reward_scheme_data");
+        write(writer, data.scheme_data, network);
+    }
+    if (fields.has("time")) {
+        writer.field("time", data.time);
+    }
+    writer.end_object();
+}
+
+void save(CheckpointWriter& writer, const BlockMetaData& b) {
+    writer.write(b.shares_per_block);
+    writer.write(b.pool_luck);
+}
+
+void save(CheckpointWriter& writer, const QBBlockMetaData& b) {
+    save(writer, static_cast<const BlockMetaData&>(b));
+    writer.write(b.credit_balance_receiver);
+    writer.write(b.receiver_id);
+    writer.write(b.reset_balance_receiver);
+    writer.write(b.prop_credits_lost);
+    writer.write(b.total_credits_lost);
+    writer.write(b.average_credits_lost);
+}
+
+void load(CheckpointReader& reader, BlockMetaData& b) {
+    reader.read(b.shares_per_block);
+    reader.read(b.pool_luck);
+}
+
+void load(CheckpointReader& reader, QBBlockMetaData& b) {
+    load(reader, static_cast<BlockMetaData&>(b));
+    reader.read(b.credit_balance_receiver);
+    reader.read(b.receiver_id);
+    reader.read(b.reset_balance_receiver);
+    reader.read(b.prop_credits_lost);
+    reader.read(b.total_credits_lost);
+    reader.read(b.average_credits_lost);
+}
+
+void save(CheckpointWriter& writer, const BlockEvent& data) {
+    writer.write(data.time);
+    writer.write(data.is_uncle);
+    writer.write(data.pool_id);
+    writer.write(data.miner_id);
+    writer.write(data.scheme_data.type);
+    save(writer, data.scheme_data.data);
+}
+
+void load(CheckpointReader& reader, BlockEvent& data) {
+    reader.read(data.time);
+    reader.read(data.is_uncle);
+    reader.read(data.pool_id);
+    reader.read(data.miner_id);
+    reader.read(data.scheme_data.type);
+    load(reader, data.scheme_data.data);
+}
+
 }
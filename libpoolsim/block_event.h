@@ -1,19 +1,70 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include "nlohmann/json.hpp"
+#include "checkpoint.h"
+#include "json_writer.h"
+#include "network.h"
 
 
 namespace poolsim {
 
+struct BlockMetaData {
+    uint64_t shares_per_block = 0;
+    double pool_luck = 0;
+};
+
+struct QBBlockMetaData : BlockMetaData {
+    uint64_t credit_balance_receiver = 0;
+    // id of the miner who received the last block, invalid_miner_id before the first one
+    uint32_t receiver_id = invalid_miner_id;
+    uint64_t reset_balance_receiver = 0;
+    double prop_credits_lost = 0;
+    double total_credits_lost = 0;
+    double average_credits_lost = 0;
+};
+
+// Reward scheme metadata of a block, kept typed until the block is written
+// `type` tells which metadata struct is set, stored in the largest of them
+struct BlockSchemeData {
+    enum class Type : uint8_t { none, base, qb };
+
+    BlockSchemeData() = default;
+    explicit BlockSchemeData(const BlockMetaData& metadata);
+    explicit BlockSchemeData(const QBBlockMetaData& metadata);
+
+    Type type = Type::none;
+    QBBlockMetaData data;
+};
+
+// A block found in a pool, with the pool and the miner as ids
+// so that no allocation is needed until the block is written
 struct BlockEvent {
-    double time;
-    bool is_uncle;
-    std::string pool_name;
-    std::string miner_address;
-    nlohmann::json reward_scheme_data;
+    double time = 0;
+    bool is_uncle = false;
+    // index of the pool in the network
+    uint32_t pool_id = 0;
+    uint32_t miner_id = invalid_miner_id;
+    BlockSchemeData scheme_data;
 };
 
-void to_json(nlohmann::json& j, const BlockEvent& data);
+// writes the block with its pool name and addresses, as resolved by the network
+void to_json(nlohmann::json& j, const BlockEvent& data, const Network& network);
+void to_json(nlohmann::json& j, const BlockSchemeData& data, const Network& network);
+
+// writes the same json as to_json, with only the selected fields of the block
+void write(JsonWriter& writer, const BlockEvent& data, const Network& network,
+           const Selection& fields = Selection());
+void write(JsonWriter& writer, const BlockSchemeData& data, const Network& network);
+
+// writes and reads the block metadata and block event in checkpoints
+void save(CheckpointWriter& writer, const BlockMetaData& b);
+void save(CheckpointWriter& writer, const QBBlockMetaData& b);
+void load(CheckpointReader& reader, BlockMetaData& b);
+void load(CheckpointReader& reader, QBBlockMetaData& b);
+
+void save(CheckpointWriter& writer, const BlockEvent& data);
+void load(CheckpointReader& reader, BlockEvent& data);
 
 }
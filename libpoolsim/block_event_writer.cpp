@@ -0,0 +1,111 @@
+#include <chrono>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "block_event_writer.h"
+
+namespace poolsim {
+
+// number of events the simulation can get ahead of the writer thread
+const size_t block_writer_capacity = 4096;
+const size_t block_writer_file_buffer = 1 << 20;
+
+
+BlockEventWriter::BlockEventWriter(const std::string& _filepath,
+                                   std::shared_ptr<const Network> _network, uint64_t offset,
+                                   const Selection& _fields)
+  : filepath(_filepath), network(_network), fields(_fields), file_buffer(block_writer_file_buffer), queue(block_writer_capacity),
+    written_count(0), bytes_written(offset), closing(false), failed(false) {
+  file.rdbuf()->pubsetbuf(file_buffer.data(), file_buffer.size());
+  if (offset > 0) {
+    // drops the blocks written after the checkpoint being resumed
+    if (::truncate(filepath.c_str(), offset) != 0) {
+      throw std::invalid_argument("could not truncate blocks output " + filepath);
+    }
+    file.open(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::app);
+  } else {
+    file.open(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  }
+  if (!file) {
+    throw std::invalid_argument("could not open blocks output " + filepath);
+  }
+  thread = std::thread(&BlockEventWriter::work, this);
+}
+
+BlockEventWriter::~BlockEventWriter() {
+  if (thread.joinable()) {
+    closing.store(true, std::memory_order_release);
+    thread.join();
+  }
+}
+
+void BlockEventWriter::write(BlockEvent event) {
+  while (!queue.try_push(event)) {
+    std::this_thread::yield();
+  }
+  queued_count++;
+}
+
+void BlockEventWriter::wait_written() {
+  while (written_count.load(std::memory_order_acquire) < queued_count) {
+    std::this_thread::yield();
+  }
+}
+
+uint64_t BlockEventWriter::flush() {
+  wait_written();
+  // the writer thread does not touch the file while the queue is empty
+  file.flush();
+  if (!file || failed) {
+    throw std::invalid_argument("could not write blocks to " + filepath);
+  }
+  return bytes_written.load(std::memory_order_acquire);
+}
+
+void BlockEventWriter::close() {
+  if (!thread.joinable()) {
+    return;
+  }
+  closing.store(true, std::memory_order_release);
+  thread.join();
+  file.close();
+  if (!file || failed) {
+    throw std::invalid_argument("could not write blocks to " + filepath);
+  }
+}
+
+uint64_t BlockEventWriter::get_events_count() const {
+  return queued_count;
+}
+
+void BlockEventWriter::work() {
+  BlockEvent event;
+  std::ostringstream stream;
+  while (true) {
+    if (queue.try_pop(event)) {
+      stream.str(std::string());
+      JsonWriter writer(stream);
+      poolsim::write(writer, event, *network, fields);
+      stream << '\n';
+      std::string line = stream.str();
+      file.write(line.data(), line.size());
+      if (!file) {
+        failed = true;
+      }
+      bytes_written.fetch_add(line.size(), std::memory_order_relaxed);
+      written_count.fetch_add(1, std::memory_order_release);
+      continue;
+    }
+    // the events queued before closing are visible once it is set
+    if (closing.load(std::memory_order_acquire)) {
+      if (queue.is_empty()) {
+        return;
+      }
+      continue;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+}
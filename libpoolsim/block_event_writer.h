@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "block_event.h"
+#include "json_writer.h"
+#include "spsc_queue.h"
+
+namespace poolsim {
+
+// Streams block events to a file as newline-delimited JSON, one block per line
+// The simulation thread only moves the events into a lock-free ring buffer,
+// a background thread encodes and writes them, so that memory stays bounded
+// and serialization overlaps with the simulation
+// The pool names and miner addresses are resolved with the network from the writer thread
+class BlockEventWriter {
+public:
+  // Opens the file, truncated to `offset` bytes, and starts the writer thread
+  // A non-zero offset keeps the blocks written before a checkpoint
+  // Only the selected fields of the blocks are written
+  BlockEventWriter(const std::string& filepath, std::shared_ptr<const Network> network,
+                   uint64_t offset = 0, const Selection& fields = Selection());
+
+  // Writes the remaining events if close() was not called
+  ~BlockEventWriter();
+
+  BlockEventWriter(BlockEventWriter const&) = delete;
+  void operator=(BlockEventWriter const&) = delete;
+
+  // Queues the event, waiting for the writer thread if the buffer is full
+  void write(BlockEvent event);
+
+  // Waits for all the queued events to be written and flushed
+  // and returns the size of the file
+  uint64_t flush();
+
+  // Writes the remaining events and stops the writer thread
+  // Throws std::invalid_argument if the file could not be written
+  void close();
+
+  // Returns the number of events queued since the file was opened
+  uint64_t get_events_count() const;
+
+private:
+  std::string filepath;
+  std::shared_ptr<const Network> network;
+  Selection fields;
+  std::vector<char> file_buffer;
+  std::ofstream file;
+  SpscQueue<BlockEvent> queue;
+  std::thread thread;
+
+  // number of events queued, only used by the simulation thread
+  uint64_t queued_count = 0;
+  // number of events written by the writer thread
+  std::atomic<uint64_t> written_count;
+  // size of the file once the written events are flushed
+  std::atomic<uint64_t> bytes_written;
+  std::atomic<bool> closing;
+  std::atomic<bool> failed;
+
+  void work();
+  // Waits for the writer thread to write all the queued events
+  void wait_written();
+};
+
+}
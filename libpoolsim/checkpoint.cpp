@@ -0,0 +1,64 @@
+#include <stdexcept>
+
+#include "checkpoint.h"
+
+namespace poolsim {
+
+using nlohmann::json;
+
+
+CheckpointWriter::CheckpointWriter(std::ostream& _stream)
+  : stream(_stream) {}
+
+void CheckpointWriter::write_header() {
+  stream.write(checkpoint_magic, sizeof(checkpoint_magic));
+  write(checkpoint_version);
+}
+
+void CheckpointWriter::write(const std::string& value) {
+  write((uint64_t) value.size());
+  stream.write(value.data(), value.size());
+}
+
+void CheckpointWriter::write(const json& value) {
+  std::vector<uint8_t> bytes = json::to_cbor(value);
+  write((uint64_t) bytes.size());
+  stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+
+CheckpointReader::CheckpointReader(std::istream& _stream)
+  : stream(_stream) {}
+
+void CheckpointReader::read_bytes(char* bytes, size_t count) {
+  if (!stream.read(bytes, count)) {
+    throw std::invalid_argument("checkpoint is truncated");
+  }
+}
+
+void CheckpointReader::read_header() {
+  char magic[sizeof(checkpoint_magic)];
+  if (!stream.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0) {
+    throw std::invalid_argument("not a poolsim checkpoint");
+  }
+  uint32_t version = read<uint32_t>();
+  if (version != checkpoint_version) {
+    throw std::invalid_argument("unsupported checkpoint version " + std::to_string(version));
+  }
+}
+
+void CheckpointReader::read(std::string& value) {
+  value.resize(read<uint64_t>());
+  if (!value.empty()) {
+    read_bytes(&value[0], value.size());
+  }
+}
+
+void CheckpointReader::read(json& value) {
+  std::string bytes;
+  read(bytes);
+  value = json::from_cbor(std::vector<uint8_t>(bytes.begin(), bytes.end()));
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace poolsim {
+
+// Binary format of the checkpoints written by the simulator
+// Values are written with the byte order of the machine, so a checkpoint
+// is meant to be resumed on the same kind of machine it was written on
+const char checkpoint_magic[] = {'P', 'S', 'C', 'K'};
+const uint32_t checkpoint_version = 6;
+
+
+// Writes the state of a simulation to a stream
+class CheckpointWriter {
+public:
+  explicit CheckpointWriter(std::ostream& stream);
+
+  // Writes the magic and the version of the format
+  void write_header();
+
+  // Writes an arithmetic value, or any other trivially copyable struct
+  template <typename T>
+  void write(const T& value);
+
+  void write(const std::string& value);
+
+  // Written as CBOR
+  void write(const nlohmann::json& value);
+
+  template <typename T>
+  void write(const std::vector<T>& values);
+
+private:
+  std::ostream& stream;
+};
+
+
+// Reads back the values written by a CheckpointWriter, in the same order
+// Throws std::invalid_argument if the checkpoint is truncated or invalid
+class CheckpointReader {
+public:
+  explicit CheckpointReader(std::istream& stream);
+
+  // Reads and checks the magic and the version of the format
+  void read_header();
+
+  template <typename T>
+  void read(T& value);
+
+  void read(std::string& value);
+
+  void read(nlohmann::json& value);
+
+  template <typename T>
+  void read(std::vector<T>& values);
+
+  // Reads a value of the given type
+  template <typename T>
+  T read();
+
+private:
+  std::istream& stream;
+
+  void read_bytes(char* bytes, size_t count);
+};
+
+
+template <typename T>
+void CheckpointWriter::write(const T& value) {
+  static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void CheckpointWriter::write(const std::vector<T>& values) {
+  write((uint64_t) values.size());
+  for (const T& value : values) {
+    write(value);
+  }
+}
+
+template <typename T>
+void CheckpointReader::read(T& value) {
+  static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be read");
+  char bytes[sizeof(T)];
+  read_bytes(bytes, sizeof(T));
+  std::memcpy(&value, bytes, sizeof(T));
+}
+
+template <typename T>
+void CheckpointReader::read(std::vector<T>& values) {
+  uint64_t size = read<uint64_t>();
+  values.clear();
+  for (uint64_t i = 0; i < size; i++) {
+    T value;
+    read(value);
+    values.push_back(value);
+  }
+}
+
+template <typename T>
+T CheckpointReader::read() {
+  T value;
+  read(value);
+  return value;
+}
+
+}
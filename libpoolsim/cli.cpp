@@ -1,23 +1,59 @@
+#include <algorithm>
+#include <csignal>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include <CLI11.hpp>
 #include <spdlog/spdlog.h>
 
 #include "cli.h"
 #include "simulator.h"
+#include "replicas.h"
+#include "sweep.h"
 #include "miner_creator.h"
+#include "result_store.h"
 
 
 namespace poolsim {
 
+static void handle_sigterm(int signal) {
+    Simulator::request_checkpoint();
+}
+
 
 Cli::Cli() {
     app = std::make_shared<CLI::App>("PoolSim: Extensible Mining pool simulator");
     args = std::make_shared<CliArgs>();
     app->add_option("-c,--config", args->config_filepath, "configuration file")
-       ->required()
        ->check(CLI::ExistingFile);
+    app->add_option("--resume", args->resume_filepath,
+                    "resume the simulation from a checkpoint, instead of starting the one of --config")
+       ->check(CLI::ExistingFile);
+    app->add_option("--checkpoint", args->checkpoint_filepath,
+                    "file to write checkpoints to, on SIGTERM and every --checkpoint-every blocks");
+    app->add_option("--checkpoint-every", args->checkpoint_every,
+                    "number of blocks between two checkpoints");
+    app->add_option("--event-queue", args->event_queue,
+                    "event queue implementation (binary_heap, calendar or radix_heap)");
+    app->add_option("--blocks-output", args->blocks_output,
+                    "stream the blocks to this file as newline-delimited JSON rather than keeping them in the output");
+    app->add_option("--store", args->store,
+                    "SQLite database the summary of each run is appended to, for queries across runs");
+    app->add_option("--compression", args->compression,
+                    "codec used to compress the output (gzip, zstd or none), by default from its extension");
+    app->add_option("--compression-level", args->compression_level,
+                    "compression level, in the range of the codec");
+    app->add_option("--compression-threads", args->compression_threads,
+                    "number of threads compressing the output (defaults to the number of cores)");
+    app->add_option("--replicas", args->replicas,
+                    "number of independent replicas to run, each with a seed derived from the config seed");
+    app->add_option("--threads", args->threads,
+                    "number of threads used to run the replicas or the sweep (defaults to the number of cores)");
+    app->add_flag("--merge", args->merge,
+                  "write a summary over all the replicas rather than one output per replica");
+    app->add_flag("--check-threads", args->check_threads,
+                  "run the replicas again on a single thread and fail if the results differ");
     app->add_flag("--debug", args->debug, "enable debug logs");
 }
 
@@ -29,10 +65,100 @@ int Cli::run(int argc, char* argv[]) {
         spdlog::set_level(spdlog::level::debug);
     }
 
-    auto simulator = Simulator::from_config_file(args->config_filepath);
+    if (args->config_filepath.empty() == args->resume_filepath.empty()) {
+        throw std::invalid_argument("exactly one of --config or --resume must be given");
+    }
+
+    Simulation simulation;
+    if (!args->resume_filepath.empty()) {
+        simulation = Simulator::read_checkpoint_simulation(args->resume_filepath);
+    } else {
+        simulation = Simulation::from_config_file(args->config_filepath);
+    }
+    if (!args->event_queue.empty()) {
+        simulation.event_queue = args->event_queue;
+    }
+    if (!args->blocks_output.empty()) {
+        simulation.blocks_output = args->blocks_output;
+    }
+    if (!args->store.empty()) {
+        simulation.store = args->store;
+    }
+    if (!args->compression.empty()) {
+        simulation.compression.codec = args->compression;
+    }
+    if (args->compression_level != default_compression_level) {
+        simulation.compression.level = args->compression_level;
+    }
+    if (args->compression_threads > 0) {
+        simulation.compression.threads = args->compression_threads;
+    }
+    if (!args->checkpoint_filepath.empty()) {
+        simulation.checkpoint_path = args->checkpoint_filepath;
+    }
+    if (args->checkpoint_every > 0) {
+        simulation.checkpoint_every = args->checkpoint_every;
+    }
+
+    // fails before running the simulation if the codec is not available
+    std::string codec = get_codec_name(simulation.output, simulation.compression);
+    if (codec != "none") {
+        create_codec(codec, simulation.compression.level);
+    }
+    // and if the store cannot be opened
+    if (!simulation.store.empty()) {
+        ResultStore store(simulation.store);
+    }
+
+    size_t threads = args->threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    if (!args->resume_filepath.empty() && (args->replicas > 0 || !simulation.sweep.empty())) {
+        throw std::invalid_argument("only single simulations can be resumed");
+    }
+
+    if (!simulation.sweep.empty()) {
+        if (args->replicas > 0) {
+            throw std::invalid_argument("--replicas cannot be used with a sweep");
+        }
+        SweepRunner runner(simulation, threads);
+        runner.run();
+        runner.save_output();
+        return 0;
+    }
+
+    if (args->replicas > 0) {
+        ReplicaRunner runner(simulation, args->replicas, threads);
+        runner.run(!args->merge);
+        if (args->merge) {
+            runner.save_summary();
+        }
+        if (args->check_threads && !runner.check_single_thread()) {
+            spdlog::error("results differ between {} threads and a single thread", threads);
+            return 1;
+        }
+        return 0;
+    }
+
+    auto simulator = Simulator::from_simulation(simulation);
+    if (!args->resume_filepath.empty()) {
+        simulator->load_checkpoint(args->resume_filepath);
+    }
+    if (!simulation.checkpoint_path.empty()) {
+        std::signal(SIGTERM, handle_sigterm);
+    }
     simulator->run();
 
+    if (!simulator->is_finished()) {
+        // same status as if the process had been killed by the signal
+        return 128 + SIGTERM;
+    }
     simulator->save_simulation_data();
+    if (!simulation.store.empty()) {
+        ResultStore(simulation.store).append(simulator->get_stored_run());
+    }
 
     return 0;
 }
@@ -46,12 +172,10 @@ int run(int argc, char **argv) {
     Cli cli;
 
     try {
-        cli.run(argc, argv);
+        return cli.run(argc, argv);
     } catch(const CLI::ParseError &e) {
         return cli.get_app()->exit(e);
     }
-
-    return 0;
 }
 
 }
\ No newline at end of file
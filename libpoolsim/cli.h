@@ -10,6 +10,19 @@ namespace poolsim {
 
 struct CliArgs {
     std::string config_filepath;
+    std::string event_queue;
+    std::string blocks_output;
+    std::string store;
+    std::string compression;
+    int compression_level = default_compression_level;
+    size_t compression_threads = 0;
+    std::string resume_filepath;
+    std::string checkpoint_filepath;
+    uint64_t checkpoint_every = 0;
+    size_t replicas = 0;
+    size_t threads = 0;
+    bool merge = false;
+    bool check_threads = false;
     bool debug;
 };
 
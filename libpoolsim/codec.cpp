@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "codec.h"
+
+namespace poolsim {
+
+static bool ends_with(const std::string& value, const std::string& suffix) {
+  return value.size() >= suffix.size() &&
+         value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void from_json(const nlohmann::json& j, CompressionConfig& config) {
+  if (j.find("codec") != j.end()) {
+    j.at("codec").get_to(config.codec);
+  }
+  if (j.find("level") != j.end()) {
+    j.at("level").get_to(config.level);
+  }
+  if (j.find("threads") != j.end()) {
+    j.at("threads").get_to(config.threads);
+  }
+}
+
+std::string get_codec_name(const std::string& filepath, const CompressionConfig& config) {
+  if (!config.codec.empty()) {
+    return config.codec;
+  }
+  if (ends_with(filepath, ".gz")) {
+    return "gzip";
+  }
+  if (ends_with(filepath, ".zst")) {
+    return "zstd";
+  }
+  return "none";
+}
+
+std::string replace_extensions(const std::string& filepath, const std::string& extension) {
+  size_t name_start = filepath.find_last_of('/');
+  name_start = name_start == std::string::npos ? 0 : name_start + 1;
+  return filepath.substr(0, filepath.find('.', name_start)) + extension;
+}
+
+
+Codec::~Codec() {}
+
+size_t Codec::get_dictionary_size() const {
+  return 0;
+}
+
+std::string Codec::get_header() const {
+  return "";
+}
+
+uint32_t Codec::combine_checksums(uint32_t first, uint32_t second, uint64_t second_size) const {
+  return 0;
+}
+
+std::string Codec::get_trailer(uint32_t checksum, uint64_t size) const {
+  return "";
+}
+
+std::string Codec::decompress(const std::string& block, uint64_t size) const {
+  throw std::invalid_argument("this codec cannot decompress");
+}
+
+std::unique_ptr<Codec> create_codec(const std::string& name, int level) {
+  auto names = CodecFactory::registered();
+  if (std::find(names.begin(), names.end(), name) == names.end()) {
+    throw std::invalid_argument("codec " + name + " is not available in this build of poolsim");
+  }
+  return CodecFactory::create(name, level);
+}
+
+
+#ifdef USE_ZLIB
+
+// Gzip output in the format of pigz: a single gzip member whose deflate stream
+// is cut into blocks ending on a byte boundary with a sync flush, each block using
+// the end of the previous one as dictionary, and the checksums of the blocks
+// combined into the checksum of the member
+class GzipCodec : public Codec, public Creatable1<Codec, GzipCodec, int> {
+public:
+  explicit GzipCodec(int level);
+
+  size_t get_block_size() const override;
+  size_t get_dictionary_size() const override;
+  std::string get_header() const override;
+  CompressedBlock compress(const std::string& input, const std::string& dictionary,
+                           bool last) const override;
+  uint32_t combine_checksums(uint32_t first, uint32_t second, uint64_t second_size) const override;
+  std::string get_trailer(uint32_t checksum, uint64_t size) const override;
+  std::string decompress(const std::string& block, uint64_t size) const override;
+
+private:
+  int level;
+};
+
+GzipCodec::GzipCodec(int _level) : level(_level) {
+  if (level == default_compression_level) {
+    level = Z_DEFAULT_COMPRESSION;
+  } else if (level < 0 || level > 9) {
+    throw std::invalid_argument("gzip compression level must be between 0 and 9");
+  }
+}
+
+size_t GzipCodec::get_block_size() const {
+  // same as pigz
+  return 128 * 1024;
+}
+
+size_t GzipCodec::get_dictionary_size() const {
+  // size of the deflate window
+  return 32 * 1024;
+}
+
+std::string GzipCodec::get_header() const {
+  // no file name nor modification time, written on unix
+  const char header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+  return std::string(header, sizeof(header));
+}
+
+CompressedBlock GzipCodec::compress(const std::string& input, const std::string& dictionary,
+                                    bool last) const {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  // negative window bits to write a raw deflate stream, the header is written separately
+  if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::invalid_argument("could not initialize gzip compression");
+  }
+  if (!dictionary.empty()) {
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size());
+  }
+
+  CompressedBlock block;
+  // the bound is for a finished stream, a sync flush may add a few bytes
+  block.data.resize(deflateBound(&stream, input.size()) + 16);
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&block.data[0]);
+  stream.avail_out = block.data.size();
+  int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  bool done = last ? result == Z_STREAM_END : result == Z_OK && stream.avail_in == 0 && stream.avail_out > 0;
+  block.data.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (!done) {
+    throw std::invalid_argument("gzip compression failed");
+  }
+
+  block.checksum = crc32(0, reinterpret_cast<const Bytef*>(input.data()), input.size());
+  block.size = input.size();
+  return block;
+}
+
+uint32_t GzipCodec::combine_checksums(uint32_t first, uint32_t second, uint64_t second_size) const {
+  return crc32_combine(first, second, second_size);
+}
+
+std::string GzipCodec::get_trailer(uint32_t checksum, uint64_t size) const {
+  // checksum and size modulo 2^32, little endian
+  std::string trailer;
+  for (uint32_t value : {checksum, static_cast<uint32_t>(size)}) {
+    for (int i = 0; i < 4; i++) {
+      trailer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+  }
+  return trailer;
+}
+
+std::string GzipCodec::decompress(const std::string& block, uint64_t size) const {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, -15) != Z_OK) {
+    throw std::invalid_argument("could not initialize gzip decompression");
+  }
+  std::string output(size, '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+  stream.avail_in = block.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+  stream.avail_out = output.size();
+  // the blocks before the last one end with a sync flush instead of the end of the stream,
+  // and the last one is followed by the trailer
+  int result = Z_OK;
+  while (result == Z_OK && stream.avail_out > 0 && stream.avail_in > 0) {
+    result = inflate(&stream, Z_SYNC_FLUSH);
+  }
+  bool done = stream.avail_out == 0 && (result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR);
+  inflateEnd(&stream);
+  if (!done) {
+    throw std::invalid_argument("invalid gzip block");
+  }
+  return output;
+}
+
+REGISTER(Codec, GzipCodec, "gzip")
+
+#endif
+
+
+#ifdef USE_ZSTD
+
+// Each block is written as a separate zstd frame, and zstd reads
+// the concatenated frames as a single stream
+class ZstdCodec : public Codec, public Creatable1<Codec, ZstdCodec, int> {
+public:
+  explicit ZstdCodec(int level);
+
+  size_t get_block_size() const override;
+  CompressedBlock compress(const std::string& input, const std::string& dictionary,
+                           bool last) const override;
+  std::string decompress(const std::string& block, uint64_t size) const override;
+
+private:
+  int level;
+};
+
+ZstdCodec::ZstdCodec(int _level) : level(_level) {
+  if (level == default_compression_level) {
+    level = ZSTD_CLEVEL_DEFAULT;
+  } else if (level < 1 || level > ZSTD_maxCLevel()) {
+    throw std::invalid_argument("zstd compression level must be between 1 and " +
+                                std::to_string(ZSTD_maxCLevel()));
+  }
+}
+
+size_t ZstdCodec::get_block_size() const {
+  // frames are independent, so larger blocks than gzip keep a good ratio
+  return 4 * 1024 * 1024;
+}
+
+CompressedBlock ZstdCodec::compress(const std::string& input, const std::string& dictionary,
+                                    bool last) const {
+  CompressedBlock block;
+  block.size = input.size();
+  block.data.resize(ZSTD_compressBound(input.size()));
+  size_t compressed_size = ZSTD_compress(&block.data[0], block.data.size(),
+                                         input.data(), input.size(), level);
+  if (ZSTD_isError(compressed_size)) {
+    throw std::invalid_argument(std::string("zstd compression failed: ") +
+                                ZSTD_getErrorName(compressed_size));
+  }
+  block.data.resize(compressed_size);
+  return block;
+}
+
+std::string ZstdCodec::decompress(const std::string& block, uint64_t size) const {
+  std::string output(size, '\0');
+  size_t decompressed_size = ZSTD_decompress(&output[0], output.size(), block.data(), block.size());
+  if (ZSTD_isError(decompressed_size) || decompressed_size != size) {
+    throw std::invalid_argument("invalid zstd block");
+  }
+  return output;
+}
+
+REGISTER(Codec, ZstdCodec, "zstd")
+
+#endif
+
+
+CompressedFileBuffer::CompressedFileBuffer(const std::string& _filepath, std::unique_ptr<Codec> _codec,
+                                           size_t threads, size_t _block_size, bool _seekable)
+  : filepath(_filepath), codec(std::move(_codec)),
+    block_size(_block_size > 0 ? _block_size : codec->get_block_size()), seekable(_seekable),
+    thread_pool(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())) {
+  max_pending = 2 * thread_pool.size();
+  file.open(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if (!file) {
+    throw std::invalid_argument("could not open " + filepath);
+  }
+  std::string header = codec->get_header();
+  file.write(header.data(), header.size());
+  compressed_size = header.size();
+  block.reserve(block_size);
+}
+
+CompressedFileBuffer::~CompressedFileBuffer() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+CompressedFileBuffer::int_type CompressedFileBuffer::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof())) {
+    return traits_type::not_eof(c);
+  }
+  char value = traits_type::to_char_type(c);
+  xsputn(&value, 1);
+  return c;
+}
+
+CompressedFileBuffer::pos_type CompressedFileBuffer::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                                           std::ios_base::openmode which) {
+  if (offset != 0 || direction != std::ios_base::cur || !(which & std::ios_base::out)) {
+    return pos_type(off_type(-1));
+  }
+  return pos_type(submitted + block.size());
+}
+
+const std::vector<BlockPosition>& CompressedFileBuffer::get_blocks() const {
+  return blocks;
+}
+
+std::streamsize CompressedFileBuffer::xsputn(const char* s, std::streamsize count) {
+  std::streamsize written = 0;
+  while (written < count) {
+    size_t length = std::min<size_t>(count - written, block_size - block.size());
+    block.append(s + written, length);
+    written += length;
+    if (block.size() == block_size) {
+      submit_block(false);
+    }
+  }
+  return count;
+}
+
+void CompressedFileBuffer::submit_block(bool last) {
+  while (pending.size() >= max_pending) {
+    write_next_block();
+  }
+
+  auto input = std::make_shared<std::string>();
+  input->swap(block);
+  block.reserve(block_size);
+  submitted += input->size();
+  auto previous = std::make_shared<std::string>(dictionary);
+  size_t dictionary_size = seekable ? 0 : codec->get_dictionary_size();
+  if (dictionary_size > 0) {
+    dictionary.append(*input);
+    if (dictionary.size() > dictionary_size) {
+      dictionary.erase(0, dictionary.size() - dictionary_size);
+    }
+  }
+
+  const Codec* block_codec = codec.get();
+  pending.push_back(thread_pool.submit([block_codec, input, previous, last]() {
+    return block_codec->compress(*input, *previous, last);
+  }));
+}
+
+void CompressedFileBuffer::write_next_block() {
+  CompressedBlock compressed = pending.front().get();
+  pending.pop_front();
+  file.write(compressed.data.data(), compressed.data.size());
+  blocks.push_back({compressed_size, compressed.data.size(), size, compressed.size});
+  compressed_size += compressed.data.size();
+  checksum = codec->combine_checksums(checksum, compressed.checksum, compressed.size);
+  size += compressed.size;
+}
+
+void CompressedFileBuffer::close() {
+  if (closed) {
+    return;
+  }
+  closed = true;
+  submit_block(true);
+  while (!pending.empty()) {
+    write_next_block();
+  }
+  std::string trailer = codec->get_trailer(checksum, size);
+  file.write(trailer.data(), trailer.size());
+  file.close();
+  if (!file) {
+    throw std::invalid_argument("could not write " + filepath);
+  }
+}
+
+
+void write_output(const std::string& filepath, const CompressionConfig& compression,
+                  const std::function<void(std::ostream&)>& write,
+                  std::vector<BlockPosition>* blocks) {
+  std::string codec_name = get_codec_name(filepath, compression);
+  if (codec_name == "none") {
+    std::ofstream o(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    write(o);
+    return;
+  }
+
+  CompressedFileBuffer buffer(filepath, create_codec(codec_name, compression.level), compression.threads,
+                              0, blocks != nullptr);
+  std::ostream o(&buffer);
+  write(o);
+  buffer.close();
+  if (blocks != nullptr) {
+    *blocks = buffer.get_blocks();
+  }
+}
+
+void write_json(const std::string& filepath, const nlohmann::json& value,
+                const CompressionConfig& compression) {
+  write_output(filepath, compression, [&value](std::ostream& o) {
+    o << std::setw(4) << value << std::endl;
+  });
+}
+
+}
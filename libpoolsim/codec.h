@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "factory.h"
+#include "thread_pool.h"
+
+namespace poolsim {
+
+// Level used when none is set, each codec then uses its own default
+const int default_compression_level = -1;
+
+// How the outputs are compressed
+struct CompressionConfig {
+  // Name of the codec (see CodecFactory), or "none"
+  // When empty, the codec is picked from the extension of the output
+  std::string codec;
+
+  // Compression level, in the range of the codec
+  int level = default_compression_level;
+
+  // Number of threads compressing blocks, defaults to the number of cores
+  size_t threads = 0;
+};
+
+void from_json(const nlohmann::json& j, CompressionConfig& config);
+
+// Returns the codec to use for the file: the codec of the config if set,
+// otherwise "gzip" for .gz files, "zstd" for .zst files and "none" for the others
+std::string get_codec_name(const std::string& filepath, const CompressionConfig& config);
+
+// Returns the path with all the extensions of the file name replaced by `extension`,
+// e.g. results.summary.json for results.json.gz and the extension .summary.json
+std::string replace_extensions(const std::string& filepath, const std::string& extension);
+
+
+// Result of the compression of a block of the input
+struct CompressedBlock {
+  std::string data;
+  // checksum of the uncompressed block, if the codec uses one
+  uint32_t checksum = 0;
+  uint64_t size = 0;
+};
+
+// Position of a compressed block in the file and in the uncompressed output
+struct BlockPosition {
+  uint64_t compressed_offset;
+  uint64_t compressed_size;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Compresses its input as independent blocks, which can be compressed
+// concurrently and written one after the other to form a valid file
+class Codec {
+public:
+  virtual ~Codec();
+
+  // Size of the blocks the input is split into
+  virtual size_t get_block_size() const = 0;
+
+  // Number of bytes preceding a block passed to compress() to improve the ratio
+  virtual size_t get_dictionary_size() const;
+
+  // Returns the bytes written before the first block
+  virtual std::string get_header() const;
+
+  // Compresses a block of the input, can be called from several threads at once
+  // `dictionary` is the end of the input before the block, `last` is set for the last block
+  virtual CompressedBlock compress(const std::string& input, const std::string& dictionary,
+                                   bool last) const = 0;
+
+  // Returns the checksum of two consecutive blocks from their checksums
+  virtual uint32_t combine_checksums(uint32_t first, uint32_t second, uint64_t second_size) const;
+
+  // Returns the bytes written after the last block, given the checksum and size of the whole input
+  virtual std::string get_trailer(uint32_t checksum, uint64_t size) const;
+
+  // Decompresses a block of `size` bytes, compressed without dictionary
+  // Throws std::invalid_argument if the block is invalid or the codec cannot decompress
+  virtual std::string decompress(const std::string& block, uint64_t size) const;
+};
+
+// Codecs are created with their compression level
+MAKE_FACTORY(CodecFactory, Codec, int)
+
+// Creates the codec, throws std::invalid_argument if it was not built in
+std::unique_ptr<Codec> create_codec(const std::string& name, int level);
+
+
+// Stream buffer writing compressed data to a file
+// Full blocks are compressed by a thread pool while the next ones are written,
+// and the compressed blocks are written to the file in order
+class CompressedFileBuffer : public std::streambuf {
+public:
+  // `block_size` overrides the block size of the codec when non-zero
+  // Blocks are compressed without dictionary when `seekable` is set,
+  // so that each of them can be decompressed on its own
+  CompressedFileBuffer(const std::string& filepath, std::unique_ptr<Codec> codec,
+                       size_t threads, size_t block_size = 0, bool seekable = false);
+
+  // Closes the file if close() was not called, ignoring errors
+  ~CompressedFileBuffer();
+
+  // Compresses the remaining data, writes the trailer and closes the file
+  // Throws std::invalid_argument if the file could not be written
+  void close();
+
+  // Returns the positions of the blocks written so far
+  const std::vector<BlockPosition>& get_blocks() const;
+
+protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char* s, std::streamsize count) override;
+  // Only gives the current position in the uncompressed output, for tellp()
+  pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+                   std::ios_base::openmode which) override;
+
+private:
+  std::string filepath;
+  std::unique_ptr<Codec> codec;
+  std::ofstream file;
+  size_t block_size;
+  // blocks compressed ahead of the file, before the writing thread waits
+  size_t max_pending;
+  bool seekable;
+
+  std::string block;
+  std::string dictionary;
+  std::deque<std::future<CompressedBlock>> pending;
+  uint32_t checksum = 0;
+  uint64_t size = 0;
+  // bytes of the input submitted for compression, and written to the file
+  uint64_t submitted = 0;
+  uint64_t compressed_size = 0;
+  std::vector<BlockPosition> blocks;
+  bool closed = false;
+  // declared last, so that its tasks are done before the rest is destroyed
+  ThreadPool thread_pool;
+
+  // Schedules the compression of the current block
+  void submit_block(bool last);
+  // Writes the oldest compressed block to the file
+  void write_next_block();
+};
+
+
+// Opens the file, compressed with the codec of the config, and
+// passes it to `write` as a stream
+// When `blocks` is set, the blocks are compressed so that they can be decompressed
+// on their own and their positions are stored in it
+void write_output(const std::string& filepath, const CompressionConfig& compression,
+                  const std::function<void(std::ostream&)>& write,
+                  std::vector<BlockPosition>* blocks = nullptr);
+
+// Writes the json to the file, compressed with the codec of the config
+void write_json(const std::string& filepath, const nlohmann::json& value,
+                const CompressionConfig& compression);
+
+}
@@ -0,0 +1,292 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "columnar.h"
+
+namespace poolsim {
+
+// size of the magic, the version and the number of columns
+const size_t columnar_header_size = 16;
+// size of the type, name length, rows, offset and size of a column
+const size_t columnar_entry_size = 32;
+const size_t columnar_alignment = 8;
+
+static uint64_t align(uint64_t offset) {
+  return (offset + columnar_alignment - 1) / columnar_alignment * columnar_alignment;
+}
+
+
+std::string get_column_type_name(ColumnType type) {
+  switch (type) {
+  case ColumnType::uint8: return "uint8";
+  case ColumnType::uint32: return "uint32";
+  case ColumnType::uint64: return "uint64";
+  case ColumnType::float64: return "float64";
+  case ColumnType::string: return "string";
+  case ColumnType::address: return "address";
+  }
+  return "unknown";
+}
+
+bool is_columnar_path(const std::string& filepath) {
+  size_t length = sizeof(columnar_extension) - 1;
+  return filepath.size() >= length &&
+         filepath.compare(filepath.size() - length, length, columnar_extension) == 0;
+}
+
+
+void ColumnarWriter::add_raw_column(const std::string& name, ColumnType type, uint64_t rows,
+                                    const void* values, size_t size) {
+  Column column{name, type, rows, std::vector<char>(size)};
+  if (size > 0) {
+    std::memcpy(column.data.data(), values, size);
+  }
+  columns.push_back(std::move(column));
+}
+
+void ColumnarWriter::add_column(const std::string& name, const std::vector<std::string>& values) {
+  std::vector<uint64_t> offsets(values.size() + 1, 0);
+  for (size_t i = 0; i < values.size(); i++) {
+    offsets[i + 1] = offsets[i] + values[i].size();
+  }
+  size_t offsets_size = offsets.size() * sizeof(uint64_t);
+  Column column{name, ColumnType::string, values.size(),
+                std::vector<char>(offsets_size + offsets.back())};
+  std::memcpy(column.data.data(), offsets.data(), offsets_size);
+  for (size_t i = 0; i < values.size(); i++) {
+    std::memcpy(column.data.data() + offsets_size + offsets[i], values[i].data(), values[i].size());
+  }
+  columns.push_back(std::move(column));
+}
+
+void ColumnarWriter::add_address_column(const std::string& name, const std::vector<uint32_t>& values) {
+  add_raw_column(name, ColumnType::address, values.size(),
+                 values.data(), values.size() * sizeof(uint32_t));
+}
+
+void ColumnarWriter::write(const std::string& filepath) const {
+  std::ofstream file(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  if (!file) {
+    throw std::invalid_argument("could not open " + filepath);
+  }
+
+  uint64_t offset = columnar_header_size;
+  for (auto& column : columns) {
+    offset = align(offset + columnar_entry_size + column.name.size());
+  }
+  std::vector<uint64_t> offsets;
+  for (auto& column : columns) {
+    offsets.push_back(offset);
+    offset = align(offset + column.data.size());
+  }
+
+  std::string bytes(columnar_magic, sizeof(columnar_magic));
+  auto append = [&bytes](const void* value, size_t size) {
+    bytes.append(static_cast<const char*>(value), size);
+  };
+  auto pad = [&bytes]() { bytes.resize(align(bytes.size()), '\0'); };
+
+  uint32_t version = columnar_version;
+  uint64_t columns_count = columns.size();
+  append(&version, sizeof(version));
+  append(&columns_count, sizeof(columns_count));
+  for (size_t i = 0; i < columns.size(); i++) {
+    auto& column = columns[i];
+    uint32_t type = static_cast<uint32_t>(column.type);
+    uint32_t name_length = column.name.size();
+    uint64_t size = column.data.size();
+    append(&type, sizeof(type));
+    append(&name_length, sizeof(name_length));
+    append(&column.rows, sizeof(column.rows));
+    append(&offsets[i], sizeof(offsets[i]));
+    append(&size, sizeof(size));
+    append(column.name.data(), column.name.size());
+    pad();
+  }
+  file.write(bytes.data(), bytes.size());
+
+  const char padding[columnar_alignment] = {0};
+  for (auto& column : columns) {
+    file.write(column.data.data(), column.data.size());
+    file.write(padding, align(column.data.size()) - column.data.size());
+  }
+
+  file.close();
+  if (!file) {
+    throw std::invalid_argument("could not write " + filepath);
+  }
+}
+
+
+ColumnarFile::ColumnarFile(const std::string& _filepath) : filepath(_filepath) {
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::invalid_argument("could not open " + filepath);
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < columnar_header_size) {
+    ::close(fd);
+    throw std::invalid_argument(filepath + " is not a columnar file");
+  }
+  size = info.st_size;
+  void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::invalid_argument("could not map " + filepath);
+  }
+  data = static_cast<const char*>(mapped);
+
+  auto invalid = [this]() {
+    ::munmap(const_cast<char*>(data), size);
+    return std::invalid_argument(filepath + " is not a valid columnar file");
+  };
+  auto read = [this](uint64_t offset, void* value, size_t length) {
+    std::memcpy(value, data + offset, length);
+  };
+
+  uint32_t version;
+  uint64_t columns_count;
+  read(sizeof(columnar_magic), &version, sizeof(version));
+  read(sizeof(columnar_magic) + sizeof(version), &columns_count, sizeof(columns_count));
+  if (std::memcmp(data, columnar_magic, sizeof(columnar_magic)) != 0 ||
+      version != columnar_version) {
+    throw invalid();
+  }
+
+  uint64_t offset = columnar_header_size;
+  for (uint64_t i = 0; i < columns_count; i++) {
+    if (offset + columnar_entry_size > size) {
+      throw invalid();
+    }
+    uint32_t type, name_length;
+    ColumnInfo info;
+    read(offset, &type, sizeof(type));
+    read(offset + 4, &name_length, sizeof(name_length));
+    read(offset + 8, &info.rows, sizeof(info.rows));
+    read(offset + 16, &info.offset, sizeof(info.offset));
+    read(offset + 24, &info.size, sizeof(info.size));
+    offset += columnar_entry_size;
+    if (offset + name_length > size || info.offset > size || info.size > size - info.offset ||
+        info.offset % columnar_alignment != 0 ||
+        type < static_cast<uint32_t>(ColumnType::uint8) ||
+        type > static_cast<uint32_t>(ColumnType::address)) {
+      throw invalid();
+    }
+    info.type = static_cast<ColumnType>(type);
+    std::string name(data + offset, name_length);
+    offset = align(offset + name_length);
+
+    // checks the size of the data, so that accessors do not need to
+    uint64_t expected_size;
+    switch (info.type) {
+    case ColumnType::uint8: expected_size = info.rows; break;
+    case ColumnType::uint32:
+    case ColumnType::address: expected_size = info.rows * sizeof(uint32_t); break;
+    case ColumnType::uint64:
+    case ColumnType::float64: expected_size = info.rows * sizeof(uint64_t); break;
+    case ColumnType::string: {
+      uint64_t offsets_size = (info.rows + 1) * sizeof(uint64_t);
+      if (offsets_size > info.size) {
+        throw invalid();
+      }
+      uint64_t strings_size;
+      read(info.offset + info.rows * sizeof(uint64_t), &strings_size, sizeof(strings_size));
+      expected_size = offsets_size + strings_size;
+      break;
+    }
+    }
+    if (expected_size != info.size || columns.count(name) > 0) {
+      throw invalid();
+    }
+    names.push_back(name);
+    columns[name] = info;
+  }
+}
+
+ColumnarFile::~ColumnarFile() {
+  ::munmap(const_cast<char*>(data), size);
+}
+
+bool ColumnarFile::has_column(const std::string& name) const {
+  return columns.find(name) != columns.end();
+}
+
+std::vector<std::string> ColumnarFile::get_column_names() const {
+  return names;
+}
+
+ColumnType ColumnarFile::get_column_type(const std::string& name) const {
+  return get_column(name).type;
+}
+
+uint64_t ColumnarFile::get_rows(const std::string& name) const {
+  return get_column(name).rows;
+}
+
+const ColumnarFile::ColumnInfo& ColumnarFile::get_column(const std::string& name) const {
+  auto it = columns.find(name);
+  if (it == columns.end()) {
+    throw std::invalid_argument("no column " + name + " in " + filepath);
+  }
+  return it->second;
+}
+
+const void* ColumnarFile::get_data(const std::string& name, ColumnType type) const {
+  auto& column = get_column(name);
+  if (column.type != type) {
+    throw std::invalid_argument("column " + name + " has type " + get_column_type_name(column.type) +
+                                ", not " + get_column_type_name(type));
+  }
+  return data + column.offset;
+}
+
+std::string ColumnarFile::get_string(const std::string& name, uint64_t row) const {
+  auto offsets = static_cast<const uint64_t*>(get_data(name, ColumnType::string));
+  uint64_t rows = get_rows(name);
+  if (row >= rows) {
+    throw std::invalid_argument("row out of range for column " + name);
+  }
+  const char* strings = reinterpret_cast<const char*>(offsets + rows + 1);
+  if (offsets[row] > offsets[row + 1] || offsets[row + 1] > offsets[rows]) {
+    throw std::invalid_argument("invalid offsets in column " + name);
+  }
+  return std::string(strings + offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+std::string ColumnarFile::get_address(const std::string& name, uint64_t row) const {
+  auto ids = static_cast<const uint32_t*>(get_data(name, ColumnType::address));
+  if (row >= get_rows(name)) {
+    throw std::invalid_argument("row out of range for column " + name);
+  }
+  if (ids[row] >= get_rows(columnar_addresses_column)) {
+    return "";
+  }
+  return get_string(columnar_addresses_column, ids[row]);
+}
+
+std::string ColumnarFile::format_value(const std::string& name, uint64_t row) const {
+  auto& column = get_column(name);
+  if (row >= column.rows) {
+    throw std::invalid_argument("row out of range for column " + name);
+  }
+  std::ostringstream stream;
+  stream.precision(17);
+  switch (column.type) {
+  case ColumnType::uint8: stream << static_cast<uint32_t>(get<uint8_t>(name)[row]); break;
+  case ColumnType::uint32: stream << get<uint32_t>(name)[row]; break;
+  case ColumnType::uint64: stream << get<uint64_t>(name)[row]; break;
+  case ColumnType::float64: stream << get<double>(name)[row]; break;
+  case ColumnType::string: return get_string(name, row);
+  case ColumnType::address: return get_address(name, row);
+  }
+  return stream.str();
+}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace poolsim {
+
+// Binary columnar format of the results, selected by the .psc extension
+// The file starts with the magic, the version and the number of columns,
+// followed by the table of contents and the data of each column, aligned
+// on 8 bytes so that the columns can be used in place once the file is mapped
+// Values are written with the byte order of the machine
+const char columnar_magic[] = {'P', 'S', 'C', 'R'};
+const uint32_t columnar_version = 1;
+const char columnar_extension[] = ".psc";
+
+// Addresses are dictionary encoded: `address` columns hold indexes
+// in the `addresses` string column
+const char columnar_addresses_column[] = "addresses";
+
+enum class ColumnType : uint32_t {
+  uint8 = 1,
+  uint32 = 2,
+  uint64 = 3,
+  float64 = 4,
+  // n + 1 uint64 offsets followed by the bytes of the n strings
+  string = 5,
+  // uint32 index in the addresses column
+  address = 6
+};
+
+// Returns the name of the type, e.g. "float64"
+std::string get_column_type_name(ColumnType type);
+
+// Returns whether the results should be written as columns, from the extension of the file
+bool is_columnar_path(const std::string& filepath);
+
+template <typename T> struct column_type_of;
+template <> struct column_type_of<uint8_t> { static const ColumnType value = ColumnType::uint8; };
+template <> struct column_type_of<uint32_t> { static const ColumnType value = ColumnType::uint32; };
+template <> struct column_type_of<uint64_t> { static const ColumnType value = ColumnType::uint64; };
+template <> struct column_type_of<double> { static const ColumnType value = ColumnType::float64; };
+
+
+// Collects typed columns in memory and writes them to a file
+// Columns are named `table.field`, the columns of a table having the same length
+class ColumnarWriter {
+public:
+  template <typename T>
+  void add_column(const std::string& name, const std::vector<T>& values);
+
+  void add_column(const std::string& name, const std::vector<std::string>& values);
+
+  // Adds a column of indexes in the addresses column
+  void add_address_column(const std::string& name, const std::vector<uint32_t>& values);
+
+  // Writes all the columns to the file
+  // Throws std::invalid_argument if the file could not be written
+  void write(const std::string& filepath) const;
+
+private:
+  struct Column {
+    std::string name;
+    ColumnType type;
+    uint64_t rows;
+    std::vector<char> data;
+  };
+  std::vector<Column> columns;
+
+  void add_raw_column(const std::string& name, ColumnType type, uint64_t rows,
+                      const void* data, size_t size);
+};
+
+
+// Read-only view of a columnar file, mapped in memory
+// Throws std::invalid_argument if the file is not a valid columnar file
+class ColumnarFile {
+public:
+  explicit ColumnarFile(const std::string& filepath);
+  ~ColumnarFile();
+
+  ColumnarFile(ColumnarFile const&) = delete;
+  void operator=(ColumnarFile const&) = delete;
+
+  bool has_column(const std::string& name) const;
+
+  // Returns the names of the columns, in the order they were written
+  std::vector<std::string> get_column_names() const;
+
+  ColumnType get_column_type(const std::string& name) const;
+
+  uint64_t get_rows(const std::string& name) const;
+
+  // Returns the values of a numeric column, pointing into the mapped file
+  // Address columns are read as uint32_t
+  // Throws std::invalid_argument if the column does not exist or has another type
+  template <typename T>
+  const T* get(const std::string& name) const;
+
+  // Returns a string of a string column
+  std::string get_string(const std::string& name, uint64_t row) const;
+
+  // Returns the address of a row of an address column
+  std::string get_address(const std::string& name, uint64_t row) const;
+
+  // Returns the value of a row of any column formatted as text
+  std::string format_value(const std::string& name, uint64_t row) const;
+
+private:
+  struct ColumnInfo {
+    ColumnType type;
+    uint64_t rows;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  std::string filepath;
+  const char* data = nullptr;
+  size_t size = 0;
+  std::vector<std::string> names;
+  std::map<std::string, ColumnInfo> columns;
+
+  const ColumnInfo& get_column(const std::string& name) const;
+  const void* get_data(const std::string& name, ColumnType type) const;
+};
+
+
+template <typename T>
+void ColumnarWriter::add_column(const std::string& name, const std::vector<T>& values) {
+  add_raw_column(name, column_type_of<T>::value, values.size(),
+                 values.data(), values.size() * sizeof(T));
+}
+
+template <typename T>
+const T* ColumnarFile::get(const std::string& name) const {
+  ColumnType type = column_type_of<T>::value;
+  if (std::is_same<T, uint32_t>::value && get_column(name).type == ColumnType::address) {
+    type = ColumnType::address;
+  }
+  return static_cast<const T*>(get_data(name, type));
+}
+
+}
@@ -0,0 +1,188 @@
+#include <stdexcept>
+
+#include "credit_ranking.h"
+#include "network.h"
+
+namespace poolsim {
+
+// no child, miner ids being the indexes of the nodes
+static const uint32_t null_node = invalid_miner_id;
+
+// priority of the node of a miner, a hash of its id so that the shape of the
+// treap does not depend on a random generator
+static uint32_t get_priority(uint32_t miner_id) {
+  uint64_t x = miner_id + 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return static_cast<uint32_t>(x ^ (x >> 31));
+}
+
+CreditRanking::CreditRanking() : root(null_node) {}
+
+void CreditRanking::set_credits(uint32_t miner_id, uint64_t credits) {
+  if (miner_id >= nodes.size()) {
+    nodes.resize(miner_id + 1, Node{0, 0, 0, null_node, null_node});
+  }
+  if (contains(miner_id)) {
+    root = erase(root, miner_id);
+    credits_sum -= nodes[miner_id].credits;
+  }
+
+  Node& node = nodes[miner_id];
+  node.credits = credits;
+  node.priority = get_priority(miner_id);
+  node.size = 1;
+  node.left = node.right = null_node;
+  credits_sum += credits;
+
+  uint32_t left, right;
+  split(root, credits, miner_id, left, right);
+  root = merge(merge(left, miner_id), right);
+}
+
+uint64_t CreditRanking::get_credits(uint32_t miner_id) const {
+  return contains(miner_id) ? nodes[miner_id].credits : 0;
+}
+
+bool CreditRanking::contains(uint32_t miner_id) const {
+  return miner_id < nodes.size() && nodes[miner_id].size > 0;
+}
+
+uint64_t CreditRanking::size() const {
+  return get_size(root);
+}
+
+uint64_t CreditRanking::get_credits_sum() const {
+  return credits_sum;
+}
+
+uint32_t CreditRanking::at(uint64_t rank) const {
+  if (rank >= size()) {
+    throw std::out_of_range("rank out of the credit ranking");
+  }
+  uint32_t node = root;
+  while (true) {
+    uint64_t left_size = get_size(nodes[node].left);
+    if (rank == left_size) {
+      return node;
+    }
+    if (rank < left_size) {
+      node = nodes[node].left;
+    } else {
+      rank -= left_size + 1;
+      node = nodes[node].right;
+    }
+  }
+}
+
+uint64_t CreditRanking::rank_of(uint32_t miner_id) const {
+  if (!contains(miner_id)) {
+    return size();
+  }
+  uint64_t credits = nodes[miner_id].credits;
+  uint64_t rank = 0;
+  uint32_t node = root;
+  while (node != miner_id) {
+    if (is_before(node, credits, miner_id)) {
+      rank += get_size(nodes[node].left) + 1;
+      node = nodes[node].right;
+    } else {
+      node = nodes[node].left;
+    }
+  }
+  return rank + get_size(nodes[miner_id].left);
+}
+
+uint32_t CreditRanking::successor_of(uint32_t miner_id) const {
+  uint64_t rank = rank_of(miner_id);
+  if (rank + 1 >= size()) {
+    return invalid_miner_id;
+  }
+  return at(rank + 1);
+}
+
+std::vector<uint32_t> CreditRanking::top_n(uint64_t k) const {
+  std::vector<uint32_t> miner_ids;
+  std::vector<uint32_t> stack;
+  uint32_t node = root;
+  while (miner_ids.size() < k && (node != null_node || !stack.empty())) {
+    if (node != null_node) {
+      stack.push_back(node);
+      node = nodes[node].left;
+      continue;
+    }
+    node = stack.back();
+    stack.pop_back();
+    miner_ids.push_back(node);
+    node = nodes[node].right;
+  }
+  return miner_ids;
+}
+
+void CreditRanking::clear() {
+  nodes.clear();
+  root = null_node;
+  credits_sum = 0;
+}
+
+bool CreditRanking::is_before(uint32_t miner_id, uint64_t credits, uint32_t other_id) const {
+  uint64_t miner_credits = nodes[miner_id].credits;
+  return miner_credits > credits || (miner_credits == credits && miner_id < other_id);
+}
+
+uint32_t CreditRanking::get_size(uint32_t node) const {
+  return node == null_node ? 0 : nodes[node].size;
+}
+
+void CreditRanking::update_size(uint32_t node) {
+  nodes[node].size = get_size(nodes[node].left) + get_size(nodes[node].right) + 1;
+}
+
+void CreditRanking::split(uint32_t node, uint64_t credits, uint32_t miner_id, uint32_t& left, uint32_t& right) {
+  if (node == null_node) {
+    left = right = null_node;
+    return;
+  }
+  if (is_before(node, credits, miner_id)) {
+    split(nodes[node].right, credits, miner_id, nodes[node].right, right);
+    left = node;
+  } else {
+    split(nodes[node].left, credits, miner_id, left, nodes[node].left);
+    right = node;
+  }
+  update_size(node);
+}
+
+uint32_t CreditRanking::merge(uint32_t left, uint32_t right) {
+  if (left == null_node) {
+    return right;
+  }
+  if (right == null_node) {
+    return left;
+  }
+  if (nodes[left].priority > nodes[right].priority) {
+    nodes[left].right = merge(nodes[left].right, right);
+    update_size(left);
+    return left;
+  }
+  nodes[right].left = merge(left, nodes[right].left);
+  update_size(right);
+  return right;
+}
+
+uint32_t CreditRanking::erase(uint32_t node, uint32_t miner_id) {
+  if (node == miner_id) {
+    uint32_t merged = merge(nodes[node].left, nodes[node].right);
+    nodes[node].size = 0;
+    return merged;
+  }
+  if (is_before(node, nodes[miner_id].credits, miner_id)) {
+    nodes[node].right = erase(nodes[node].right, miner_id);
+  } else {
+    nodes[node].left = erase(nodes[node].left, miner_id);
+  }
+  update_size(node);
+  return node;
+}
+
+}
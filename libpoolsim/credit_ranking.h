@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace poolsim {
+
+// Miners of a QB pool ranked by credits, from the highest balance, miners
+// with the same credits being ranked by id, with the sum of their credits
+// It is a treap whose nodes are indexed by miner id and counted by subtree, so
+// that updating the credits of a miner and the rank queries are in O(log M)
+class CreditRanking {
+public:
+  CreditRanking();
+
+  // Sets the credits of the miner, adding it to the ranking if needed
+  void set_credits(uint32_t miner_id, uint64_t credits);
+
+  // Returns the credits of a ranked miner, 0 otherwise
+  uint64_t get_credits(uint32_t miner_id) const;
+
+  bool contains(uint32_t miner_id) const;
+
+  // Returns the number of ranked miners
+  uint64_t size() const;
+
+  uint64_t get_credits_sum() const;
+
+  // Returns the miner at the given rank, 0 being the highest balance
+  // Throws std::out_of_range if rank >= size()
+  uint32_t at(uint64_t rank) const;
+
+  // Returns the rank of the miner, or size() if it is not ranked
+  uint64_t rank_of(uint32_t miner_id) const;
+
+  // Returns the miner ranked right after the given one, or invalid_miner_id if
+  // it is the last one or is not ranked
+  uint32_t successor_of(uint32_t miner_id) const;
+
+  // Returns the miners of the first k ranks
+  std::vector<uint32_t> top_n(uint64_t k) const;
+
+  void clear();
+
+private:
+  struct Node {
+    uint64_t credits;
+    uint32_t priority;
+    // number of nodes in the subtree, 0 when the miner is not ranked
+    uint32_t size;
+    uint32_t left;
+    uint32_t right;
+  };
+
+  // nodes by miner id
+  std::vector<Node> nodes;
+  uint32_t root;
+  uint64_t credits_sum = 0;
+
+  // whether the miner is ranked before the given balance and id
+  bool is_before(uint32_t miner_id, uint64_t credits, uint32_t other_id) const;
+  uint32_t get_size(uint32_t node) const;
+  void update_size(uint32_t node);
+
+  // splits the subtree between the miners ranked before the given balance and id and the others
+  void split(uint32_t node, uint64_t credits, uint32_t miner_id, uint32_t& left, uint32_t& right);
+  // merges two subtrees, the miners of `left` being ranked before the ones of `right`
+  uint32_t merge(uint32_t left, uint32_t right);
+  uint32_t erase(uint32_t node, uint32_t miner_id);
+};
+
+}
@@ -1,13 +1,13 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
 
 namespace poolsim {
 
 struct Event {
-  Event(const std::string& miner_address, double _time);
+  Event(uint32_t miner_id, double _time);
 
-  std::string miner_address;
+  uint32_t miner_id;
   double time;
 };
 
@@ -1,4 +1,7 @@
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
 
 #include "event_queue.h"
 #include "event.h"
@@ -9,31 +12,261 @@ char const* EmptyQueueException::what() const throw() {
   return "the queue is empty";
 }
 
-EventQueue::EventQueue() {}
+EventQueue::~EventQueue() {}
 
-size_t EventQueue::size() const {
-  return queue.size();
+bool EventQueue::is_empty() const {
+  return size() == 0;
 }
 
-void EventQueue::schedule(Event event) {
-  queue.push(event);
+
+size_t BinaryHeapEventQueue::size() const {
+  return heap.size();
 }
 
-Event EventQueue::pop() {
-  Event event = get_top();
-  queue.pop();
+void BinaryHeapEventQueue::schedule(const Event& event) {
+  heap.push_back(event);
+  std::push_heap(heap.begin(), heap.end(), CompareEvents());
+}
+
+Event BinaryHeapEventQueue::pop() {
+  std::pop_heap(heap.begin(), heap.end(), CompareEvents());
+  Event event = heap.back();
+  heap.pop_back();
   return event;
 }
 
-bool EventQueue::is_empty() const {
-  return queue.empty();
+Event BinaryHeapEventQueue::get_top() const {
+  if (heap.empty()) {
+    throw EmptyQueueException();
+  }
+  return heap.front();
+}
+
+std::vector<Event> BinaryHeapEventQueue::get_events() const {
+  return heap;
+}
+
+REGISTER(EventQueue, BinaryHeapEventQueue, "binary_heap")
+
+
+const size_t calendar_min_buckets = 2;
+// number of earliest events used to estimate the bucket width
+const size_t calendar_width_samples = 25;
+
+CalendarEventQueue::CalendarEventQueue()
+  : buckets(calendar_min_buckets) {}
+
+size_t CalendarEventQueue::size() const {
+  return count;
+}
+
+uint64_t CalendarEventQueue::slot_of(double time) const {
+  return static_cast<uint64_t>(time / width);
+}
+
+size_t CalendarEventQueue::bucket_of(uint64_t slot) const {
+  return slot % buckets.size();
+}
+
+void CalendarEventQueue::schedule(const Event& event) {
+  uint64_t slot = slot_of(event.time);
+  auto& bucket = buckets[bucket_of(slot)];
+  // buckets are sorted by decreasing time so that the earliest event is at the back
+  auto position = std::upper_bound(bucket.begin(), bucket.end(), event,
+    [](const Event& left, const Event& right) { return left.time > right.time; });
+  bucket.insert(position, event);
+  count++;
+
+  // the cursor must never be ahead of a pending event
+  if (slot < current_slot) {
+    current_slot = slot;
+  }
+
+  if (count > 2 * buckets.size()) {
+    resize(2 * buckets.size());
+  }
+}
+
+size_t CalendarEventQueue::find_min_bucket() const {
+  size_t min_bucket = 0;
+  bool found = false;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    if (buckets[i].empty()) {
+      continue;
+    }
+    if (!found || buckets[i].back().time < buckets[min_bucket].back().time) {
+      min_bucket = i;
+      found = true;
+    }
+  }
+  return min_bucket;
+}
+
+Event CalendarEventQueue::pop() {
+  size_t bucket_index = 0;
+  bool found = false;
+  // scan at most one year of slots starting from the cursor
+  for (size_t i = 0; i < buckets.size(); i++) {
+    bucket_index = bucket_of(current_slot);
+    const auto& bucket = buckets[bucket_index];
+    if (!bucket.empty() && slot_of(bucket.back().time) == current_slot) {
+      found = true;
+      break;
+    }
+    current_slot++;
+  }
+
+  // nothing in the current year, jump directly to the earliest event
+  if (!found) {
+    bucket_index = find_min_bucket();
+    current_slot = slot_of(buckets[bucket_index].back().time);
+  }
+
+  auto& bucket = buckets[bucket_index];
+  Event event = bucket.back();
+  bucket.pop_back();
+  count--;
+
+  if (buckets.size() > calendar_min_buckets && count < buckets.size() / 2) {
+    resize(buckets.size() / 2);
+  }
+  return event;
 }
 
-Event EventQueue::get_top() const {
-  if (is_empty()) {
+Event CalendarEventQueue::get_top() const {
+  if (count == 0) {
     throw EmptyQueueException();
   }
-  return queue.top();
+  return buckets[find_min_bucket()].back();
 }
 
+void CalendarEventQueue::resize(size_t buckets_count) {
+  std::vector<Event> events;
+  events.reserve(count);
+  for (auto& bucket : buckets) {
+    events.insert(events.end(), bucket.begin(), bucket.end());
+  }
+
+  // new width: a few times the average separation of the earliest events
+  size_t samples = std::min(events.size(), calendar_width_samples);
+  if (samples > 1) {
+    std::partial_sort(events.begin(), events.begin() + samples, events.end(),
+      [](const Event& left, const Event& right) { return left.time < right.time; });
+    double separation = (events[samples - 1].time - events[0].time) / (samples - 1);
+    if (separation > 0) {
+      width = 3.0 * separation;
+    }
+  }
+
+  buckets.assign(std::max(buckets_count, calendar_min_buckets), std::vector<Event>());
+  current_slot = events.empty() ? 0 : slot_of(events[0].time);
+  for (const Event& event : events) {
+    buckets[bucket_of(slot_of(event.time))].push_back(event);
+  }
+  for (auto& bucket : buckets) {
+    std::sort(bucket.begin(), bucket.end(),
+      [](const Event& left, const Event& right) { return left.time > right.time; });
+  }
+}
+
+std::vector<Event> CalendarEventQueue::get_events() const {
+  std::vector<Event> events;
+  events.reserve(count);
+  for (const auto& bucket : buckets) {
+    events.insert(events.end(), bucket.begin(), bucket.end());
+  }
+  return events;
+}
+
+REGISTER(EventQueue, CalendarEventQueue, "calendar")
+
+
+// one bucket for keys equal to `last` and one per bit of the key
+const size_t radix_buckets_count = 65;
+
+static inline uint64_t radix_key(double time) {
+  uint64_t key;
+  std::memcpy(&key, &time, sizeof(key));
+  return key;
+}
+
+RadixHeapEventQueue::RadixHeapEventQueue()
+  : buckets(radix_buckets_count) {}
+
+size_t RadixHeapEventQueue::size() const {
+  return count;
+}
+
+size_t RadixHeapEventQueue::bucket_of(uint64_t key) const {
+  if (key == last) {
+    return 0;
+  }
+  return 64 - __builtin_clzll(key ^ last);
+}
+
+void RadixHeapEventQueue::schedule(const Event& event) {
+  if (event.time < 0) {
+    throw std::invalid_argument("radix heap requires non-negative event times");
+  }
+  uint64_t key = radix_key(event.time);
+  if (key < last) {
+    throw std::invalid_argument("radix heap requires monotone event times");
+  }
+  buckets[bucket_of(key)].push_back(event);
+  count++;
+}
+
+Event RadixHeapEventQueue::pop() {
+  if (buckets[0].empty()) {
+    size_t i = 1;
+    while (buckets[i].empty()) {
+      i++;
+    }
+
+    // the minimum of the first non-empty bucket becomes the new reference
+    // and every element of that bucket moves to a strictly lower bucket
+    auto& bucket = buckets[i];
+    uint64_t new_last = radix_key(bucket[0].time);
+    for (const Event& event : bucket) {
+      new_last = std::min(new_last, radix_key(event.time));
+    }
+    last = new_last;
+    for (const Event& event : bucket) {
+      buckets[bucket_of(radix_key(event.time))].push_back(event);
+    }
+    bucket.clear();
+  }
+
+  Event event = buckets[0].back();
+  buckets[0].pop_back();
+  count--;
+  return event;
+}
+
+Event RadixHeapEventQueue::get_top() const {
+  if (count == 0) {
+    throw EmptyQueueException();
+  }
+  if (!buckets[0].empty()) {
+    return buckets[0].back();
+  }
+  size_t i = 1;
+  while (buckets[i].empty()) {
+    i++;
+  }
+  return *std::min_element(buckets[i].begin(), buckets[i].end(),
+    [](const Event& left, const Event& right) { return left.time < right.time; });
+}
+
+std::vector<Event> RadixHeapEventQueue::get_events() const {
+  std::vector<Event> events;
+  events.reserve(count);
+  for (const auto& bucket : buckets) {
+    events.insert(events.end(), bucket.begin(), bucket.end());
+  }
+  return events;
+}
+
+REGISTER(EventQueue, RadixHeapEventQueue, "radix_heap")
+
 }
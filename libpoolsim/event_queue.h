@@ -2,8 +2,10 @@
 
 #include <queue>
 #include <vector>
+#include <cstdint>
 
 #include "event.h"
+#include "factory.h"
 
 namespace poolsim {
 
@@ -12,26 +14,104 @@ public:
   virtual char const* what() const throw();
 };
 
+// Interface of the simulator event queue
+// Implementations are registered in EventQueueFactory and selected
+// through the `event_queue` key of the configuration
 class EventQueue {
-private:
-  std::priority_queue<Event, std::vector<Event>, CompareEvents> queue;
-  
 public:
-  EventQueue();
+  virtual ~EventQueue();
 
-  size_t size() const;
+  virtual size_t size() const = 0;
 
   // Schedules a new share event
-  void schedule(Event _event);
+  virtual void schedule(const Event& event) = 0;
 
-  // Pops and returns first element in event queue;
-  Event pop();
+  // Pops and returns first element in event queue
+  // The queue must not be empty
+  virtual Event pop() = 0;
 
   // Returns whether the event queue is empty or not
   bool is_empty() const;
 
   // Returns event first in queue
-  Event get_top() const;
+  // Throws EmptyQueueException if the queue is empty
+  virtual Event get_top() const = 0;
+
+  // Returns all the pending events, in no particular order
+  virtual std::vector<Event> get_events() const = 0;
+};
+
+MAKE_FACTORY(EventQueueFactory, EventQueue)
+
+
+// Binary heap, O(log n) schedule and pop
+class BinaryHeapEventQueue : public EventQueue,
+                             public Creatable0<EventQueue, BinaryHeapEventQueue> {
+public:
+  size_t size() const override;
+  void schedule(const Event& event) override;
+  Event pop() override;
+  Event get_top() const override;
+  std::vector<Event> get_events() const override;
+private:
+  std::vector<Event> heap;
+};
+
+
+// Calendar queue (Brown, 1988), amortized O(1) schedule and pop
+// when the distribution of pending event times is stable
+// Events are hashed by time into buckets of `width`, each bucket
+// being kept sorted with its earliest event at the back
+class CalendarEventQueue : public EventQueue,
+                           public Creatable0<EventQueue, CalendarEventQueue> {
+public:
+  CalendarEventQueue();
+
+  size_t size() const override;
+  void schedule(const Event& event) override;
+  Event pop() override;
+  Event get_top() const override;
+  std::vector<Event> get_events() const override;
+private:
+  std::vector<std::vector<Event>> buckets;
+  // time span covered by a single bucket
+  double width = 1.0;
+  // absolute index of the bucket-sized slot the cursor is at
+  uint64_t current_slot = 0;
+  size_t count = 0;
+
+  uint64_t slot_of(double time) const;
+  size_t bucket_of(uint64_t slot) const;
+  // returns the bucket holding the earliest event
+  size_t find_min_bucket() const;
+  // rebuilds the calendar with the given number of buckets
+  // and a width estimated from the earliest pending events
+  void resize(size_t buckets_count);
+};
+
+
+// Monotone radix heap on the IEEE-754 bit pattern of the event time,
+// which orders the same way as the time itself for non-negative values
+// Amortized O(1) schedule and O(log C) pop, but requires that no event
+// is scheduled earlier than the last popped one
+class RadixHeapEventQueue : public EventQueue,
+                            public Creatable0<EventQueue, RadixHeapEventQueue> {
+public:
+  RadixHeapEventQueue();
+
+  size_t size() const override;
+  void schedule(const Event& event) override;
+  Event pop() override;
+  Event get_top() const override;
+  std::vector<Event> get_events() const override;
+private:
+  // bucket i holds keys whose highest bit differing from `last` is i - 1
+  std::vector<std::vector<Event>> buckets;
+  // key of the last popped event
+  uint64_t last = 0;
+  size_t count = 0;
+
+  size_t bucket_of(uint64_t key) const;
 };
 
 }
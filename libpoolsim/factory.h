@@ -35,6 +35,14 @@ public:
   }
 };
 
+template <typename Base, typename T, typename Arg1, typename Arg2>
+class Creatable2 {
+public:
+  static std::unique_ptr<Base> create(Arg1 arg1, Arg2 arg2) {
+    return std::unique_ptr<T>(new T(arg1, arg2));
+  }
+};
+
 
 template <typename T, typename CreateMethod>
 class Factory {
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <random>
+
+#include "fast_forward.h"
+
+namespace poolsim {
+
+static std::vector<double> get_hashrates(const std::vector<std::shared_ptr<Miner>>& miners) {
+  std::vector<double> hashrates;
+  for (auto miner : miners) {
+    hashrates.push_back(miner->get_hashrate());
+  }
+  return hashrates;
+}
+
+
+FastForwardPool::FastForwardPool(std::shared_ptr<MiningPool> _pool,
+                                 std::vector<std::shared_ptr<Miner>> _miners,
+                                 uint64_t network_difficulty,
+                                 std::shared_ptr<Random> _random)
+  : pool(_pool), miners(_miners), random(_random), sampler(get_hashrates(_miners)),
+    block_probability((double) _pool->get_difficulty() / network_difficulty) {
+  share_rate = sampler.get_total_weight() / pool->get_difficulty();
+}
+
+bool FastForwardPool::is_eligible(const std::shared_ptr<MiningPool>& pool,
+                                  const std::vector<std::shared_ptr<Miner>>& miners) {
+  if (pool->needs_individual_shares() || miners.empty()) {
+    return false;
+  }
+  double total_hashrate = 0;
+  for (auto miner : miners) {
+    if (miner->needs_individual_shares() || miner->can_change_pool()) {
+      return false;
+    }
+    total_hashrate += miner->get_hashrate();
+  }
+  return total_hashrate > 0;
+}
+
+void FastForwardPool::start_round(double time) {
+  auto engine = random->get_random_engine();
+
+  // number of shares before the first one being a valid block
+  round_shares = 0;
+  if (block_probability < 1) {
+    std::geometric_distribution<uint64_t> geometric(block_probability);
+    round_shares = geometric(*engine);
+  }
+
+  // the valid block is the share number round_shares + 1 of a Poisson process
+  std::gamma_distribution<double> gamma(round_shares + 1, 1 / share_rate);
+  round_start = time;
+  next_block_time = time + gamma(*engine);
+}
+
+double FastForwardPool::get_next_block_time() const {
+  return next_block_time;
+}
+
+std::shared_ptr<Miner> FastForwardPool::complete_round() {
+  distribute(round_shares);
+  round_shares = 0;
+  return miners[sampler.sample(random->drand48())];
+}
+
+void FastForwardPool::settle(double time) {
+  if (round_shares == 0 || time <= round_start) {
+    return;
+  }
+
+  // given the time of the valid block, the times of the shares before it
+  // are uniformly distributed over the round
+  double fraction = std::min(1.0, (time - round_start) / (next_block_time - round_start));
+  std::binomial_distribution<uint64_t> binomial(round_shares, fraction);
+  uint64_t count = binomial(*random->get_random_engine());
+
+  distribute(count);
+  round_shares -= count;
+  round_start = time;
+}
+
+std::shared_ptr<MiningPool> FastForwardPool::get_pool() const {
+  return pool;
+}
+
+void FastForwardPool::save(CheckpointWriter& writer) const {
+  writer.write(round_start);
+  writer.write(next_block_time);
+  writer.write(round_shares);
+}
+
+void FastForwardPool::load(CheckpointReader& reader) {
+  reader.read(round_start);
+  reader.read(next_block_time);
+  reader.read(round_shares);
+}
+
+void FastForwardPool::distribute(uint64_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  std::vector<uint64_t> counts(miners.size(), 0);
+  if (count < miners.size()) {
+    for (uint64_t i = 0; i < count; i++) {
+      counts[sampler.sample(random->drand48())]++;
+    }
+  } else {
+    // multinomial as a sequence of binomials, each miner getting a share
+    // of what is left proportionally to its part of the remaining hashrate
+    auto engine = random->get_random_engine();
+    size_t last = miners.size() - 1;
+    while (last > 0 && sampler.get_weight(last) <= 0) {
+      last--;
+    }
+    double remaining_weight = sampler.get_total_weight();
+    uint64_t remaining = count;
+    for (size_t i = 0; i <= last && remaining > 0; i++) {
+      double weight = sampler.get_weight(i);
+      if (i == last || weight >= remaining_weight) {
+        counts[i] = remaining;
+      } else {
+        std::binomial_distribution<uint64_t> binomial(remaining, weight / remaining_weight);
+        counts[i] = binomial(*engine);
+      }
+      remaining -= counts[i];
+      remaining_weight -= weight;
+    }
+  }
+
+  for (size_t i = 0; i < miners.size(); i++) {
+    if (counts[i] > 0) {
+      miners[i]->process_shares(counts[i]);
+    }
+  }
+}
+
+}
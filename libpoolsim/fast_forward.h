@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "miner.h"
+#include "mining_pool.h"
+#include "random.h"
+#include "weighted_sampler.h"
+
+namespace poolsim {
+
+// Generates the rounds of a pool whose reward scheme and miners only
+// depend on the number of shares each miner submitted in a round
+// Rather than generating every share, the number of shares before the next
+// valid block is drawn from a geometric distribution and split across the
+// miners with a multinomial draw, proportionally to their hashrate
+// The valid block itself still goes through the exact per-share path
+class FastForwardPool {
+public:
+  FastForwardPool(std::shared_ptr<MiningPool> pool,
+                  std::vector<std::shared_ptr<Miner>> miners,
+                  uint64_t network_difficulty,
+                  std::shared_ptr<Random> random);
+
+  // Returns whether the pool and all its miners only depend on share counts
+  static bool is_eligible(const std::shared_ptr<MiningPool>& pool,
+                          const std::vector<std::shared_ptr<Miner>>& miners);
+
+  // Draws the next round, starting at the given time
+  void start_round(double time);
+
+  // Returns the time at which the next valid block of the pool is found
+  double get_next_block_time() const;
+
+  // Submits the shares of the current round preceding the valid block
+  // and returns the miner who found the block
+  std::shared_ptr<Miner> complete_round();
+
+  // Submits the shares of the current round found before the given time,
+  // used to account for the work done when the simulation stops mid-round
+  void settle(double time);
+
+  std::shared_ptr<MiningPool> get_pool() const;
+
+  // Writes the current round to a checkpoint
+  void save(CheckpointWriter& writer) const;
+
+  // Restores the round written by save()
+  void load(CheckpointReader& reader);
+
+private:
+  std::shared_ptr<MiningPool> pool;
+  std::vector<std::shared_ptr<Miner>> miners;
+  std::shared_ptr<Random> random;
+
+  // picks a miner proportionally to its hashrate
+  AliasTable sampler;
+  // probability for a share of the pool to be a valid block
+  double block_probability;
+  // expected number of shares of the pool per time unit
+  double share_rate = 0;
+
+  double round_start = 0;
+  double next_block_time = 0;
+  // number of shares that are not valid blocks in the current round
+  uint64_t round_shares = 0;
+
+  // splits `count` shares across the miners and submits them
+  void distribute(uint64_t count);
+};
+
+}
@@ -0,0 +1,139 @@
+#include "fast_math.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define POOLSIM_AVX2_LOG
+#include <immintrin.h>
+#endif
+
+namespace poolsim {
+
+namespace {
+
+// fdlibm e_log.c coefficients
+const double ln2_hi = 6.93147180369123816490e-01;
+const double ln2_lo = 1.90821492927058770002e-10;
+const double sqrt2 = 1.41421356237309504880;
+const double lg1 = 6.666666666666735130e-01;
+const double lg2 = 3.999999999940941908e-01;
+const double lg3 = 2.857142874366239149e-01;
+const double lg4 = 2.222219843214978396e-01;
+const double lg5 = 1.818357216161805012e-01;
+const double lg6 = 1.531383769920937332e-01;
+const double lg7 = 1.479819860511658591e-01;
+
+const uint64_t mantissa_mask = 0x000fffffffffffffULL;
+const uint64_t one_bits = 0x3ff0000000000000ULL;
+// adding 2^52 as integer bits and subtracting it as a double converts
+// a small positive integer to a double
+const uint64_t two52_bits = 0x4330000000000000ULL;
+const double two52 = 4503599627370496.0;
+
+}
+
+double fast_log(double x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+
+  // x = m * 2^e with m in [sqrt(2)/2, sqrt(2))
+  uint64_t m_bits = (bits & mantissa_mask) | one_bits;
+  uint64_t e_bits = (bits >> 52) | two52_bits;
+  double m, e;
+  std::memcpy(&m, &m_bits, sizeof(m));
+  std::memcpy(&e, &e_bits, sizeof(e));
+  e = e - two52 - 1023.0;
+  if (m > sqrt2) {
+    m = m * 0.5;
+    e = e + 1.0;
+  }
+
+  // log(m) = log(1 + f) = 2 atanh(s) with s = f / (2 + f)
+  double f = m - 1.0;
+  double s = f / (2.0 + f);
+  double z = s * s;
+  double w = z * z;
+  double t1 = w * (lg2 + w * (lg4 + w * lg6));
+  double t2 = z * (lg1 + w * (lg3 + w * (lg5 + w * lg7)));
+  double r = t2 + t1;
+  double hfsq = 0.5 * f * f;
+  return e * ln2_hi - ((hfsq - (s * (hfsq + r) + e * ln2_lo)) - f);
+}
+
+#ifdef POOLSIM_AVX2_LOG
+
+// Same operations as fast_log, four values at a time
+// Only compiled for AVX2, the caller checks that the CPU supports it
+__attribute__((target("avx2")))
+static void log_batch_avx2(const double* input, double* output, size_t count) {
+  const __m256i mantissa = _mm256_set1_epi64x(mantissa_mask);
+  const __m256i one = _mm256_set1_epi64x(one_bits);
+  const __m256i two52_int = _mm256_set1_epi64x(two52_bits);
+  const __m256d bias = _mm256_set1_pd(two52 + 1023.0);
+  const __m256d sqrt2_v = _mm256_set1_pd(sqrt2);
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d one_v = _mm256_set1_pd(1.0);
+  const __m256d two = _mm256_set1_pd(2.0);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i bits = _mm256_castpd_si256(_mm256_loadu_pd(input + i));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissa), one));
+    __m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), two52_int));
+    e = _mm256_sub_pd(e, bias);
+    __m256d above = _mm256_cmp_pd(m, sqrt2_v, _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), above);
+    e = _mm256_add_pd(e, _mm256_and_pd(above, one_v));
+
+    __m256d f = _mm256_sub_pd(m, one_v);
+    __m256d s = _mm256_div_pd(f, _mm256_add_pd(two, f));
+    __m256d z = _mm256_mul_pd(s, s);
+    __m256d w = _mm256_mul_pd(z, z);
+    __m256d t1 = _mm256_add_pd(_mm256_set1_pd(lg4), _mm256_mul_pd(w, _mm256_set1_pd(lg6)));
+    t1 = _mm256_add_pd(_mm256_set1_pd(lg2), _mm256_mul_pd(w, t1));
+    t1 = _mm256_mul_pd(w, t1);
+    __m256d t2 = _mm256_add_pd(_mm256_set1_pd(lg5), _mm256_mul_pd(w, _mm256_set1_pd(lg7)));
+    t2 = _mm256_add_pd(_mm256_set1_pd(lg3), _mm256_mul_pd(w, t2));
+    t2 = _mm256_add_pd(_mm256_set1_pd(lg1), _mm256_mul_pd(w, t2));
+    t2 = _mm256_mul_pd(z, t2);
+    __m256d r = _mm256_add_pd(t2, t1);
+    __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(half, f), f);
+
+    __m256d low = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, r)),
+                                _mm256_mul_pd(e, _mm256_set1_pd(ln2_lo)));
+    __m256d result = _mm256_sub_pd(_mm256_mul_pd(e, _mm256_set1_pd(ln2_hi)),
+                                   _mm256_sub_pd(_mm256_sub_pd(hfsq, low), f));
+    _mm256_storeu_pd(output + i, result);
+  }
+  for (; i < count; i++) {
+    output[i] = fast_log(input[i]);
+  }
+}
+
+bool has_avx2_log() {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+
+#else
+
+bool has_avx2_log() {
+  return false;
+}
+
+#endif
+
+void log_batch(const double* input, double* output, size_t count) {
+#ifdef POOLSIM_AVX2_LOG
+  if (has_avx2_log()) {
+    log_batch_avx2(input, output, count);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < count; i++) {
+    output[i] = fast_log(input[i]);
+  }
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+namespace poolsim {
+
+// Natural logarithm of a positive normal double, within 1 ulp
+// Same polynomial as fdlibm, without the handling of special values
+double fast_log(double x);
+
+// Computes the natural logarithm of `count` positive normal doubles
+// `output` may be the same array as `input`
+// Runs four values at a time with AVX2 when the CPU supports it,
+// and falls back to fast_log() otherwise
+void log_batch(const double* input, double* output, size_t count);
+
+// Returns whether log_batch runs the AVX2 kernel on this CPU
+bool has_avx2_log();
+
+}
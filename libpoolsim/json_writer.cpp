@@ -0,0 +1,103 @@
+#include "json_writer.h"
+
+namespace poolsim {
+
+Selection::Selection() : all(true) {}
+
+Selection::Selection(const std::set<std::string>& _names) : all(false), names(_names) {}
+
+bool Selection::has(const std::string& name) const {
+  return all || names.find(name) != names.end();
+}
+
+bool Selection::has_all() const {
+  return all;
+}
+
+
+JsonWriter::JsonWriter(std::ostream& _stream, int _indent) : stream(_stream), indent(_indent) {}
+
+void JsonWriter::begin_object() {
+  begin_value();
+  stream << '{';
+  levels.push_back(0);
+}
+
+void JsonWriter::end_object() {
+  end_container('}');
+}
+
+void JsonWriter::begin_array() {
+  begin_value();
+  stream << '[';
+  levels.push_back(0);
+}
+
+void JsonWriter::end_array() {
+  end_container(']');
+}
+
+void JsonWriter::key(const std::string& name) {
+  begin_value();
+  stream << nlohmann::json(name) << (indent >= 0 ? ": " : ":");
+  after_key = true;
+}
+
+void JsonWriter::value(const nlohmann::json& value) {
+  if (value.is_object()) {
+    begin_object();
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      key(it.key());
+      this->value(it.value());
+    }
+    end_object();
+  } else if (value.is_array()) {
+    begin_array();
+    for (const auto& element : value) {
+      this->value(element);
+    }
+    end_array();
+  } else {
+    begin_value();
+    stream << value;
+  }
+}
+
+uint64_t JsonWriter::begin_entry() {
+  begin_value();
+  // the value itself does not write the separator again
+  after_key = true;
+  return get_position();
+}
+
+uint64_t JsonWriter::get_position() {
+  return static_cast<uint64_t>(stream.tellp());
+}
+
+void JsonWriter::begin_value() {
+  if (after_key) {
+    after_key = false;
+    return;
+  }
+  if (levels.empty()) {
+    return;
+  }
+  if (levels.back()++ > 0) {
+    stream << ',';
+  }
+  if (indent >= 0) {
+    stream << '\n' << std::string(levels.size() * indent, ' ');
+  }
+}
+
+void JsonWriter::end_container(char bracket) {
+  size_t count = levels.back();
+  levels.pop_back();
+  // empty objects and arrays stay on one line
+  if (count > 0 && indent >= 0) {
+    stream << '\n' << std::string(levels.size() * indent, ' ');
+  }
+  stream << bracket;
+}
+
+}
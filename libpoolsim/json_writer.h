@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace poolsim {
+
+// Names of what is written to the output, e.g. the fields of an object,
+// either all of them or a selection
+class Selection {
+public:
+  // Selects everything
+  Selection();
+  explicit Selection(const std::set<std::string>& names);
+
+  bool has(const std::string& name) const;
+
+  // Returns whether everything is selected
+  bool has_all() const;
+
+private:
+  bool all;
+  std::set<std::string> names;
+};
+
+
+// Writes json to a stream as it is produced, without building the document in memory
+// The output is the same as nlohmann::json::dump with the same indent, as long as the keys
+// of each object are written in alphabetical order, which is the order of nlohmann objects
+class JsonWriter {
+public:
+  // `indent` is the number of spaces per level, or -1 for a single line
+  explicit JsonWriter(std::ostream& stream, int indent = -1);
+
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+
+  // Writes the key of the next value, inside an object
+  void key(const std::string& name);
+
+  // Writes a value, which can be any json, including objects and arrays
+  void value(const nlohmann::json& value);
+
+  // Writes any value which can be converted to json, e.g. a number or a vector
+  template <typename T>
+  void value(const T& value);
+
+  // Writes the key and the value
+  template <typename T>
+  void field(const std::string& name, const T& value);
+
+  // Writes the separator and the indentation of the next value, and
+  // returns the position of the stream where the value starts
+  uint64_t begin_entry();
+
+  // Returns the current position of the stream
+  uint64_t get_position();
+
+private:
+  std::ostream& stream;
+  int indent;
+  // number of values written in each open object or array
+  std::vector<size_t> levels;
+  // whether the next value follows a key, on the same line
+  bool after_key = false;
+
+  // Writes the separator and the indentation preceding a value
+  void begin_value();
+  // Closes the current object or array with `bracket`
+  void end_container(char bracket);
+};
+
+template <typename T>
+void JsonWriter::value(const T& value) {
+  // numbers, booleans and strings are serialized by nlohmann, as in a document
+  this->value(nlohmann::json(value));
+}
+
+template <typename T>
+void JsonWriter::field(const std::string& name, const T& value) {
+  key(name);
+  this->value(value);
+}
+
+}
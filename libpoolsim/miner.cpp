@@ -7,7 +7,8 @@ namespace poolsim {
 
 
 Miner::Miner(std::string _address, double _hashrate, std::shared_ptr<Network> _network)
-  : address(_address), hashrate(_hashrate), network(_network) {}
+  : address(_address), id(_network->get_miner_id(_address)),
+    hashrate(_hashrate), network(_network) {}
 
 std::shared_ptr<Miner> Miner::create(std::string address, double hashrate,
                     std::unique_ptr<ShareHandler> handler,
@@ -22,6 +23,8 @@ std::shared_ptr<Miner> Miner::create(std::string address, double hashrate,
 
 std::string Miner::get_address() const { return address; }
 
+uint32_t Miner::get_id() const { return id; }
+
 double Miner::get_hashrate() const { return hashrate; }
 
 std::shared_ptr<MiningPool> Miner::get_pool() const {
@@ -47,11 +50,11 @@ std::string Miner::get_handler_name() const {
 
 void Miner::join_pool(std::shared_ptr<MiningPool> _pool) {
   if (get_pool() != nullptr) {
-    get_pool()->leave(get_address());
+    get_pool()->leave(get_id());
     pool.reset();
   }
   pool = _pool;
-  get_pool()->join(get_address());
+  get_pool()->join(get_id());
 }
 
 void Miner::process_share(const Share& share) {
@@ -62,15 +65,48 @@ void Miner::process_share(const Share& share) {
     share_handler->handle_share(share);
 }
 
+void Miner::process_shares(uint64_t count) {
+    total_work += count * get_pool()->get_difficulty();
+    share_handler->handle_shares(count);
+}
+
 void Miner::set_handler(std::unique_ptr<ShareHandler> _share_handler) {
   share_handler = std::move(_share_handler);
   share_handler->set_miner(shared_from_this());
 }
 
+void Miner::set_random(std::shared_ptr<Random> random) {
+  share_handler->set_random(random);
+}
+
+void Miner::set_metadata_enabled(bool enabled) {
+  share_handler->set_metadata_enabled(enabled);
+}
+
 nlohmann::json Miner::get_handler_metadata() const {
     return share_handler->get_json_metadata();
 }
 
+bool Miner::can_change_pool() const {
+    return share_handler != nullptr && share_handler->can_change_pool();
+}
+
+bool Miner::needs_individual_shares() const {
+    return share_handler == nullptr || share_handler->needs_individual_shares();
+}
+
+void Miner::save(CheckpointWriter& writer) const {
+    writer.write(blocks_found);
+    writer.write(total_work);
+    share_handler->save(writer);
+}
+
+void Miner::load(CheckpointReader& reader) {
+    reader.read(blocks_found);
+    reader.read(total_work);
+    share_handler->load(reader);
+}
+
 void to_json(nlohmann::json& j, const Miner& miner) {
     j["address"] = miner.get_address();
     j["behavior"] = miner.get_handler_name();
@@ -80,4 +116,28 @@ void to_json(nlohmann::json& j, const Miner& miner) {
     j["handler_metadata"] = miner.get_handler_metadata();
 }
 
+void write(JsonWriter& writer, const Miner& miner, const Selection& fields) {
+    writer.begin_object();
+    if (fields.has("address")) {
+        writer.field("address", miner.get_address());
+    }
+    if (fields.has("behavior")) {
+        writer.field("behavior", miner.get_handler_name());
+    }
+    if (fields.has("blocks_found")) {
+        writer.field("blocks_found", miner.get_blocks_found());
+    }
+    if (fields.has("handler_metadata")) {
+        writer.key("handler_metadata");
+        writer.value(miner.get_handler_metadata());
+    }
+    if (fields.has("hashrate")) {
+        writer.field("hashrate", miner.get_hashrate());
+    }
+    if (fields.has("total_work")) {
+        writer.field("total_work", miner.get_total_work());
+    }
+    writer.end_object();
+}
+
 }
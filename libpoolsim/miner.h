@@ -23,14 +23,25 @@ public:
     virtual ~Miner() {}
 
     std::string get_address() const;
+    // Returns the dense id of the miner, used on the simulation hot path
+    uint32_t get_id() const;
     double get_hashrate() const;
     std::shared_ptr<MiningPool> get_pool() const;
 
     void set_handler(std::unique_ptr<ShareHandler> handler);
 
+    // Sets the random instance used by the share handler
+    void set_random(std::shared_ptr<Random> random);
+
+    // Sets whether the share handler records the events of its metadata
+    void set_metadata_enabled(bool enabled);
+
     // Processes the share by delegating to different strategies
     virtual void process_share(const Share& share);
 
+    // Processes `count` shares which are not valid blocks at once
+    void process_shares(uint64_t count);
+
     // Joins the given pool, updates the state of the pool too
     void join_pool(std::shared_ptr<MiningPool> pool);
 
@@ -48,11 +59,23 @@ public:
 
     // returns the metadata of the handler
     nlohmann::json get_handler_metadata() const;
+
+    // returns whether the handler may make the miner change pool
+    bool can_change_pool() const;
+
+    // returns whether the handler needs to see each share which is not a valid block
+    bool needs_individual_shares() const;
+    // Writes the counters and the handler state to a checkpoint
+    // The pool of the miner is restored by the simulator
+    void save(CheckpointWriter& writer) const;
+    // Restores the state written by save()
+    void load(CheckpointReader& reader);
 protected:
     Miner(std::string _address, double _hashrate, std::shared_ptr<Network> network);
 
 private:
     std::string address;
+    uint32_t id;
     double hashrate;
     std::weak_ptr<MiningPool> pool;
 
@@ -65,4 +88,7 @@ private:
 
 void to_json(nlohmann::json& j, const Miner& data);
 
+// writes the same json as to_json, with only the selected fields
+void write(JsonWriter& writer, const Miner& miner, const Selection& fields = Selection());
+
 }
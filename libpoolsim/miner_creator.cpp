@@ -31,18 +31,36 @@ bool MinersCountStopCondition::should_stop(const MinerCreationState& state) {
 REGISTER(MinerCreatorStopCondition, MinersCountStopCondition, "miners_count")
 
 
-MinerCreator::MinerCreator(std::shared_ptr<Network> network)
-    : MinerCreator(network, SystemRandom::get_instance()) {}
 MinerCreator::MinerCreator(std::shared_ptr<Network> _network, std::shared_ptr<Random> _random)
     : network(_network), random(_random) {}
 
+std::unique_ptr<ShareHandler> MinerCreator::create_share_handler(const std::string& name,
+                                                                 const nlohmann::json& params) {
+    auto share_handler = ShareHandlerFactory::create(name, params, random);
+    share_handler->initialize();
+    return share_handler;
+}
 
-CSVMinerCreator::CSVMinerCreator(std::shared_ptr<Network> network)
-    : MinerCreator(network) {}
+std::vector<std::shared_ptr<Miner>> MinerCreator::create_miners(const json& args) {
+    return create_miners(create_specs(args));
+}
 
+std::vector<std::shared_ptr<Miner>> MinerCreator::create_miners(const std::vector<MinerSpec>& specs) {
+    std::vector<std::shared_ptr<Miner>> miners;
+    for (const MinerSpec& spec : specs) {
+        auto share_handler = create_share_handler(spec.behavior_name, spec.behavior_params);
+        miners.push_back(Miner::create(spec.address, spec.hashrate, std::move(share_handler), network));
+    }
+    return miners;
+}
 
-std::vector<std::shared_ptr<Miner>> CSVMinerCreator::create_miners(const nlohmann::json& args) {
-  std::vector<std::shared_ptr<Miner>> miners;
+
+CSVMinerCreator::CSVMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random)
+    : MinerCreator(network, random) {}
+
+
+std::vector<MinerSpec> CSVMinerCreator::create_specs(const nlohmann::json& args) {
+  std::vector<MinerSpec> specs;
   std::string filepath = args["path"];
   io::CSVReader<3> in(filepath);
   in.read_header(io::ignore_missing_column, "address", "hashrate", "behavior");
@@ -57,25 +75,23 @@ std::vector<std::shared_ptr<Miner>> CSVMinerCreator::create_miners(const nlohman
     if (behavior_params.find(behavior_name) != behavior_params.end()) {
         behavior_params = behavior_params[behavior_name];
     }
-    auto share_handler = ShareHandlerFactory::create(behavior_name, behavior_params);
-    auto miner = Miner::create(address, hashrate, std::move(share_handler), network);
-    miners.push_back(miner);
+    specs.push_back(MinerSpec {address, hashrate, behavior_name, behavior_params});
     behavior_name.clear();
   }
 
-  return miners;
+  return specs;
 }
 
 REGISTER(MinerCreator, CSVMinerCreator, "csv")
 
 
-RandomMinerCreator::RandomMinerCreator(std::shared_ptr<Network> network)
-    : MinerCreator(network) {}
+RandomMinerCreator::RandomMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random)
+    : MinerCreator(network, random) {}
 
-std::vector<std::shared_ptr<Miner>> RandomMinerCreator::create_miners(const nlohmann::json& args) {
-  std::vector<std::shared_ptr<Miner>> miners;
+std::vector<MinerSpec> RandomMinerCreator::create_specs(const nlohmann::json& args) {
+  std::vector<MinerSpec> specs;
   auto hashrate_distribution = DistributionFactory::create(args["hashrate"]["distribution"],
-                                                           args["hashrate"]["params"]);
+                                                           args["hashrate"]["params"], random);
   auto stop_condition = MinerCreatorStopConditionFactory::create(args["stop_condition"]["type"],
                                                                  args["stop_condition"]["params"]);
   MinerCreationState state;
@@ -95,34 +111,30 @@ std::vector<std::shared_ptr<Miner>> RandomMinerCreator::create_miners(const nloh
 
     std::string address = random->get_address();
     auto behavior_params = args["behavior"].value("params", json::object());
-    auto share_handler = ShareHandlerFactory::create(args["behavior"]["name"], behavior_params);
-    auto miner = Miner::create(address, hashrate, std::move(share_handler), network);
-    miners.push_back(miner);
+    specs.push_back(MinerSpec {address, hashrate, args["behavior"]["name"], behavior_params});
     state.miners_count++;
     state.total_hashrate += hashrate;
   }
-  return miners;
+  return specs;
 }
 
 REGISTER(MinerCreator, RandomMinerCreator, "random")
 
-InlineMinerCreator::InlineMinerCreator(std::shared_ptr<Network> network)
-    : MinerCreator(network) {}
+InlineMinerCreator::InlineMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random)
+    : MinerCreator(network, random) {}
 
 
-std::vector<std::shared_ptr<Miner>> InlineMinerCreator::create_miners(const json& args) {
-    std::vector<std::shared_ptr<Miner>> miners;
+std::vector<MinerSpec> InlineMinerCreator::create_specs(const json& args) {
+    std::vector<MinerSpec> specs;
     for (const json& miner_info : args["miners"]) {
         std::string address = miner_info.value("address", random->get_address());
         double hashrate = miner_info["hashrate"];
         json behavior_info = miner_info.value("behavior", json::object());
         json behavior_params = behavior_info.value("params", json::object());
         std::string behavior_name = behavior_info.value("name", "default");
-        auto share_handler = ShareHandlerFactory::create(behavior_name, behavior_params);
-        auto miner = Miner::create(address, hashrate, std::move(share_handler), network);
-        miners.push_back(miner);
+        specs.push_back(MinerSpec {address, hashrate, behavior_name, behavior_params});
     }
-    return miners;
+    return specs;
 }
 
 REGISTER(MinerCreator, InlineMinerCreator, "inline")
@@ -23,6 +23,14 @@ public:
   virtual bool should_stop(const MinerCreationState& state) = 0;
 };
 
+// Description of a miner, from which the miner can be created in any simulation
+struct MinerSpec {
+  std::string address;
+  double hashrate;
+  std::string behavior_name;
+  nlohmann::json behavior_params;
+};
+
 MAKE_FACTORY(MinerCreatorStopConditionFactory, MinerCreatorStopCondition, const nlohmann::json&)
 
 class TotalHashrateStopCondition :
@@ -49,37 +57,54 @@ private:
 
 class MinerCreator {
 public:
-    explicit MinerCreator(std::shared_ptr<Network> network);
-    MinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> _random);
-    virtual std::vector<std::shared_ptr<Miner>> create_miners(const nlohmann::json& args) = 0;
+    MinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random);
+
+    // Generates the description of the miners from the config
+    // This is where the random addresses and hashrates are drawn
+    virtual std::vector<MinerSpec> create_specs(const nlohmann::json& args) = 0;
+
+    // Creates the miners described in the config
+    std::vector<std::shared_ptr<Miner>> create_miners(const nlohmann::json& args);
+
+    // Creates the miners from their description, e.g. to reuse a population
+    // generated once in several simulations
+    std::vector<std::shared_ptr<Miner>> create_miners(const std::vector<MinerSpec>& specs);
 protected:
     std::shared_ptr<Network> network;
+    // random instance used to generate addresses and hashrates
     std::shared_ptr<Random> random;
+
+    // Creates and initializes a share handler with the random instance of the creator
+    std::unique_ptr<ShareHandler> create_share_handler(const std::string& name,
+                                                       const nlohmann::json& params);
 };
 
 class CSVMinerCreator : public MinerCreator,
-                        public Creatable1<MinerCreator, CSVMinerCreator, std::shared_ptr<Network>> {
+                        public Creatable2<MinerCreator, CSVMinerCreator,
+                                          std::shared_ptr<Network>, std::shared_ptr<Random>> {
 public:
-    explicit CSVMinerCreator(std::shared_ptr<Network> network);
-    std::vector<std::shared_ptr<Miner>> create_miners(const nlohmann::json& args) override;
+    CSVMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random);
+    std::vector<MinerSpec> create_specs(const nlohmann::json& args) override;
 };
 
 class RandomMinerCreator : public MinerCreator,
-                           public Creatable1<MinerCreator, RandomMinerCreator, std::shared_ptr<Network>> {
+                           public Creatable2<MinerCreator, RandomMinerCreator,
+                                             std::shared_ptr<Network>, std::shared_ptr<Random>> {
 public:
-    explicit RandomMinerCreator(std::shared_ptr<Network> network);
-    std::vector<std::shared_ptr<Miner>> create_miners(const nlohmann::json& args) override;
+    RandomMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random);
+    std::vector<MinerSpec> create_specs(const nlohmann::json& args) override;
 };
 
 class InlineMinerCreator : public MinerCreator,
-                           public Creatable1<MinerCreator, InlineMinerCreator, std::shared_ptr<Network>> {
+                           public Creatable2<MinerCreator, InlineMinerCreator,
+                                             std::shared_ptr<Network>, std::shared_ptr<Random>> {
 public:
-    explicit InlineMinerCreator(std::shared_ptr<Network> network);
-    std::vector<std::shared_ptr<Miner>> create_miners(const nlohmann::json& args) override;
+    InlineMinerCreator(std::shared_ptr<Network> network, std::shared_ptr<Random> random);
+    std::vector<MinerSpec> create_specs(const nlohmann::json& args) override;
 };
 
 
 
-MAKE_FACTORY(MinerCreatorFactory, MinerCreator, std::shared_ptr<Network>)
+MAKE_FACTORY(MinerCreatorFactory, MinerCreator, std::shared_ptr<Network>, std::shared_ptr<Random>)
 
 }
@@ -1,14 +1,84 @@
 #include "miner_record.h"
+#include <stdexcept>
 #include <string>
 
 namespace poolsim {
 
-MinerRecord::MinerRecord(std::string miner_address) : address(miner_address) {}
+uint32_t RecordStore::add(uint32_t miner_id) {
+    miner_ids.push_back(miner_id);
+    blocks_mined.push_back(0);
+    uncles_mined.push_back(0);
+    shares_count.push_back(0);
+    shares_per_round.push_back(0);
+    blocks_received.push_back(0);
+    uncles_received.push_back(0);
+    credits.push_back(0);
+    avg_credits_per_block.push_back(0);
+    return miner_ids.size() - 1;
+}
+
+uint32_t RecordStore::size() const {
+    return miner_ids.size();
+}
+
+void RecordStore::clear() {
+    *this = RecordStore();
+}
+
+void RecordStore::save(CheckpointWriter& writer) const {
+    writer.write(miner_ids);
+    writer.write(blocks_mined);
+    writer.write(uncles_mined);
+    writer.write(shares_count);
+    writer.write(shares_per_round);
+    writer.write(blocks_received);
+    writer.write(uncles_received);
+    writer.write(credits);
+    writer.write(avg_credits_per_block);
+}
+
+void RecordStore::load(CheckpointReader& reader) {
+    reader.read(miner_ids);
+    reader.read(blocks_mined);
+    reader.read(uncles_mined);
+    reader.read(shares_count);
+    reader.read(shares_per_round);
+    reader.read(blocks_received);
+    reader.read(uncles_received);
+    reader.read(credits);
+    reader.read(avg_credits_per_block);
+    size_t records = miner_ids.size();
+    if (blocks_mined.size() != records || uncles_mined.size() != records || shares_count.size() != records ||
+        shares_per_round.size() != records || blocks_received.size() != records ||
+        uncles_received.size() != records || credits.size() != records ||
+        avg_credits_per_block.size() != records) {
+        throw std::invalid_argument("invalid records in checkpoint");
+    }
+}
+
+void RecordView::update_avg_credits_per_block() {
+    if (store->blocks_received[slot])
+        store->avg_credits_per_block[slot] =
+            (store->avg_credits_per_block[slot] + store->credits[slot])/store->blocks_received[slot];
+}
+
+MinerRecord::MinerRecord(uint32_t _miner_id, std::string miner_address)
+    : miner_id(_miner_id), address(miner_address) {}
+
+MinerRecord::MinerRecord(const RecordStore& store, uint32_t slot, std::string miner_address)
+    : blocks_mined(store.blocks_mined[slot]), uncles_mined(store.uncles_mined[slot]),
+      shares_count(store.shares_count[slot]), shares_per_round(store.shares_per_round[slot]),
+      blocks_received(store.blocks_received[slot]), uncles_received(store.uncles_received[slot]),
+      miner_id(store.miner_ids[slot]), address(miner_address) {}
 
 std::string MinerRecord::get_miner_address() const {
     return address;
 }
 
+uint32_t MinerRecord::get_miner_id() const {
+    return miner_id;
+}
+
 void MinerRecord::inc_blocks_mined() {
     blocks_mined++;
 }
@@ -33,6 +103,10 @@ void MinerRecord::inc_shares_per_round() {
     shares_per_round++;
 }
 
+void MinerRecord::inc_shares_per_round(uint64_t count) {
+    shares_per_round += count;
+}
+
 void MinerRecord::reset_shares_per_round() {
     shares_per_round = 0;
 }
@@ -69,7 +143,16 @@ void MinerRecord::inc_shares_count() {
     shares_count++;
 }
 
-QBRecord::QBRecord(std::string miner_address) : MinerRecord(miner_address) {}
+void MinerRecord::inc_shares_count(uint64_t count) {
+    shares_count += count;
+}
+
+QBRecord::QBRecord(uint32_t miner_id, std::string miner_address)
+    : MinerRecord(miner_id, miner_address) {}
+
+QBRecord::QBRecord(const RecordStore& store, uint32_t slot, std::string miner_address)
+    : MinerRecord(store, slot, miner_address), credits(store.credits[slot]),
+      avg_credits_per_block(store.avg_credits_per_block[slot]) {}
 
 void QBRecord::set_credits(uint64_t balance) {
     credits = balance;
@@ -99,4 +182,27 @@ void to_json(nlohmann::json& j, const MinerRecord& data) {
     };
 }
 
+void write(JsonWriter& writer, const MinerRecord& data, const Selection& fields) {
+    writer.begin_object();
+    if (fields.has("blocks_mined")) {
+        writer.field("blocks_mined", data.get_blocks_mined());
+    }
+    if (fields.has("blocks_received")) {
+        writer.field("blocks_received", data.get_blocks_received());
+    }
+    if (fields.has("miner_address")) {
+        writer.field("miner_address", data.get_miner_address());
+    }
+    if (fields.has("share_count")) {
+        writer.field("share_count", data.get_shares_count());
+    }
+    if (fields.has("uncles_mined")) {
+        writer.field("uncles_mined", data.get_uncles_mined());
+    }
+    if (fields.has("uncles_received")) {
+        writer.field("uncles_received", data.get_uncles_received());
+    }
+    writer.end_object();
+}
+
 }
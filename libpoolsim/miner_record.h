@@ -3,13 +3,81 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <vector>
 #include <nlohmann/json.hpp>
 
+#include "checkpoint.h"
+#include "json_writer.h"
+
 namespace poolsim {
 
+// Balances of the records of a reward scheme, stored by column so that payouts
+// go through contiguous arrays rather than through a heap allocation per record
+// Each record is a slot of the columns, in the order the records were added
+struct RecordStore {
+    std::vector<uint32_t> miner_ids;
+    std::vector<uint64_t> blocks_mined, uncles_mined, shares_count, shares_per_round;
+    std::vector<double> blocks_received, uncles_received;
+    // only used by QB
+    std::vector<uint64_t> credits, avg_credits_per_block;
+
+    // adds an empty record for the miner and returns its slot
+    uint32_t add(uint32_t miner_id);
+
+    uint32_t size() const;
+
+    void clear();
+
+    void save(CheckpointWriter& writer) const;
+    void load(CheckpointReader& reader);
+};
+
+// Record in a slot of a RecordStore, with the accessors of MinerRecord and QBRecord
+// It stays valid as records are added to the store
+class RecordView {
+public:
+    RecordView(RecordStore& _store, uint32_t _slot) : store(&_store), slot(_slot) {}
+
+    uint32_t get_slot() const { return slot; }
+    uint32_t get_miner_id() const { return store->miner_ids[slot]; }
+
+    void inc_blocks_mined() { store->blocks_mined[slot]++; }
+    void inc_blocks_received() { store->blocks_received[slot]++; }
+    void inc_blocks_received(double _block) { store->blocks_received[slot] += _block; }
+    void inc_uncles_mined() { store->uncles_mined[slot]++; }
+    void inc_uncles_received() { store->uncles_received[slot]++; }
+    void inc_uncles_received(double _uncles) { store->uncles_received[slot] += _uncles; }
+    void inc_shares_per_round() { store->shares_per_round[slot]++; }
+    void inc_shares_per_round(uint64_t count) { store->shares_per_round[slot] += count; }
+    void reset_shares_per_round() { store->shares_per_round[slot] = 0; }
+    void inc_shares_count() { store->shares_count[slot]++; }
+    void inc_shares_count(uint64_t count) { store->shares_count[slot] += count; }
+
+    uint64_t get_shares_count() const { return store->shares_count[slot]; }
+    uint64_t get_uncles_mined() const { return store->uncles_mined[slot]; }
+    double get_uncles_received() const { return store->uncles_received[slot]; }
+    uint64_t get_blocks_mined() const { return store->blocks_mined[slot]; }
+    double get_blocks_received() const { return store->blocks_received[slot]; }
+    uint64_t get_shares_per_round() const { return store->shares_per_round[slot]; }
+
+    void inc_credits(uint64_t _credits) { store->credits[slot] += _credits; }
+    void set_credits(uint64_t balance) { store->credits[slot] = balance; }
+    uint64_t get_credits() const { return store->credits[slot]; }
+    // updates the average credits the miner had when it was rewarded a block
+    void update_avg_credits_per_block();
+
+private:
+    RecordStore* store;
+    uint32_t slot;
+};
+
+// Copy of the balances of a miner, e.g. to export them
 class MinerRecord {
 public:
-    MinerRecord(std::string _address);
+    MinerRecord(uint32_t _miner_id, std::string _address);
+    // copies the record in the slot of the store
+    MinerRecord(const RecordStore& store, uint32_t slot, std::string _address);
+    virtual ~MinerRecord() {}
 
     // increments balance of blocks mined by miner
     void inc_blocks_mined();
@@ -25,10 +93,14 @@ public:
     void inc_uncles_received(double _uncles);
     // increments the number of shares submitted by miner during the current round
     void inc_shares_per_round();
+    // increments the number of shares submitted during the current round by specified amount
+    void inc_shares_per_round(uint64_t count);
     // resets the number of shares submitted per round by miner to zero
     void reset_shares_per_round();
     // returns address of miner to which record belongs
     std::string get_miner_address() const;
+    // returns id of miner to which record belongs
+    uint32_t get_miner_id() const;
     // returns the number of shares submitted
     uint64_t get_shares_count() const;
     // returns the number of uncle blocks mined by the miner
@@ -43,17 +115,22 @@ public:
     uint64_t get_shares_per_round() const;
     // increment the total shares count
     void inc_shares_count();
+    // increments the total shares count by specified amount
+    void inc_shares_count(uint64_t count);
 protected:
     uint64_t blocks_mined = 0, uncles_mined = 0, shares_count = 0, shares_per_round = 0; 
     
     double blocks_received = 0, uncles_received = 0;
 
+    uint32_t miner_id;
+
     std::string address;
 };
 
 class QBRecord : public MinerRecord {
 public:
-    QBRecord(std::string miner_address);
+    QBRecord(uint32_t miner_id, std::string miner_address);
+    QBRecord(const RecordStore& store, uint32_t slot, std::string miner_address);
     // increments credits by amount '_credits'
     void inc_credits(uint64_t _credits);
     // sets credits of a miner to function argument 'balance'
@@ -78,4 +155,7 @@ public:
 
 void to_json(nlohmann::json& j, const MinerRecord& data);
 
+// writes the same json as to_json, with only the selected fields
+void write(JsonWriter& writer, const MinerRecord& data, const Selection& fields = Selection());
+
 }
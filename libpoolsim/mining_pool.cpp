@@ -4,16 +4,6 @@
 
 namespace poolsim {
 
-std::shared_ptr<MiningPool> MiningPool::create(
-    const std::string& name,
-    uint64_t difficulty,
-    double uncle_prob,
-    std::unique_ptr<RewardScheme> reward_scheme,
-    std::shared_ptr<Network> network
-) {
-    return create(name, difficulty, uncle_prob, std::move(reward_scheme), network, SystemRandom::get_instance());
-}
-
 std::shared_ptr<MiningPool> MiningPool::create(const std::string& name,
                                                uint64_t difficulty, double uncle_prob,
                                                std::unique_ptr<RewardScheme> reward_scheme,
@@ -44,17 +34,17 @@ std::string MiningPool::get_scheme_name() const {
     return reward_scheme->get_scheme_name();
 }
 
-void MiningPool::join(const std::string& miner_address) {
-  miners.insert(miner_address);
+void MiningPool::join(uint32_t miner_id) {
+  miners.insert(miner_id);
 }
 
-void MiningPool::leave(const std::string& miner_address) {
+void MiningPool::leave(uint32_t miner_id) {
     // NOTE: we still want to serialize the records later on
     // so we simply keep all the miners who have ever joined
     // the pool as part of it
 }
 
-std::set<std::string> MiningPool::get_miners() {
+const std::set<uint32_t>& MiningPool::get_miners() const {
   return miners;
 }
 
@@ -62,6 +52,10 @@ std::shared_ptr<Network> MiningPool::get_network() const {
     return network.lock();
 }
 
+std::shared_ptr<Random> MiningPool::get_random() const {
+    return random;
+}
+
 uint64_t MiningPool::get_difficulty() const {
   return difficulty;
 }
@@ -78,47 +72,142 @@ std::string MiningPool::get_name() const {
   return pool_name;
 }
 
+uint32_t MiningPool::get_id() const {
+  return pool_id;
+}
+
+void MiningPool::set_id(uint32_t id) {
+  pool_id = id;
+}
+
 uint64_t MiningPool::get_blocks_mined() const {
   return blocks_mined;
 }
 
-nlohmann::json MiningPool::get_miners_metadata() const {
+uint64_t MiningPool::get_shares_count() const {
+  return shares_count;
+}
+
+const LuckDistribution& MiningPool::get_luck_distribution() const {
+  return luck_distribution;
+}
+
+nlohmann::json MiningPool::get_miners_metadata(const std::vector<uint32_t>& miner_ids) const {
     nlohmann::json result;
-    for (const std::string& address : miners) {
+    export_records(miner_ids, [&result](const MinerRecord& record) {
         nlohmann::json miner;
-        miner["address"] = address;
-        miner["metadata"] = reward_scheme->get_miner_metadata(address);
+        miner["address"] = record.get_miner_address();
+        to_json(miner["metadata"], record);
         result.push_back(miner);
-    }
+    });
     return result;
 }
 
-void MiningPool::submit_share(const std::string& miner_address, const Share& submitted_share) {
+void MiningPool::export_records(const std::vector<uint32_t>& miner_ids, const RecordCallback& callback) const {
+    std::vector<uint32_t> pool_miner_ids;
+    for (uint32_t miner_id : miner_ids) {
+        if (miners.count(miner_id) > 0) {
+            pool_miner_ids.push_back(miner_id);
+        }
+    }
+    reward_scheme->export_records(pool_miner_ids, callback);
+}
+
+void MiningPool::submit_share(uint32_t miner_id, const Share& submitted_share) {
+    shares_count++;
+    round_shares++;
     Share share = submitted_share;
     if (share.is_valid_block() && random->drand48() < uncle_prob) {
         share = Share(share.get_properties() | Share::Property::uncle);
     }
     if (share.is_network_share()) {
         blocks_mined++;
+        double expected_shares = (double) get_network()->get_difficulty() / difficulty;
+        luck_distribution.add(100.0 * expected_shares / round_shares);
+        round_shares = 0;
     }
-    reward_scheme->handle_share(miner_address, share);
-    if (share.is_valid_block()) {
-        BlockEvent block_event {
-            .time = 0,
-            .is_uncle = share.is_uncle(),
-            .pool_name = pool_name,
-            .miner_address = miner_address,
-            .reward_scheme_data = reward_scheme->get_json_metadata()
-        };
+    reward_scheme->handle_share(miner_id, share);
+    // the event and the metadata are only built if someone records the blocks
+    if (share.is_valid_block() && has_observers()) {
+        BlockEvent block_event;
+        block_event.is_uncle = share.is_uncle();
+        block_event.pool_id = pool_id;
+        block_event.miner_id = miner_id;
+        block_event.scheme_data = reward_scheme->get_block_data();
         notify(block_event);
     }
 }
 
+void MiningPool::submit_shares(uint32_t miner_id, uint64_t count) {
+    shares_count += count;
+    round_shares += count;
+    reward_scheme->handle_shares(miner_id, count);
+}
+
+bool MiningPool::needs_individual_shares() const {
+    return reward_scheme->needs_individual_shares();
+}
+
+void MiningPool::save(CheckpointWriter& writer) const {
+    writer.write(std::vector<uint32_t>(miners.begin(), miners.end()));
+    writer.write(blocks_mined);
+    writer.write(shares_count);
+    writer.write(round_shares);
+    luck_distribution.save(writer);
+    reward_scheme->save(writer);
+}
+
+void MiningPool::load(CheckpointReader& reader) {
+    std::vector<uint32_t> miner_ids;
+    reader.read(miner_ids);
+    miners = std::set<uint32_t>(miner_ids.begin(), miner_ids.end());
+    reader.read(blocks_mined);
+    reader.read(shares_count);
+    reader.read(round_shares);
+    luck_distribution.load(reader);
+    reward_scheme->load(reader);
+}
+
 void to_json(nlohmann::json& j, const MiningPool& pool) {
     j["name"] = pool.get_name();
     j["difficulty"] = pool.get_difficulty();
     j["reward_scheme"] = pool.get_scheme_name();
-    j["miners"] = pool.get_miners_metadata();
+}
+
+void write(JsonWriter& writer, const MiningPool& pool, const std::vector<uint32_t>& miner_ids,
+           const Selection& fields, const Selection& record_fields, const Selection& addresses,
+           const RecordEntryCallback& on_record) {
+    // keys in alphabetical order, as in to_json
+    writer.begin_object();
+    if (fields.has("difficulty")) {
+        writer.field("difficulty", pool.get_difficulty());
+    }
+    if (fields.has("miners")) {
+        writer.key("miners");
+        writer.begin_array();
+        pool.export_records(miner_ids, [&](const MinerRecord& record) {
+            if (!addresses.has(record.get_miner_address())) {
+                return;
+            }
+            uint64_t offset = on_record ? writer.begin_entry() : 0;
+            writer.begin_object();
+            writer.field("address", record.get_miner_address());
+            writer.key("metadata");
+            write(writer, record, record_fields);
+            writer.end_object();
+            if (on_record) {
+                on_record(record, offset, writer.get_position() - offset);
+            }
+        });
+        writer.end_array();
+    }
+    if (fields.has("name")) {
+        writer.field("name", pool.get_name());
+    }
+    if (fields.has("reward_scheme")) {
+        writer.field("reward_scheme", pool.get_scheme_name());
+    }
+    writer.end_object();
 }
 
 }
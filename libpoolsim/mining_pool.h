@@ -11,6 +11,8 @@
 #include "random.h"
 #include "observer.h"
 #include "block_event.h"
+#include "json_writer.h"
+#include "summary.h"
 
 
 namespace poolsim {
@@ -18,13 +20,6 @@ namespace poolsim {
 class MiningPool : public std::enable_shared_from_this<MiningPool>,
                    public Observable<BlockEvent> {
 public:
-    static std::shared_ptr<MiningPool> create(
-        const std::string& name,
-        uint64_t difficulty,
-        double uncle_prob,
-        std::unique_ptr<RewardScheme> reward_scheme,
-        std::shared_ptr<Network> network);
-
     static std::shared_ptr<MiningPool> create(
         const std::string& name,
         uint64_t difficulty,
@@ -33,8 +28,8 @@ public:
         std::shared_ptr<Network> network,
         std::shared_ptr<Random> random);
 
-    // Returns all the miners currently in the pool
-    std::set<std::string> get_miners();
+    // Returns the ids of all the miners currently in the pool
+    const std::set<uint32_t>& get_miners() const;
 
     // Returns the name of the reward scheme used by the pool
     std::string get_scheme_name() const;
@@ -48,43 +43,79 @@ public:
     // Returns the name of the pool
     std::string get_name() const;
 
+    // Returns the id of the pool in the network
+    uint32_t get_id() const;
+
+    // Sets the id of the pool, done by the network when the pool is registered
+    void set_id(uint32_t id);
+
     // Returns luck of the pool based on the shares submitted in the current round
     double get_luck() const;
 
     // Returns the network instance
     std::shared_ptr<Network> get_network() const;
 
-    // Returns the current reward scheme
+    // Returns the random instance used by the pool and its reward scheme
+    std::shared_ptr<Random> get_random() const;
+
+    // Returns the records of the reward scheme, which must be of the given class, without copying them
     template <typename RewardSchemeClass>
-    std::vector<std::shared_ptr<typename RewardSchemeClass::record_class>> get_records();
+    const RecordStore& get_record_store() const;
 
     // Returns the reward scheme block metadata
     template <typename RewardSchemeClass>
     typename RewardSchemeClass::block_metadata_class get_block_metadata();
 
+    // Returns the reward scheme, which must be of the given class
+    template <typename RewardSchemeClass>
+    const RewardSchemeClass* get_reward_scheme() const;
+
     // Submit a share to the pool
     // The share can be either a network share or a pool share
     // TODO: when the share is a network share this should probably return
     // if it became an uncle block or not
-    void submit_share(const std::string& miner_address, const Share& share);
+    void submit_share(uint32_t miner_id, const Share& share);
+
+    // Submits `count` shares of the miner which are not valid blocks
+    void submit_shares(uint32_t miner_id, uint64_t count);
+
+    // Returns whether the reward scheme needs to see each share
+    // rather than only the number of shares per miner and round
+    bool needs_individual_shares() const;
 
     // Joins this mining pool
     // This method does not update the miner state
-    void join(const std::string& miner);
+    void join(uint32_t miner_id);
 
     // Leaves this mining pool
     // This method does not update the miner state
-    void leave(const std::string& miner_address);
+    void leave(uint32_t miner_id);
 
     // Set the reward scheme for this mining pool
     void set_reward_scheme(std::unique_ptr<RewardScheme> _reward_scheme);
 
-    // Returns the metadata of all miners in the poool
-    nlohmann::json get_miners_metadata() const;
+    // Returns the metadata of all miners in the poool, in the order of `miner_ids`
+    nlohmann::json get_miners_metadata(const std::vector<uint32_t>& miner_ids) const;
+
+    // Calls `callback` with the record of each miner in the pool, in the order of `miner_ids`
+    // which may list miners of other pools, e.g. all the miners sorted by address
+    void export_records(const std::vector<uint32_t>& miner_ids, const RecordCallback& callback) const;
 
     // Returns the total number of blocks mined
     uint64_t get_blocks_mined() const;
 
+    // Returns the total number of shares submitted, including valid blocks
+    uint64_t get_shares_count() const;
+
+    // Returns the distribution of the luck of the rounds completed by the pool
+    const LuckDistribution& get_luck_distribution() const;
+
+    // Writes the miners, counters and reward scheme state to a checkpoint
+    void save(CheckpointWriter& writer) const;
+
+    // Restores the state written by save()
+    void load(CheckpointReader& reader);
+
 protected:
     MiningPool(const std::string& name, uint64_t difficulty,
                double uncle_prob,
@@ -94,8 +125,10 @@ protected:
 private:
     // name of pool
     std::string pool_name;
-    // list of miners in pool
-    std::set<std::string> miners;
+    // index of the pool in the network
+    uint32_t pool_id = 0;
+    // ids of the miners in pool
+    std::set<uint32_t> miners;
     // share and network difficulty; total hashrate of pool
     uint64_t difficulty;
     // probability that a block is an uncle
@@ -104,20 +137,32 @@ private:
     std::unique_ptr<RewardScheme> reward_scheme;
     // total blocks mined by miners in pool
     uint64_t blocks_mined = 0;
+    // total shares submitted by miners in pool
+    uint64_t shares_count = 0;
+    // shares submitted since the last block, uncles included as they do not end the round
+    uint64_t round_shares = 0;
+    // luck of the completed rounds
+    LuckDistribution luck_distribution;
     // Information about network
     std::weak_ptr<Network> network;
     // Random instance
     std::shared_ptr<Random> random;
 };
 
+// writes the pool without its miners, whose order is given by the simulator
 void to_json(nlohmann::json& j, const MiningPool& data);
 
-template <typename RewardSchemeClass>
-std::vector<std::shared_ptr<typename RewardSchemeClass::record_class>> MiningPool::get_records() {
-    auto reward_scheme_ptr = reward_scheme.get();
-    auto downcasted_reward_scheme = static_cast<RewardSchemeClass*>(reward_scheme_ptr);
-    return downcasted_reward_scheme->get_records();
-}
+// Called with each record written and the position of its entry in the output
+using RecordEntryCallback = std::function<void(const MinerRecord& record, uint64_t offset, uint64_t length)>;
+
+// writes the same json as to_json with the records of the miners in the order
+// of `miner_ids`, with only the selected fields of the pool and of the records,
+// and only the records of the selected addresses
+void write(JsonWriter& writer, const MiningPool& pool, const std::vector<uint32_t>& miner_ids,
+           const Selection& fields = Selection(),
+           const Selection& record_fields = Selection(), const Selection& addresses = Selection(),
+           const RecordEntryCallback& on_record = nullptr);
+
 
 template <typename RewardSchemeClass>
 typename RewardSchemeClass::block_metadata_class MiningPool::get_block_metadata() {
@@ -126,4 +171,14 @@ typename RewardSchemeClass::block_metadata_class MiningPool::get_block_metadata(
     return downcasted_reward_scheme->get_block_metadata();
 }
 
+template <typename RewardSchemeClass>
+const RewardSchemeClass* MiningPool::get_reward_scheme() const {
+    return static_cast<const RewardSchemeClass*>(reward_scheme.get());
+}
+
+template <typename RewardSchemeClass>
+const RecordStore& MiningPool::get_record_store() const {
+    return get_reward_scheme<RewardSchemeClass>()->get_record_store();
+}
+
 }
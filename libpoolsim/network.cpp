@@ -1,3 +1,5 @@
+#include <stdexcept>
+
 #include "network.h"
 
 #include "mining_pool.h"
@@ -7,10 +9,15 @@ namespace poolsim {
 Network::Network(uint64_t _difficulty) : difficulty(_difficulty) {}
 
 void Network::register_pool(std::shared_ptr<MiningPool> pool) {
+    pool->set_id(pools.size());
     pools.push_back(pool);
 }
 
-std::vector<std::shared_ptr<MiningPool>> Network::get_pools() {
+std::string Network::get_pool_name(uint32_t pool_id) const {
+    return pools.at(pool_id)->get_name();
+}
+
+const std::vector<std::shared_ptr<MiningPool>>& Network::get_pools() const {
     return pools;
 }
 
@@ -18,10 +25,52 @@ uint64_t Network::get_difficulty() const { return difficulty; }
 
 void Network::set_difficulty(uint64_t _difficulty) { difficulty = _difficulty; }
 
-uint64_t Network::get_current_time() const { return current_time; }
-void Network::set_current_time(uint64_t _current_time) { current_time = _current_time; }
+double Network::get_current_time() const { return current_time; }
+void Network::set_current_time(double _current_time) { current_time = _current_time; }
 
 uint64_t Network::get_current_block() const { return current_block; }
 void Network::inc_current_block() { current_block++; }
 
+uint32_t Network::get_miner_id(const std::string& address) {
+    auto it = miner_ids.find(address);
+    if (it != miner_ids.end()) {
+        return it->second;
+    }
+    std::lock_guard<std::mutex> lock(miner_addresses_mutex);
+    uint32_t miner_id = miner_addresses.size();
+    miner_ids[address] = miner_id;
+    miner_addresses.push_back(address);
+    return miner_id;
+}
+
+std::string Network::get_miner_address(uint32_t miner_id) const {
+    std::lock_guard<std::mutex> lock(miner_addresses_mutex);
+    return miner_addresses.at(miner_id);
+}
+
+size_t Network::get_miner_ids_count() const {
+    std::lock_guard<std::mutex> lock(miner_addresses_mutex);
+    return miner_addresses.size();
+}
+
+void Network::save(CheckpointWriter& writer) const {
+    writer.write(current_time);
+    writer.write(current_block);
+    std::lock_guard<std::mutex> lock(miner_addresses_mutex);
+    writer.write(miner_addresses);
+}
+
+void Network::load(CheckpointReader& reader) {
+    reader.read(current_time);
+    reader.read(current_block);
+    std::vector<std::string> addresses;
+    reader.read(addresses);
+    for (size_t i = 0; i < addresses.size(); i++) {
+        // ids assigned during the simulation, e.g. to other addresses of a miner
+        if (get_miner_id(addresses[i]) != i) {
+            throw std::invalid_argument("checkpoint miners do not match the simulation");
+        }
+    }
+}
+
 }
@@ -2,33 +2,70 @@
 
 #include <memory>
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include <cstdint>
+#include <limits>
+#include <mutex>
 
+#include "checkpoint.h"
 
 namespace poolsim {
 
 class MiningPool;
 class Simulator;
 
+// Id used when no miner matches
+const uint32_t invalid_miner_id = std::numeric_limits<uint32_t>::max();
+
 class Network {
 friend class Simulator;
 
 public:
     explicit Network(uint64_t difficulty);
+    // Registers the pool, whose id is its index in the pools of the network
     void register_pool(std::shared_ptr<MiningPool> pool);
-    std::vector<std::shared_ptr<MiningPool>> get_pools();
+    const std::vector<std::shared_ptr<MiningPool>>& get_pools() const;
+
+    // Returns the name of the pool with the given id
+    std::string get_pool_name(uint32_t pool_id) const;
     uint64_t get_difficulty() const;
-    uint64_t get_current_time() const;
+    double get_current_time() const;
     uint64_t get_current_block() const;
+
+    // Returns the dense id of the miner address
+    // a new id is assigned the first time an address is seen
+    uint32_t get_miner_id(const std::string& address);
+
+    // Returns the address of the miner with the given id
+    // Can be called from another thread while the simulation runs
+    std::string get_miner_address(uint32_t miner_id) const;
+
+    // Returns the number of miner ids assigned so far
+    size_t get_miner_ids_count() const;
+
+    // Writes the time, block and miner ids to a checkpoint
+    void save(CheckpointWriter& writer) const;
+
+    // Restores the state written by save()
+    // The ids assigned so far must be the first ones of the checkpoint
+    void load(CheckpointReader& reader);
 private:
     uint64_t difficulty;
-    uint64_t current_time = 0;
+    double current_time = 0;
     uint64_t current_block = 0;
     void inc_current_block();
     void set_difficulty(uint64_t difficulty);
     std::vector<std::shared_ptr<MiningPool>> pools;
-    void set_current_time(uint64_t time);
+    void set_current_time(double time);
 
+    // address -> id lookup, only used when entering or leaving the id space
+    std::unordered_map<std::string, uint32_t> miner_ids;
+    // id -> address, used at serialization time
+    std::vector<std::string> miner_addresses;
+    // guards the growth of miner_addresses, as the blocks may be
+    // serialized from another thread, see BlockEventWriter
+    mutable std::mutex miner_addresses_mutex;
 };
 
 }
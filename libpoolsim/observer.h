@@ -16,6 +16,8 @@ class Observable {
 public:
     void add_observer(std::shared_ptr<Observer<T>> observer);
     void notify(const T& value);
+    // Returns whether any observer was added
+    bool has_observers() const;
 private:
     std::vector<std::shared_ptr<Observer<T>>> observers;
 };
@@ -25,6 +27,11 @@ void Observable<T>::add_observer(std::shared_ptr<Observer<T>> observer) {
     observers.push_back(observer);
 }
 
+template <typename T>
+bool Observable<T>::has_observers() const {
+    return !observers.empty();
+}
+
 template <typename T>
 void Observable<T>::notify(const T& value) {
     for (auto observer : observers) {
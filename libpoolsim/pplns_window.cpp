@@ -0,0 +1,143 @@
+#include <cassert>
+#include <stdexcept>
+
+#include "pplns_window.h"
+
+namespace poolsim {
+
+PPLNSWindow::PPLNSWindow(uint64_t _n, bool _run_length_encoded)
+  : n(_n), run_length_encoded(_run_length_encoded) {
+  assert(n > 0);
+}
+
+void PPLNSWindow::push(uint32_t miner_id) {
+  add_share(miner_id);
+  if (run_length_encoded) {
+    if (!runs.empty() && runs.back().first == miner_id) {
+      runs.back().second++;
+    } else {
+      runs.emplace_back(miner_id, 1);
+    }
+    runs_shares++;
+    if (runs_shares > n) {
+      remove_share(runs.front().first);
+      if (--runs.front().second == 0) {
+        runs.pop_front();
+      }
+      runs_shares--;
+    }
+    return;
+  }
+
+  // the ring grows up to n ids, then the oldest id is overwritten
+  if (ring.size() < n) {
+    ring.push_back(miner_id);
+    return;
+  }
+  remove_share(ring[start]);
+  ring[start] = miner_id;
+  start = (start + 1) % n;
+}
+
+uint64_t PPLNSWindow::size() const {
+  return run_length_encoded ? runs_shares : ring.size();
+}
+
+uint64_t PPLNSWindow::get_n() const {
+  return n;
+}
+
+bool PPLNSWindow::is_run_length_encoded() const {
+  return run_length_encoded;
+}
+
+const std::vector<WindowMiner>& PPLNSWindow::get_miners() const {
+  return miners;
+}
+
+std::vector<uint32_t> PPLNSWindow::get_miner_ids() const {
+  std::vector<uint32_t> miner_ids;
+  miner_ids.reserve(size());
+  for_each_run([&miner_ids](uint32_t miner_id, uint64_t shares) {
+    miner_ids.insert(miner_ids.end(), shares, miner_id);
+  });
+  return miner_ids;
+}
+
+uint64_t PPLNSWindow::get_runs_count() const {
+  uint64_t count = 0;
+  for_each_run([&count](uint32_t miner_id, uint64_t shares) {
+    count++;
+  });
+  return count;
+}
+
+void PPLNSWindow::for_each_run(const std::function<void(uint32_t miner_id, uint64_t shares)>& callback) const {
+  if (run_length_encoded) {
+    for (auto& run : runs) {
+      callback(run.first, run.second);
+    }
+    return;
+  }
+  uint64_t i = 0;
+  while (i < ring.size()) {
+    uint32_t miner_id = ring[(start + i) % ring.size()];
+    uint64_t shares = 0;
+    for (; i < ring.size() && ring[(start + i) % ring.size()] == miner_id; i++) {
+      shares++;
+    }
+    callback(miner_id, shares);
+  }
+}
+
+void PPLNSWindow::save(CheckpointWriter& writer) const {
+  std::vector<uint32_t> miner_ids;
+  std::vector<uint64_t> shares;
+  for_each_run([&miner_ids, &shares](uint32_t miner_id, uint64_t run_shares) {
+    miner_ids.push_back(miner_id);
+    shares.push_back(run_shares);
+  });
+  writer.write(miner_ids);
+  writer.write(shares);
+}
+
+void PPLNSWindow::load(CheckpointReader& reader) {
+  std::vector<uint32_t> miner_ids;
+  std::vector<uint64_t> shares;
+  reader.read(miner_ids);
+  reader.read(shares);
+  if (miner_ids.size() != shares.size()) {
+    throw std::invalid_argument("invalid PPLNS window in checkpoint");
+  }
+  *this = PPLNSWindow(n, run_length_encoded);
+  for (size_t i = 0; i < miner_ids.size(); i++) {
+    for (uint64_t j = 0; j < shares[i]; j++) {
+      push(miner_ids[i]);
+    }
+  }
+}
+
+void PPLNSWindow::add_share(uint32_t miner_id) {
+  if (miner_id >= positions.size()) {
+    positions.resize(miner_id + 1, 0);
+  }
+  if (positions[miner_id] == 0) {
+    miners.push_back(WindowMiner{miner_id, 0});
+    positions[miner_id] = miners.size();
+  }
+  miners[positions[miner_id] - 1].shares++;
+}
+
+void PPLNSWindow::remove_share(uint32_t miner_id) {
+  uint32_t position = positions[miner_id];
+  if (--miners[position - 1].shares > 0) {
+    return;
+  }
+  // the last miner takes the place of the removed one
+  miners[position - 1] = miners.back();
+  positions[miners.back().miner_id] = position;
+  miners.pop_back();
+  positions[miner_id] = 0;
+}
+
+}
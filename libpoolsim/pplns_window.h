@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "checkpoint.h"
+
+namespace poolsim {
+
+// Number of shares of a miner in a PPLNS window
+struct WindowMiner {
+  uint32_t miner_id;
+  uint64_t shares;
+};
+
+// Miner ids of the last n shares submitted to a PPLNS pool, with the number of
+// shares of each miner in the window, so that a payout only goes through the
+// distinct miners of the window rather than through every share
+// The ids are kept in a ring buffer of up to n ids or, when run length encoded,
+// as runs of consecutive shares of the same miner, whose memory only grows
+// with the number of runs rather than with n
+class PPLNSWindow {
+public:
+  explicit PPLNSWindow(uint64_t n = 1, bool run_length_encoded = false);
+
+  // Adds a share of the miner, removing the oldest one once the window holds n shares
+  void push(uint32_t miner_id);
+
+  // Returns the number of shares in the window, at most n
+  uint64_t size() const;
+
+  uint64_t get_n() const;
+  bool is_run_length_encoded() const;
+
+  // Returns the miners with shares in the window, in no particular order
+  const std::vector<WindowMiner>& get_miners() const;
+
+  // Returns the miner ids of the shares, from the oldest to the newest
+  std::vector<uint32_t> get_miner_ids() const;
+
+  // Returns the number of runs of consecutive shares of the same miner
+  uint64_t get_runs_count() const;
+
+  // Writes the shares as runs of the same miner, whichever the encoding
+  void save(CheckpointWriter& writer) const;
+  void load(CheckpointReader& reader);
+
+private:
+  uint64_t n;
+  bool run_length_encoded;
+
+  // ids of the shares, the oldest at `start` once the ring is full
+  std::vector<uint32_t> ring;
+  uint64_t start = 0;
+
+  // runs of shares of the same miner, from the oldest, with their total
+  std::deque<std::pair<uint32_t, uint64_t>> runs;
+  uint64_t runs_shares = 0;
+
+  std::vector<WindowMiner> miners;
+  // position of each miner id in `miners` plus one, 0 when not in the window
+  std::vector<uint32_t> positions;
+
+  // Calls `callback` with each run of shares, from the oldest
+  void for_each_run(const std::function<void(uint32_t miner_id, uint64_t shares)>& callback) const;
+
+  void add_share(uint32_t miner_id);
+  void remove_share(uint32_t miner_id);
+};
+
+}
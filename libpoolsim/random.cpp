@@ -1,23 +1,79 @@
 #include "random.h"
+#include "fast_math.h"
 
+#include <cmath>
 #include <sstream>
+#include <stdexcept>
 
 namespace poolsim {
 
 using nlohmann::json;
 
 
-const char* RandomInitException::what() const throw() {
-  return message;
+void Random::fill_uniform(double* values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    values[i] = drand48();
+  }
+}
+
+size_t Random::get_batch_size() const {
+  return 1;
+}
+
+bool Random::has_streams() const {
+  return false;
+}
+
+std::shared_ptr<Random> Random::get_stream(uint32_t pool, uint32_t miner) {
+  throw std::logic_error("random generator does not support streams");
 }
 
-RandomInitException::RandomInitException(const char* _message): message(_message) {}
+void Random::save(CheckpointWriter& writer) const {
+  throw std::logic_error("random generator does not support checkpoints");
+}
+
+void Random::load(CheckpointReader& reader) {
+  throw std::logic_error("random generator does not support checkpoints");
+}
+
+// standard engines only expose their state through streams
+static void save_engine(CheckpointWriter& writer, const std::default_random_engine& engine) {
+  std::stringstream state;
+  state << engine;
+  writer.write(state.str());
+}
+
+static void load_engine(CheckpointReader& reader, std::default_random_engine& engine) {
+  std::stringstream state(reader.read<std::string>());
+  state >> engine;
+}
 
-SystemRandom::SystemRandom() :
-  random_engine(std::make_shared<std::default_random_engine>()) {}
+const uint32_t Random::pool_stream = 0xffffffff;
+const uint32_t Random::population_stream = 0xfffffffe;
+
+SystemRandom::SystemRandom(long _seed) :
+  random_engine(std::make_shared<std::default_random_engine>()) {
+  seed(_seed);
+}
+
+void SystemRandom::seed(long seed) {
+  // same initial state as srand48(seed)
+  xsubi[0] = 0x330e;
+  xsubi[1] = seed & 0xffff;
+  xsubi[2] = (seed >> 16) & 0xffff;
+  random_engine->seed(seed);
+}
+
+uint64_t SystemRandom::derive_seed(uint64_t seed, uint64_t stream) {
+  // splitmix64 finalizer over the seed and the stream index
+  uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return (z ^ (z >> 31)) & 0x7fffffffffffffffULL;
+}
 
 double SystemRandom::drand48() {
-  return ::drand48();
+  return ::erand48(xsubi);
 }
 
 int SystemRandom::random_int(int min, int max) {
@@ -39,46 +95,246 @@ std::shared_ptr<std::default_random_engine> SystemRandom::get_random_engine() {
   return random_engine;
 }
 
-std::shared_ptr<SystemRandom> SystemRandom::get_instance() {
-  if (!initialized) {
-    throw RandomInitException("random not initialized");
+void SystemRandom::save(CheckpointWriter& writer) const {
+  for (unsigned short value : xsubi) {
+    writer.write(value);
+  }
+  save_engine(writer, *random_engine);
+}
+
+void SystemRandom::load(CheckpointReader& reader) {
+  for (unsigned short& value : xsubi) {
+    reader.read(value);
+  }
+  load_engine(reader, *random_engine);
+}
+
+
+REGISTER(Random, SystemRandom, "drand48")
+
+
+Xoshiro256Random::Xoshiro256Random(long _seed) :
+  random_engine(std::make_shared<std::default_random_engine>()) {
+  seed(_seed);
+}
+
+void Xoshiro256Random::seed(long seed) {
+  // the state must not be all zeros, which splitmix64 outputs never are
+  for (uint64_t i = 0; i < 4; i++) {
+    state[i] = SystemRandom::derive_seed(seed, i) | (i == 0);
   }
+  random_engine->seed(seed);
+}
 
-  static std::shared_ptr<SystemRandom> instance = std::shared_ptr<SystemRandom>(new SystemRandom);
-  return instance;
+double Xoshiro256Random::drand48() {
+  return to_uniform(next());
 }
 
-void SystemRandom::ensure_initialized(long seed) {
-  if (!initialized) {
-    initialize(seed);
+void Xoshiro256Random::fill_uniform(double* values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    values[i] = to_uniform(next());
   }
 }
 
-void SystemRandom::initialize(long seed) {
-  if (initialized) {
-    throw RandomInitException("random already initialized");
+size_t Xoshiro256Random::get_batch_size() const {
+  return 256;
+}
+
+int Xoshiro256Random::random_int(int min, int max) {
+  std::uniform_int_distribution<int> dist(min, max);
+  return dist(*random_engine);
+}
+
+std::string Xoshiro256Random::get_address() {
+  std::stringstream result;
+  std::uniform_int_distribution<int> dist(0, 15);
+  for (size_t i = 0; i < 40; i++) {
+    result << std::hex << dist(*random_engine);
   }
-  initialized = true;
-  srand(seed);
-  srand48(seed);
-  get_instance()->get_random_engine()->seed(seed);
+  return "0x" + result.str();
 }
 
-bool SystemRandom::initialized = false;
+std::shared_ptr<std::default_random_engine> Xoshiro256Random::get_random_engine() {
+  return random_engine;
+}
 
+void Xoshiro256Random::save(CheckpointWriter& writer) const {
+  for (uint64_t value : state) {
+    writer.write(value);
+  }
+  save_engine(writer, *random_engine);
+}
 
-Distribution::Distribution() : Distribution(SystemRandom::get_instance()) {}
-Distribution::Distribution(std::shared_ptr<Random> _random)
+void Xoshiro256Random::load(CheckpointReader& reader) {
+  for (uint64_t& value : state) {
+    reader.read(value);
+  }
+  load_engine(reader, *random_engine);
+}
+
+REGISTER(Random, Xoshiro256Random, "xoshiro256")
+
+
+PhiloxRandom::PhiloxRandom(long seed)
+  : PhiloxRandom(seed, pool_stream, pool_stream) {}
+
+PhiloxRandom::PhiloxRandom(uint64_t _key, uint32_t _pool, uint32_t _miner)
+  : key(_key), pool(_pool), miner(_miner) {}
+
+std::array<uint32_t, 4> PhiloxRandom::generate(const std::array<uint32_t, 4>& counter,
+                                               const std::array<uint32_t, 2>& key) {
+  std::array<uint32_t, 4> x = counter;
+  std::array<uint32_t, 2> k = key;
+  for (int round = 0; round < 10; round++) {
+    uint64_t product0 = (uint64_t) 0xD2511F53 * x[0];
+    uint64_t product1 = (uint64_t) 0xCD9E8D57 * x[2];
+    x = {{(uint32_t) (product1 >> 32) ^ x[1] ^ k[0], (uint32_t) product1,
+          (uint32_t) (product0 >> 32) ^ x[3] ^ k[1], (uint32_t) product0}};
+    k[0] += 0x9E3779B9;
+    k[1] += 0xBB67AE85;
+  }
+  return x;
+}
+
+inline double PhiloxRandom::next_uniform() {
+  if (has_next_value) {
+    has_next_value = false;
+    return next_value;
+  }
+  auto bits = generate({{(uint32_t) position, (uint32_t) (position >> 32), pool, miner}},
+                       {{(uint32_t) key, (uint32_t) (key >> 32)}});
+  position++;
+  // 53 bits per uniform, in the middle of their interval so that log() of it is finite
+  const double scale = 1.0 / 9007199254740992.0;
+  next_value = (((((uint64_t) bits[2] << 32) | bits[3]) >> 11) + 0.5) * scale;
+  has_next_value = true;
+  return (((((uint64_t) bits[0] << 32) | bits[1]) >> 11) + 0.5) * scale;
+}
+
+double PhiloxRandom::drand48() {
+  return next_uniform();
+}
+
+void PhiloxRandom::fill_uniform(double* values, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    values[i] = next_uniform();
+  }
+}
+
+size_t PhiloxRandom::get_batch_size() const {
+  return 256;
+}
+
+bool PhiloxRandom::has_streams() const {
+  return true;
+}
+
+std::shared_ptr<Random> PhiloxRandom::get_stream(uint32_t _pool, uint32_t _miner) {
+  return std::make_shared<PhiloxRandom>(key, _pool, _miner);
+}
+
+void PhiloxRandom::set_position(uint64_t _position) {
+  position = _position;
+  has_next_value = false;
+}
+
+uint64_t PhiloxRandom::get_position() const {
+  return position;
+}
+
+int PhiloxRandom::random_int(int min, int max) {
+  std::uniform_int_distribution<int> dist(min, max);
+  return dist(*get_random_engine());
+}
+
+std::string PhiloxRandom::get_address() {
+  std::stringstream result;
+  std::uniform_int_distribution<int> dist(0, 15);
+  for (size_t i = 0; i < 40; i++) {
+    result << std::hex << dist(*get_random_engine());
+  }
+  return "0x" + result.str();
+}
+
+std::shared_ptr<std::default_random_engine> PhiloxRandom::get_random_engine() {
+  // created lazily as most streams never need one
+  if (random_engine == nullptr) {
+    uint64_t stream = ((uint64_t) pool << 32) | miner;
+    random_engine = std::make_shared<std::default_random_engine>(
+      SystemRandom::derive_seed(key, stream));
+  }
+  return random_engine;
+}
+
+void PhiloxRandom::save(CheckpointWriter& writer) const {
+  // the key and the stream are given by the config, only the position moves
+  writer.write(position);
+  writer.write(has_next_value);
+  writer.write(next_value);
+  writer.write(random_engine != nullptr);
+  if (random_engine != nullptr) {
+    save_engine(writer, *random_engine);
+  }
+}
+
+void PhiloxRandom::load(CheckpointReader& reader) {
+  reader.read(position);
+  reader.read(has_next_value);
+  reader.read(next_value);
+  if (reader.read<bool>()) {
+    load_engine(reader, *get_random_engine());
+  }
+}
+
+REGISTER(Random, PhiloxRandom, "philox")
+
+
+RandomBuffer::RandomBuffer(std::shared_ptr<Random> _random)
   : random(_random) {}
 
-NormalDistribution::NormalDistribution(double mean, double stddev)
-  : Distribution(), dist(std::normal_distribution<double>(mean, stddev)) {}
+void RandomBuffer::refill() {
+  values.resize(random->get_batch_size());
+  random->fill_uniform(values.data(), values.size());
+  position = 0;
+}
+
+void RandomBuffer::refill_exponentials() {
+  exponentials.resize(random->get_batch_size());
+  random->fill_uniform(exponentials.data(), exponentials.size());
+  if (exponentials.size() == 1) {
+    exponentials[0] = -std::log(exponentials[0]);
+  } else {
+    log_batch(exponentials.data(), exponentials.data(), exponentials.size());
+    for (double& value : exponentials) {
+      value = -value;
+    }
+  }
+  exponential_position = 0;
+}
+
+void RandomBuffer::save(CheckpointWriter& writer) const {
+  writer.write(values);
+  writer.write((uint64_t) position);
+  writer.write(exponentials);
+  writer.write((uint64_t) exponential_position);
+}
+
+void RandomBuffer::load(CheckpointReader& reader) {
+  reader.read(values);
+  position = reader.read<uint64_t>();
+  reader.read(exponentials);
+  exponential_position = reader.read<uint64_t>();
+}
+
+
+Distribution::Distribution(std::shared_ptr<Random> _random)
+  : random(_random) {}
 
 NormalDistribution::NormalDistribution(double mean, double stddev, std::shared_ptr<Random> _random)
   : Distribution(_random), dist(std::normal_distribution<double>(mean, stddev)) {}
 
-NormalDistribution::NormalDistribution(const json& args)
-  : Distribution(), dist(std::normal_distribution<double>(args["mean"], args["stddev"])) {}
+NormalDistribution::NormalDistribution(const json& args, std::shared_ptr<Random> _random)
+  : Distribution(_random), dist(std::normal_distribution<double>(args["mean"], args["stddev"])) {}
 
 double NormalDistribution::get() {
   return dist(*random->get_random_engine());
@@ -86,14 +342,11 @@ double NormalDistribution::get() {
 
 REGISTER(Distribution, NormalDistribution, "normal")
 
-LogNormalDistribution::LogNormalDistribution(double mean, double stddev)
-  : Distribution(), dist(std::lognormal_distribution<double>(mean, stddev)) {}
-
 LogNormalDistribution::LogNormalDistribution(double mean, double stddev, std::shared_ptr<Random> _random)
   : Distribution(_random), dist(std::lognormal_distribution<double>(mean, stddev)) {}
 
-LogNormalDistribution::LogNormalDistribution(const json& args)
-  : Distribution(), dist(std::lognormal_distribution<double>(args["mean"], args["stddev"])) {}
+LogNormalDistribution::LogNormalDistribution(const json& args, std::shared_ptr<Random> _random)
+  : Distribution(_random), dist(std::lognormal_distribution<double>(args["mean"], args["stddev"])) {}
 
 double LogNormalDistribution::get() {
   return dist(*random->get_random_engine());
@@ -102,14 +355,11 @@ double LogNormalDistribution::get() {
 REGISTER(Distribution, LogNormalDistribution, "lognormal")
 
 
-UniformDistribution::UniformDistribution(double low, double high)
-  : Distribution(), dist(std::uniform_real_distribution<double>(low, high)) {}
-
 UniformDistribution::UniformDistribution(double low, double high, std::shared_ptr<Random> _random)
   : Distribution(_random), dist(std::uniform_real_distribution<double>(low, high)) {}
 
-UniformDistribution::UniformDistribution(const json& args)
-  : Distribution(), dist(std::uniform_real_distribution<double>(args["low"], args["high"])) {}
+UniformDistribution::UniformDistribution(const json& args, std::shared_ptr<Random> _random)
+  : Distribution(_random), dist(std::uniform_real_distribution<double>(args["low"], args["high"])) {}
 
 double UniformDistribution::get() {
   return dist(*random->get_random_engine());
@@ -3,24 +3,16 @@
 #include <random>
 #include <memory>
 #include <iterator>
+#include <vector>
+#include <array>
 
 #include "factory.h"
+#include "checkpoint.h"
 #include <nlohmann/json.hpp>
 
 namespace poolsim {
 
 
-// Exception thrown if the Random class
-// has not yet been initialized exactly once
-class RandomInitException : public std::exception {
-public:
-  explicit RandomInitException(const char* _message);
-  const char* what() const throw();
-private:
-  const char* message;
-};
-
-
 // Interface used for mocking
 class Random {
 public:
@@ -28,6 +20,30 @@ public:
     // Returns a random double between 0 and 1
     virtual double drand48() = 0;
 
+    // Fills `values` with `count` random doubles between 0 and 1
+    // Same values as `count` successive calls to drand48()
+    virtual void fill_uniform(double* values, size_t count);
+
+    // Returns how many values consumers may draw ahead of their use
+    // Drawing ahead changes the order in which the values are handed out
+    // when the instance is shared, so this is 1 unless the implementation
+    // is fast enough for batches to matter
+    virtual size_t get_batch_size() const;
+
+    // Returns whether independent streams can be derived with get_stream()
+    virtual bool has_streams() const;
+
+    // Returns the independent stream of the given miner of a pool
+    // `miner` can also be one of the reserved streams below
+    // The stream does not depend on the draws made from this instance,
+    // so components can draw from their own stream in any order
+    virtual std::shared_ptr<Random> get_stream(uint32_t pool, uint32_t miner);
+
+    // Stream of the pool itself, e.g. uncle blocks and reward scheme draws
+    static const uint32_t pool_stream;
+    // Stream used to create the miners of the pool
+    static const uint32_t population_stream;
+
     // Returns a random address (0x prefix + 40 hex chars)
     virtual std::string get_address() = 0;
 
@@ -39,6 +55,13 @@ public:
     typename std::iterator_traits<It>::reference random_element(It begin, It end);
 
     virtual std::shared_ptr<std::default_random_engine> get_random_engine() = 0;
+
+    // Writes the state of the generator to a checkpoint
+    // Throws std::logic_error unless the implementation supports checkpoints
+    virtual void save(CheckpointWriter& writer) const;
+
+    // Restores the state written by save()
+    virtual void load(CheckpointReader& reader);
 };
 
 template<typename It>
@@ -53,50 +76,212 @@ typename std::iterator_traits<It>::reference Random::random_element(It begin, It
 }
 
 
-// Singleton which delegates to
-// standard library
-class SystemRandom : public Random {
+// Delegates to the standard library
+// Each instance has its own state, so independent simulations can run
+// concurrently with their own instance
+class SystemRandom : public Random,
+                     public Creatable1<Random, SystemRandom, long> {
 public:
-  static void initialize(long seed);
-  static void ensure_initialized(long seed);
-  static std::shared_ptr<SystemRandom> get_instance();
+  explicit SystemRandom(long seed);
+
+  // Returns a seed derived from the given seed and stream index,
+  // such that different streams are independent
+  static uint64_t derive_seed(uint64_t seed, uint64_t stream);
+
+  // Resets the state as if the instance had been created with this seed
+  void seed(long seed);
 
   std::string get_address() override;
 
-  // Delegates to standard drand48()
+  // Same sequence as the standard drand48() seeded with srand48(seed)
+  // but using the state of this instance
   double drand48() override;
 
   int random_int(int min, int max) override;
 
   std::shared_ptr<std::default_random_engine> get_random_engine();
 
+  void save(CheckpointWriter& writer) const override;
+  void load(CheckpointReader& reader) override;
+
   // Avoid accidental copies
   SystemRandom(SystemRandom const&) = delete;
   void operator=(SystemRandom const&) = delete;
 private:
-  static bool initialized;
   std::shared_ptr<std::default_random_engine> random_engine;
-  SystemRandom();
+  // erand48 state
+  unsigned short xsubi[3];
+};
+
+MAKE_FACTORY(RandomFactory, Random, long)
+
+
+// xoshiro256** generator, see http://prng.di.unimi.it/
+// Much faster than drand48, and hands out its uniforms in batches
+// get_random_engine() returns a standard engine seeded from the same seed,
+// used by the standard distributions
+class Xoshiro256Random : public Random,
+                         public Creatable1<Random, Xoshiro256Random, long> {
+public:
+  explicit Xoshiro256Random(long seed);
+
+  // Resets the state as if the instance had been created with this seed
+  void seed(long seed);
+
+  // Returns the next 64 random bits
+  inline uint64_t next();
+
+  // Never returns exactly 0 or 1
+  double drand48() override;
+  void fill_uniform(double* values, size_t count) override;
+  size_t get_batch_size() const override;
+
+  std::string get_address() override;
+  int random_int(int min, int max) override;
+  std::shared_ptr<std::default_random_engine> get_random_engine() override;
+
+  void save(CheckpointWriter& writer) const override;
+  void load(CheckpointReader& reader) override;
+
+  Xoshiro256Random(Xoshiro256Random const&) = delete;
+  void operator=(Xoshiro256Random const&) = delete;
+private:
+  uint64_t state[4];
+  std::shared_ptr<std::default_random_engine> random_engine;
+
+  static inline uint64_t rotl(uint64_t x, int k);
+  static inline double to_uniform(uint64_t bits);
+};
+
+inline uint64_t Xoshiro256Random::rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+inline uint64_t Xoshiro256Random::next() {
+  const uint64_t result = rotl(state[1] * 5, 7) * 9;
+  const uint64_t t = state[1] << 17;
+  state[2] ^= state[0];
+  state[3] ^= state[1];
+  state[1] ^= state[2];
+  state[0] ^= state[3];
+  state[2] ^= t;
+  state[3] = rotl(state[3], 45);
+  return result;
+}
+
+inline double Xoshiro256Random::to_uniform(uint64_t bits) {
+  // middle of one of the 2^53 intervals, so that log() of it is finite
+  return ((bits >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+
+// Counter-based Philox4x32-10 generator, see
+// "Parallel random numbers: as easy as 1, 2, 3" (Salmon et al., 2011)
+// The n-th block of random bits of a stream is a function of the key
+// (the seed), the stream (pool, miner) and n only, so any stream can be
+// jumped to without generating the previous values
+class PhiloxRandom : public Random,
+                     public Creatable1<Random, PhiloxRandom, long> {
+public:
+  explicit PhiloxRandom(long seed);
+  PhiloxRandom(uint64_t key, uint32_t pool, uint32_t miner);
+
+  // Returns the 128 random bits for the given counter and key
+  static std::array<uint32_t, 4> generate(const std::array<uint32_t, 4>& counter,
+                                          const std::array<uint32_t, 2>& key);
+
+  double drand48() override;
+  void fill_uniform(double* values, size_t count) override;
+  size_t get_batch_size() const override;
+
+  bool has_streams() const override;
+  std::shared_ptr<Random> get_stream(uint32_t pool, uint32_t miner) override;
+
+  // Moves to the given block of the stream
+  void set_position(uint64_t position);
+  // Returns the index of the next block of the stream
+  uint64_t get_position() const;
+
+  std::string get_address() override;
+  int random_int(int min, int max) override;
+  // Standard engine seeded from the key and the stream
+  std::shared_ptr<std::default_random_engine> get_random_engine() override;
+
+  void save(CheckpointWriter& writer) const override;
+  void load(CheckpointReader& reader) override;
+
+  PhiloxRandom(PhiloxRandom const&) = delete;
+  void operator=(PhiloxRandom const&) = delete;
+private:
+  uint64_t key;
+  uint32_t pool;
+  uint32_t miner;
+  uint64_t position = 0;
+  // each block gives two uniforms, the second one is kept here
+  double next_value = 0;
+  bool has_next_value = false;
+  std::shared_ptr<std::default_random_engine> random_engine;
+
+  inline double next_uniform();
+};
+
+
+// Buffer of variates drawn in batches from a random instance
+// Avoids a virtual call per value on the hot path of the simulator
+// Exponentials are computed a batch at a time with the vectorized log_batch(),
+// or with std::log when the batch size is 1, to keep the previous results
+class RandomBuffer {
+public:
+  explicit RandomBuffer(std::shared_ptr<Random> random);
+
+  // Returns the next random double between 0 and 1
+  inline double next() {
+    if (position == values.size()) {
+      refill();
+    }
+    return values[position++];
+  }
+
+  // Returns the next exponential variate of rate 1
+  inline double next_exponential() {
+    if (exponential_position == exponentials.size()) {
+      refill_exponentials();
+    }
+    return exponentials[exponential_position++];
+  }
+
+  // Writes the values drawn but not used yet to a checkpoint
+  void save(CheckpointWriter& writer) const;
+  void load(CheckpointReader& reader);
+private:
+  std::shared_ptr<Random> random;
+  std::vector<double> values;
+  size_t position = 0;
+  std::vector<double> exponentials;
+  size_t exponential_position = 0;
+
+  void refill();
+  void refill_exponentials();
 };
 
+
 // Base class for a probability distribution
 class Distribution {
 public:
-  Distribution();
   explicit Distribution(std::shared_ptr<Random> random);
   virtual double get() = 0;
 protected:
   std::shared_ptr<Random> random;
 };
 
-MAKE_FACTORY(DistributionFactory, Distribution, const nlohmann::json&)
+MAKE_FACTORY(DistributionFactory, Distribution, const nlohmann::json&, std::shared_ptr<Random>)
 
 
 class NormalDistribution : public Distribution,
-                           public Creatable1<Distribution, NormalDistribution, const nlohmann::json&> {
+                           public Creatable2<Distribution, NormalDistribution,
+                                            const nlohmann::json&, std::shared_ptr<Random>> {
 public:
-  explicit NormalDistribution(const nlohmann::json& args);
-  NormalDistribution(double mean, double stddev);
+  NormalDistribution(const nlohmann::json& args, std::shared_ptr<Random> random);
   NormalDistribution(double mean, double stddev, std::shared_ptr<Random> random);
   virtual double get();
 private:
@@ -104,10 +289,10 @@ private:
 };
 
 class LogNormalDistribution : public Distribution,
-                              public Creatable1<Distribution, LogNormalDistribution, const nlohmann::json&> {
+                              public Creatable2<Distribution, LogNormalDistribution,
+                                                const nlohmann::json&, std::shared_ptr<Random>> {
 public:
-  explicit LogNormalDistribution(const nlohmann::json& args);
-  LogNormalDistribution(double mean, double stddev);
+  LogNormalDistribution(const nlohmann::json& args, std::shared_ptr<Random> random);
   LogNormalDistribution(double mean, double stddev, std::shared_ptr<Random> random);
   virtual double get();
 private:
@@ -116,10 +301,10 @@ private:
 
 
 class UniformDistribution : public Distribution,
-                            public Creatable1<Distribution, UniformDistribution, const nlohmann::json&> {
+                            public Creatable2<Distribution, UniformDistribution,
+                                              const nlohmann::json&, std::shared_ptr<Random>> {
 public:
-  explicit UniformDistribution(const nlohmann::json& args);
-  UniformDistribution(double low, double high);
+  UniformDistribution(const nlohmann::json& args, std::shared_ptr<Random> random);
   UniformDistribution(double low, double high, std::shared_ptr<Random> random);
   virtual double get();
 private:
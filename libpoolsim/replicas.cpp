@@ -0,0 +1,202 @@
+#include <cmath>
+#include <future>
+#include <map>
+
+#include <spdlog/spdlog.h>
+
+#include "replicas.h"
+#include "simulator.h"
+#include "thread_pool.h"
+#include "random.h"
+
+namespace poolsim {
+
+using nlohmann::json;
+
+
+void SummaryStatistics::add(double value) {
+  count++;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+}
+
+size_t SummaryStatistics::get_count() const {
+  return count;
+}
+
+double SummaryStatistics::get_mean() const {
+  return mean;
+}
+
+double SummaryStatistics::get_stddev() const {
+  if (count < 2) {
+    return 0;
+  }
+  return std::sqrt(m2 / (count - 1));
+}
+
+double SummaryStatistics::get_ci95() const {
+  if (count == 0) {
+    return 0;
+  }
+  // normal approximation, the number of replicas is expected to be large
+  return 1.96 * get_stddev() / std::sqrt(count);
+}
+
+void to_json(json& j, const SummaryStatistics& statistics) {
+  j["mean"] = statistics.get_mean();
+  j["stddev"] = statistics.get_stddev();
+  j["ci95"] = {statistics.get_mean() - statistics.get_ci95(),
+               statistics.get_mean() + statistics.get_ci95()};
+}
+
+
+ReplicaRunner::ReplicaRunner(const Simulation& _simulation, size_t _replicas, size_t _threads)
+  : simulation(_simulation), replicas(_replicas), threads(_threads) {}
+
+std::string ReplicaRunner::get_replica_output(const std::string& output, size_t replica) {
+  // insert the index before the extensions of the file name
+  size_t name_start = output.find_last_of('/');
+  name_start = name_start == std::string::npos ? 0 : name_start + 1;
+  size_t extension_start = output.find('.', name_start);
+  if (extension_start == std::string::npos) {
+    extension_start = output.size();
+  }
+  return output.substr(0, extension_start) + "-" + std::to_string(replica) + output.substr(extension_start);
+}
+
+void ReplicaRunner::run(bool save_outputs) {
+  spdlog::info("running {} replicas on {} threads", replicas, threads);
+
+  std::vector<std::future<ReplicaResult>> futures;
+  {
+    ThreadPool pool(threads);
+    for (size_t i = 0; i < replicas; i++) {
+      futures.push_back(pool.submit([this, i, save_outputs]() {
+        return run_replica(i, save_outputs);
+      }));
+    }
+  }
+
+  results.clear();
+  for (auto& future : futures) {
+    results.push_back(future.get());
+  }
+}
+
+ReplicaResult ReplicaRunner::run_replica(size_t replica, bool save_output) const {
+  Simulation replica_simulation = simulation;
+  replica_simulation.output = get_replica_output(simulation.output, replica);
+  // replicas are not resumable, as their miners are not created from their own seed
+  replica_simulation.checkpoint_path.clear();
+  if (!simulation.blocks_output.empty()) {
+    replica_simulation.blocks_output = get_replica_output(simulation.blocks_output, replica);
+  }
+
+  uint64_t seed = SystemRandom::derive_seed(simulation.seed, replica);
+  std::shared_ptr<Random> random = RandomFactory::create(simulation.rng, seed);
+  auto simulator = std::make_shared<Simulator>(replica_simulation, random);
+  simulator->set_population_random(RandomFactory::create(simulation.rng, simulation.seed));
+  // the summary does not need the blocks
+  simulator->set_blocks_enabled(save_output || !simulation.blocks_output.empty());
+  simulator->run();
+  spdlog::debug("replica {} done", replica);
+
+  if (save_output) {
+    simulator->save_simulation_data();
+  }
+  if (!simulation.store.empty()) {
+    StoredRun run = simulator->get_stored_run();
+    run.seed = seed;
+    run.replica = replica;
+    run.output = save_output ? replica_simulation.output : "";
+    ResultStore(simulation.store).append(run);
+  }
+
+  ReplicaResult result;
+  result.seed = seed;
+  for (auto pool : simulator->get_pools()) {
+    PoolReplicaResult pool_result;
+    pool_result.name = pool->get_name();
+    pool_result.luck = 0;
+    if (pool->get_shares_count() > 0) {
+      double expected_shares = (double) simulation.network_difficulty / pool->get_difficulty();
+      pool_result.luck = 100.0 * pool->get_blocks_mined() * expected_shares / pool->get_shares_count();
+    }
+    pool->export_records(simulator->get_miner_ids_by_address(), [&pool_result](const MinerRecord& record) {
+      pool_result.miners.push_back(MinerReplicaResult {
+        record.get_miner_address(),
+        record.get_blocks_received()
+      });
+    });
+    result.pools.push_back(pool_result);
+  }
+  return result;
+}
+
+const std::vector<ReplicaResult>& ReplicaRunner::get_results() const {
+  return results;
+}
+
+json ReplicaRunner::get_summary() const {
+  // pools and miners are listed in the order of the first replica
+  std::vector<std::string> pool_names;
+  std::map<std::string, SummaryStatistics> lucks;
+  std::map<std::string, std::vector<std::string>> miner_addresses;
+  std::map<std::string, std::map<std::string, SummaryStatistics>> blocks_received;
+
+  for (const ReplicaResult& result : results) {
+    for (const PoolReplicaResult& pool : result.pools) {
+      if (lucks.find(pool.name) == lucks.end()) {
+        pool_names.push_back(pool.name);
+      }
+      lucks[pool.name].add(pool.luck);
+      auto& pool_blocks_received = blocks_received[pool.name];
+      for (const MinerReplicaResult& miner : pool.miners) {
+        if (pool_blocks_received.find(miner.address) == pool_blocks_received.end()) {
+          miner_addresses[pool.name].push_back(miner.address);
+        }
+        pool_blocks_received[miner.address].add(miner.blocks_received);
+      }
+    }
+  }
+
+  json summary;
+  summary["replicas"] = results.size();
+  summary["seed"] = simulation.seed;
+  summary["seeds"] = json::array();
+  for (const ReplicaResult& result : results) {
+    summary["seeds"].push_back(result.seed);
+  }
+  summary["pools"] = json::array();
+  for (const std::string& pool_name : pool_names) {
+    json pool;
+    pool["name"] = pool_name;
+    pool["luck"] = lucks.at(pool_name);
+    pool["miners"] = json::array();
+    for (const std::string& address : miner_addresses[pool_name]) {
+      json miner;
+      miner["address"] = address;
+      miner["blocks_received"] = blocks_received[pool_name].at(address);
+      pool["miners"].push_back(miner);
+    }
+    summary["pools"].push_back(pool);
+  }
+  return summary;
+}
+
+void ReplicaRunner::save_summary() const {
+  Simulator::output_result(simulation.output, get_summary(), simulation.compression);
+}
+
+bool ReplicaRunner::check_single_thread() const {
+  // the runs are already in the store
+  Simulation single_thread_simulation = simulation;
+  single_thread_simulation.store.clear();
+  ReplicaRunner single_thread(single_thread_simulation, replicas, 1);
+  single_thread.run(false);
+  return single_thread.get_summary() == get_summary();
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "simulation.h"
+
+namespace poolsim {
+
+// Running mean and variance of a value over the replicas (Welford)
+class SummaryStatistics {
+public:
+  void add(double value);
+
+  size_t get_count() const;
+  double get_mean() const;
+  // sample standard deviation
+  double get_stddev() const;
+  // half width of the 95% confidence interval of the mean
+  double get_ci95() const;
+private:
+  size_t count = 0;
+  double mean = 0;
+  double m2 = 0;
+};
+
+void to_json(nlohmann::json& j, const SummaryStatistics& statistics);
+
+
+// Results of a single replica kept for the merged summary
+struct MinerReplicaResult {
+  std::string address;
+  double blocks_received;
+};
+
+struct PoolReplicaResult {
+  std::string name;
+  // expected over actual number of shares per block, in percent
+  double luck;
+  std::vector<MinerReplicaResult> miners;
+};
+
+struct ReplicaResult {
+  uint64_t seed;
+  std::vector<PoolReplicaResult> pools;
+};
+
+
+// Runs independent replications of a simulation on a thread pool
+// All the replicas simulate the same population of miners, created from
+// the seed of the simulation, while the shares of each replica are drawn
+// from a stream seeded with a seed derived from the replica index
+class ReplicaRunner {
+public:
+  ReplicaRunner(const Simulation& simulation, size_t replicas, size_t threads);
+
+  // Runs all the replicas
+  // When `save_outputs` is true, each replica writes its result
+  // to the simulation output suffixed with the replica index
+  void run(bool save_outputs);
+
+  // Returns the mean, standard deviation and confidence interval over the
+  // replicas of the luck of each pool and the blocks received by each miner
+  nlohmann::json get_summary() const;
+
+  // Writes the summary to the simulation output
+  void save_summary() const;
+
+  // Runs the replicas again on a single thread and returns whether
+  // the summary is identical to the one of the last run
+  bool check_single_thread() const;
+
+  // Returns the output path of a replica, e.g. results.json -> results-3.json
+  static std::string get_replica_output(const std::string& output, size_t replica);
+
+  const std::vector<ReplicaResult>& get_results() const;
+
+private:
+  Simulation simulation;
+  size_t replicas;
+  size_t threads;
+  // indexed by replica, so that the summary does not depend on scheduling
+  std::vector<ReplicaResult> results;
+
+  ReplicaResult run_replica(size_t replica, bool save_output) const;
+};
+
+}
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "result_index.h"
+#include "summary.h"
+
+using json = nlohmann::json;
+
+namespace poolsim {
+
+std::string get_index_path(const std::string& output) {
+  return replace_extensions(output, index_extension);
+}
+
+uint64_t hash_string(const std::string& value) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : value) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t get_file_size(const std::string& filepath) {
+  std::ifstream file(filepath, std::ios_base::in | std::ios_base::binary | std::ios_base::ate);
+  if (!file) {
+    throw std::invalid_argument("could not open " + filepath);
+  }
+  return static_cast<uint64_t>(file.tellg());
+}
+
+
+void ResultIndexBuilder::add_miner(const std::string& address, uint64_t offset, uint64_t length) {
+  Entry& entry = miners[address].miner;
+  entry.offset = offset;
+  entry.length = length;
+}
+
+void ResultIndexBuilder::add_pool(const std::string& name, double difficulty, uint64_t offset, uint64_t length) {
+  Entry entry;
+  entry.pool = pools.size();
+  entry.offset = offset;
+  entry.length = length;
+  pool_names.push_back(name);
+  pool_difficulties.push_back(difficulty);
+  pools.push_back(entry);
+}
+
+void ResultIndexBuilder::add_record(const std::string& address, uint32_t pool, uint64_t offset, uint64_t length) {
+  Entry entry;
+  entry.pool = pool;
+  entry.offset = offset;
+  entry.length = length;
+  miners[address].records.push_back(entry);
+}
+
+void ResultIndexBuilder::write(const std::string& filepath, const std::string& result_path,
+                               const std::string& codec, const std::vector<BlockPosition>& blocks) const {
+  // sorted by bucket, then by address so that the index does not depend on the order of the map
+  uint64_t buckets_count = std::max<uint64_t>(1, miners.size());
+  std::vector<std::pair<uint64_t, const std::string*>> order;
+  order.reserve(miners.size());
+  for (auto& miner : miners) {
+    order.emplace_back(hash_string(miner.first) % buckets_count, &miner.first);
+  }
+  std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, const std::string*>& a,
+                                           const std::pair<uint64_t, const std::string*>& b) {
+    return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+  });
+
+  std::vector<std::string> addresses;
+  std::vector<uint64_t> hashes, miner_offsets, miner_lengths, records_start, records_count;
+  std::vector<uint32_t> record_pools;
+  std::vector<uint64_t> record_offsets, record_lengths;
+  std::vector<uint64_t> bucket_starts(buckets_count + 1, 0);
+  for (auto& miner : order) {
+    const MinerEntries& entries = miners.at(*miner.second);
+    addresses.push_back(*miner.second);
+    hashes.push_back(hash_string(*miner.second));
+    miner_offsets.push_back(entries.miner.offset);
+    miner_lengths.push_back(entries.miner.length);
+    records_start.push_back(record_pools.size());
+    records_count.push_back(entries.records.size());
+    for (auto& record : entries.records) {
+      record_pools.push_back(record.pool);
+      record_offsets.push_back(record.offset);
+      record_lengths.push_back(record.length);
+    }
+    bucket_starts[miner.first + 1]++;
+  }
+  for (size_t i = 1; i < bucket_starts.size(); i++) {
+    bucket_starts[i] += bucket_starts[i - 1];
+  }
+
+  std::vector<uint64_t> compressed_offsets, compressed_sizes, block_offsets, block_sizes;
+  for (auto& block : blocks) {
+    compressed_offsets.push_back(block.compressed_offset);
+    compressed_sizes.push_back(block.compressed_size);
+    block_offsets.push_back(block.offset);
+    block_sizes.push_back(block.size);
+  }
+
+  std::vector<uint64_t> pool_offsets, pool_lengths;
+  for (auto& pool : pools) {
+    pool_offsets.push_back(pool.offset);
+    pool_lengths.push_back(pool.length);
+  }
+
+  ColumnarWriter writer;
+  writer.add_column("result.codec", std::vector<std::string>{codec});
+  writer.add_column("result.size", std::vector<uint64_t>{get_file_size(result_path)});
+  writer.add_column("blocks.compressed_offset", compressed_offsets);
+  writer.add_column("blocks.compressed_size", compressed_sizes);
+  writer.add_column("blocks.offset", block_offsets);
+  writer.add_column("blocks.size", block_sizes);
+  writer.add_column("pools.name", pool_names);
+  writer.add_column("pools.difficulty", pool_difficulties);
+  writer.add_column("pools.offset", pool_offsets);
+  writer.add_column("pools.length", pool_lengths);
+  writer.add_column("miners.address", addresses);
+  writer.add_column("miners.hash", hashes);
+  writer.add_column("miners.offset", miner_offsets);
+  writer.add_column("miners.length", miner_lengths);
+  writer.add_column("miners.records_start", records_start);
+  writer.add_column("miners.records_count", records_count);
+  writer.add_column("records.pool", record_pools);
+  writer.add_column("records.offset", record_offsets);
+  writer.add_column("records.length", record_lengths);
+  writer.add_column("buckets.start", bucket_starts);
+  writer.write(filepath);
+}
+
+
+IndexedResult::IndexedResult(const std::string& _result_path, const std::string& index_path)
+  : result_path(_result_path), index(index_path) {
+  std::string codec_name = index.get_string("result.codec", 0);
+  if (codec_name != "none") {
+    codec = create_codec(codec_name, default_compression_level);
+  }
+  if (get_file_size(result_path) != index.get<uint64_t>("result.size")[0]) {
+    throw std::invalid_argument(index_path + " is not the index of " + result_path);
+  }
+  if (index.get_rows("buckets.start") < 2) {
+    throw std::invalid_argument("invalid buckets in " + index_path);
+  }
+}
+
+int64_t IndexedResult::find_miner(const std::string& address) const {
+  const uint64_t* starts = index.get<uint64_t>("buckets.start");
+  const uint64_t* hashes = index.get<uint64_t>("miners.hash");
+  uint64_t rows = index.get_rows("miners.hash");
+  uint64_t hash = hash_string(address);
+  uint64_t bucket = hash % (index.get_rows("buckets.start") - 1);
+  for (uint64_t row = starts[bucket]; row < starts[bucket + 1] && row < rows; row++) {
+    if (hashes[row] == hash && index.get_string("miners.address", row) == address) {
+      return row;
+    }
+  }
+  return -1;
+}
+
+std::string IndexedResult::read(uint64_t offset, uint64_t length) const {
+  std::ifstream file(result_path, std::ios_base::in | std::ios_base::binary);
+  if (!codec) {
+    std::string data(length, '\0');
+    file.seekg(offset);
+    file.read(&data[0], length);
+    if (!file) {
+      throw std::invalid_argument("could not read " + result_path);
+    }
+    return data;
+  }
+
+  const uint64_t* offsets = index.get<uint64_t>("blocks.offset");
+  const uint64_t* sizes = index.get<uint64_t>("blocks.size");
+  const uint64_t* compressed_offsets = index.get<uint64_t>("blocks.compressed_offset");
+  const uint64_t* compressed_sizes = index.get<uint64_t>("blocks.compressed_size");
+  uint64_t blocks = index.get_rows("blocks.offset");
+  // last block starting at or before the offset
+  uint64_t block = std::upper_bound(offsets, offsets + blocks, offset) - offsets;
+  block = block > 0 ? block - 1 : 0;
+
+  std::string data;
+  for (; data.size() < length && block < blocks; block++) {
+    std::string compressed(compressed_sizes[block], '\0');
+    file.seekg(compressed_offsets[block]);
+    file.read(&compressed[0], compressed.size());
+    if (!file) {
+      throw std::invalid_argument("could not read " + result_path);
+    }
+    std::string decompressed = codec->decompress(compressed, sizes[block]);
+    uint64_t start = offset + data.size() - offsets[block];
+    if (start < decompressed.size()) {
+      data.append(decompressed, start, length - data.size());
+    }
+  }
+  if (data.size() < length) {
+    throw std::invalid_argument("entry out of the range of " + result_path);
+  }
+  return data;
+}
+
+json IndexedResult::read_entry(uint64_t offset, uint64_t length) const {
+  try {
+    return json::parse(read(offset, length));
+  } catch (const json::exception& e) {
+    throw std::invalid_argument("invalid entry in " + result_path + ": " + e.what());
+  }
+}
+
+json IndexedResult::get_miner(const std::string& address) const {
+  int64_t row = find_miner(address);
+  if (row < 0 || index.get<uint64_t>("miners.length")[row] == 0) {
+    return nullptr;
+  }
+  return read_entry(index.get<uint64_t>("miners.offset")[row], index.get<uint64_t>("miners.length")[row]);
+}
+
+json IndexedResult::get_records(const std::string& address) const {
+  json records = json::array();
+  int64_t row = find_miner(address);
+  if (row < 0) {
+    return records;
+  }
+  const uint32_t* pools = index.get<uint32_t>("records.pool");
+  const uint64_t* offsets = index.get<uint64_t>("records.offset");
+  const uint64_t* lengths = index.get<uint64_t>("records.length");
+  const double* difficulties = index.get<double>("pools.difficulty");
+  uint64_t start = index.get<uint64_t>("miners.records_start")[row];
+  uint64_t end = start + index.get<uint64_t>("miners.records_count")[row];
+  if (end > index.get_rows("records.pool")) {
+    throw std::invalid_argument("invalid records in the index of " + result_path);
+  }
+  for (uint64_t i = start; i < end; i++) {
+    records.push_back({
+      {"difficulty", difficulties[pools[i]]},
+      {"name", index.get_string("pools.name", pools[i])},
+      {"record", read_entry(offsets[i], lengths[i])}
+    });
+  }
+  return records;
+}
+
+json IndexedResult::get_pool(const std::string& name) const {
+  for (uint64_t row = 0; row < index.get_rows("pools.name"); row++) {
+    if (index.get_string("pools.name", row) == name) {
+      return read_entry(index.get<uint64_t>("pools.offset")[row], index.get<uint64_t>("pools.length")[row]);
+    }
+  }
+  return nullptr;
+}
+
+// throws if the field was not written in the result
+static const json& get_field(const json& j, const std::string& name) {
+  if (!j.is_object() || j.find(name) == j.end()) {
+    throw std::invalid_argument("the result does not have the field " + name);
+  }
+  return j.at(name);
+}
+
+json IndexedResult::get_miner_info(const std::string& address) const {
+  json miner = get_miner(address);
+  if (miner.is_null()) {
+    throw std::invalid_argument("miner " + address + " does not exist");
+  }
+  json records = get_records(address);
+  if (records.empty()) {
+    throw std::invalid_argument("miner not in any pool");
+  }
+
+  uint64_t blocks_mined = 0;
+  double blocks_received = 0;
+  json work_in_pool_per_block = json::object();
+  for (auto& entry : records) {
+    const json& metadata = get_field(entry["record"], "metadata");
+    double received = get_field(metadata, "blocks_received").get<double>();
+    blocks_mined += get_field(metadata, "blocks_mined").get<uint64_t>();
+    blocks_received += received;
+    work_in_pool_per_block[entry["name"].get<std::string>()] =
+      get_ratio(get_field(metadata, "share_count").get<double>() * entry["difficulty"].get<double>(), received);
+  }
+  double total_work = get_field(miner, "total_work").get<double>();
+  return {
+    {"blocks_mined", blocks_mined},
+    {"blocks_ratio", get_ratio(blocks_received, blocks_mined)},
+    {"blocks_received", blocks_received},
+    {"work_in_pool_per_block", work_in_pool_per_block},
+    {"work_per_block", get_ratio(total_work, blocks_received)},
+    {"work_per_block_solo", get_ratio(total_work, blocks_mined)}
+  };
+}
+
+}
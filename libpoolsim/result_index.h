@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "codec.h"
+#include "columnar.h"
+
+namespace poolsim {
+
+// Index of a json result, written next to it to read the entries of a miner or
+// a pool without reading the whole result
+// It is a columnar file (see columnar.h) with the columns
+//   result.codec, result.size: the codec and the size of the result file
+//   blocks.*: the positions of the compressed blocks of the result
+//   pools.*: the name, difficulty, offset and length of each pool entry
+//   miners.*: the address and its hash, the offset and length of the entry in the
+//     miners section (a length of 0 when not written), and the range of its records
+//   records.*: the pool, offset and length of each record of a miner in a pool
+//   buckets.start: the miners are sorted by bucket, the hash of the address modulo the
+//     number of buckets, and the bucket of a miner starts at this row of the miners
+// Offsets and lengths are in the uncompressed result
+const char index_extension[] = ".index.psc";
+
+// Returns the path of the index written next to the output
+std::string get_index_path(const std::string& output);
+
+// 64 bits FNV-1a hash, which does not change across builds, e.g. of an address
+uint64_t hash_string(const std::string& value);
+
+
+// Collects the positions of the entries while the result is written
+class ResultIndexBuilder {
+public:
+  void add_miner(const std::string& address, uint64_t offset, uint64_t length);
+
+  // Adds the pool written at the given position, pools being numbered in the order they are added
+  void add_pool(const std::string& name, double difficulty, uint64_t offset, uint64_t length);
+
+  // Adds the record of a miner in the pool with the given number
+  void add_record(const std::string& address, uint32_t pool, uint64_t offset, uint64_t length);
+
+  // Writes the index of the result, compressed with `codec` in the given blocks
+  // Throws std::invalid_argument if the index could not be written
+  void write(const std::string& filepath, const std::string& result_path, const std::string& codec,
+             const std::vector<BlockPosition>& blocks) const;
+
+private:
+  struct Entry {
+    uint32_t pool = 0;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+  };
+
+  struct MinerEntries {
+    Entry miner;
+    std::vector<Entry> records;
+  };
+
+  std::vector<std::string> pool_names;
+  std::vector<double> pool_difficulties;
+  std::vector<Entry> pools;
+  std::unordered_map<std::string, MinerEntries> miners;
+};
+
+
+// Reads the entries of a json result through its index
+// Throws std::invalid_argument if the index is invalid or does not match the result
+class IndexedResult {
+public:
+  IndexedResult(const std::string& result_path, const std::string& index_path);
+
+  // Returns the entry of the miner in the miners section, or null if it is not written
+  nlohmann::json get_miner(const std::string& address) const;
+
+  // Returns the records of the miner in the pools, as objects with the "name"
+  // and "difficulty" of the pool and the "record" itself
+  nlohmann::json get_records(const std::string& address) const;
+
+  // Returns the entry of the pool, or null if it is not written
+  nlohmann::json get_pool(const std::string& name) const;
+
+  // Returns the blocks mined and received by the miner over all the pools and its
+  // work per block, as computed by scripts/get_miner_info.py
+  // Throws std::invalid_argument if the miner or its records are not in the result
+  nlohmann::json get_miner_info(const std::string& address) const;
+
+private:
+  std::string result_path;
+  ColumnarFile index;
+  std::unique_ptr<Codec> codec;
+
+  // Returns the row of the miner in the index, or -1 if it is not indexed
+  int64_t find_miner(const std::string& address) const;
+
+  // Reads `length` bytes at `offset` of the uncompressed result
+  std::string read(uint64_t offset, uint64_t length) const;
+
+  nlohmann::json read_entry(uint64_t offset, uint64_t length) const;
+};
+
+}
@@ -0,0 +1,261 @@
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef USE_SQLITE3
+#include <sqlite3.h>
+#endif
+
+#include "result_index.h"
+#include "result_store.h"
+
+using json = nlohmann::json;
+
+namespace poolsim {
+
+std::string get_config_hash(const json& config) {
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(hash_string(config.dump())));
+  return hash;
+}
+
+
+#ifdef USE_SQLITE3
+
+// how long an append waits for the other connections, in milliseconds
+const int store_busy_timeout = 60 * 1000;
+
+static const char store_schema[] =
+  "CREATE TABLE IF NOT EXISTS runs ("
+  "  id INTEGER PRIMARY KEY,"
+  "  config_hash TEXT NOT NULL,"
+  "  config TEXT NOT NULL,"
+  "  seed TEXT NOT NULL,"
+  "  replica INTEGER,"
+  "  output TEXT,"
+  "  blocks INTEGER,"
+  "  total_work INTEGER,"
+  "  runtime_milliseconds REAL,"
+  "  created_at TEXT DEFAULT CURRENT_TIMESTAMP);"
+  "CREATE TABLE IF NOT EXISTS parameters ("
+  "  run_id INTEGER NOT NULL REFERENCES runs(id),"
+  "  path TEXT NOT NULL,"
+  "  value);"
+  "CREATE TABLE IF NOT EXISTS behaviors ("
+  "  run_id INTEGER NOT NULL REFERENCES runs(id),"
+  "  behavior TEXT NOT NULL,"
+  "  miners INTEGER,"
+  "  hashrate REAL,"
+  "  blocks_mined INTEGER,"
+  "  blocks_received REAL,"
+  "  blocks_ratio REAL,"
+  "  total_work INTEGER,"
+  "  work_per_block REAL);"
+  "CREATE TABLE IF NOT EXISTS pools ("
+  "  run_id INTEGER NOT NULL REFERENCES runs(id),"
+  "  name TEXT NOT NULL,"
+  "  reward_scheme TEXT,"
+  "  difficulty INTEGER,"
+  "  blocks_mined INTEGER,"
+  "  shares_count INTEGER,"
+  "  luck REAL,"
+  "  luck_mean REAL,"
+  "  luck_stddev REAL,"
+  "  rounds INTEGER);"
+  "CREATE INDEX IF NOT EXISTS runs_config_hash ON runs(config_hash);"
+  "CREATE INDEX IF NOT EXISTS parameters_run_id ON parameters(run_id);"
+  "CREATE INDEX IF NOT EXISTS behaviors_run_id ON behaviors(run_id);"
+  "CREATE INDEX IF NOT EXISTS pools_run_id ON pools(run_id);";
+
+// Prepared statement, finalized when destroyed
+class Statement {
+public:
+  Statement(sqlite3* database, const std::string& sql);
+  ~Statement();
+
+  Statement(Statement const&) = delete;
+  void operator=(Statement const&) = delete;
+
+  // Binds the parameters in order, numbers and strings with their type and
+  // other values as json text
+  void bind(const std::vector<json>& values);
+
+  // Executes the statement up to the next row, returns false when done
+  bool step();
+
+  json get_row() const;
+
+private:
+  sqlite3* database;
+  sqlite3_stmt* statement = nullptr;
+};
+
+Statement::Statement(sqlite3* _database, const std::string& sql) : database(_database) {
+  if (sqlite3_prepare_v2(database, sql.c_str(), -1, &statement, nullptr) != SQLITE_OK) {
+    throw std::invalid_argument(std::string("invalid statement: ") + sqlite3_errmsg(database));
+  }
+}
+
+Statement::~Statement() {
+  sqlite3_finalize(statement);
+}
+
+void Statement::bind(const std::vector<json>& values) {
+  sqlite3_reset(statement);
+  sqlite3_clear_bindings(statement);
+  for (size_t i = 0; i < values.size(); i++) {
+    const json& value = values[i];
+    int index = i + 1;
+    if (value.is_null()) {
+      sqlite3_bind_null(statement, index);
+    } else if (value.is_boolean()) {
+      sqlite3_bind_int(statement, index, value.get<bool>() ? 1 : 0);
+    } else if (value.is_number_integer()) {
+      sqlite3_bind_int64(statement, index, value.get<int64_t>());
+    } else if (value.is_number()) {
+      sqlite3_bind_double(statement, index, value.get<double>());
+    } else {
+      std::string text = value.is_string() ? value.get<std::string>() : value.dump();
+      sqlite3_bind_text(statement, index, text.c_str(), text.size(), SQLITE_TRANSIENT);
+    }
+  }
+}
+
+bool Statement::step() {
+  int result = sqlite3_step(statement);
+  if (result != SQLITE_ROW && result != SQLITE_DONE) {
+    throw std::invalid_argument(std::string("store statement failed: ") + sqlite3_errmsg(database));
+  }
+  return result == SQLITE_ROW;
+}
+
+json Statement::get_row() const {
+  json row = json::object();
+  for (int i = 0; i < sqlite3_column_count(statement); i++) {
+    std::string name = sqlite3_column_name(statement, i);
+    switch (sqlite3_column_type(statement, i)) {
+    case SQLITE_INTEGER:
+      row[name] = static_cast<int64_t>(sqlite3_column_int64(statement, i));
+      break;
+    case SQLITE_FLOAT:
+      row[name] = sqlite3_column_double(statement, i);
+      break;
+    case SQLITE_NULL:
+      row[name] = nullptr;
+      break;
+    default:
+      row[name] = std::string(reinterpret_cast<const char*>(sqlite3_column_text(statement, i)),
+                              sqlite3_column_bytes(statement, i));
+    }
+  }
+  return row;
+}
+
+
+ResultStore::ResultStore(const std::string& _filepath) : filepath(_filepath) {
+  if (sqlite3_open(filepath.c_str(), &database) != SQLITE_OK) {
+    std::string message = database ? sqlite3_errmsg(database) : "out of memory";
+    sqlite3_close(database);
+    throw std::invalid_argument("could not open the store " + filepath + ": " + message);
+  }
+  try {
+    sqlite3_busy_timeout(database, store_busy_timeout);
+    execute("PRAGMA journal_mode=WAL");
+    execute(std::string("BEGIN IMMEDIATE;") + store_schema + "COMMIT;");
+  } catch (...) {
+    sqlite3_close(database);
+    throw;
+  }
+}
+
+ResultStore::~ResultStore() {
+  sqlite3_close(database);
+}
+
+void ResultStore::execute(const std::string& sql) const {
+  char* error = nullptr;
+  if (sqlite3_exec(database, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+    std::string message = error ? error : sqlite3_errmsg(database);
+    sqlite3_free(error);
+    // leaves no transaction open after a failure
+    sqlite3_exec(database, "ROLLBACK", nullptr, nullptr, nullptr);
+    throw std::invalid_argument("store " + filepath + ": " + message);
+  }
+}
+
+int64_t ResultStore::append(const StoredRun& run) {
+  execute("BEGIN IMMEDIATE");
+  try {
+    Statement insert_run(database,
+      "INSERT INTO runs (config_hash, config, seed, replica, output, blocks, total_work, runtime_milliseconds) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    insert_run.bind({get_config_hash(run.config), run.config.dump(), std::to_string(run.seed),
+                     run.replica >= 0 ? json(run.replica) : json(nullptr), run.output,
+                     run.blocks, run.total_work, run.runtime_milliseconds});
+    insert_run.step();
+    int64_t run_id = sqlite3_last_insert_rowid(database);
+
+    Statement insert_parameter(database, "INSERT INTO parameters (run_id, path, value) VALUES (?, ?, ?)");
+    for (auto it = run.parameters.begin(); it != run.parameters.end(); ++it) {
+      insert_parameter.bind({run_id, it.key(), it.value()});
+      insert_parameter.step();
+    }
+
+    Statement insert_behavior(database,
+      "INSERT INTO behaviors (run_id, behavior, miners, hashrate, blocks_mined, blocks_received, blocks_ratio, "
+      "total_work, work_per_block) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    for (auto& behavior : run.behaviors) {
+      insert_behavior.bind({run_id, behavior.behavior, behavior.miners, behavior.hashrate, behavior.blocks_mined,
+                            behavior.blocks_received, get_ratio(behavior.blocks_received, behavior.blocks_mined),
+                            behavior.total_work, get_ratio(behavior.total_work, behavior.blocks_received)});
+      insert_behavior.step();
+    }
+
+    Statement insert_pool(database,
+      "INSERT INTO pools (run_id, name, reward_scheme, difficulty, blocks_mined, shares_count, luck, "
+      "luck_mean, luck_stddev, rounds) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    for (auto& pool : run.pools) {
+      const LuckDistribution& luck = pool.luck_distribution;
+      insert_pool.bind({run_id, pool.name, pool.reward_scheme, pool.difficulty, pool.blocks_mined,
+                        pool.shares_count, pool.get_luck(), luck.get_mean(), luck.get_stddev(),
+                        luck.get_count()});
+      insert_pool.step();
+    }
+
+    execute("COMMIT");
+    return run_id;
+  } catch (...) {
+    sqlite3_exec(database, "ROLLBACK", nullptr, nullptr, nullptr);
+    throw;
+  }
+}
+
+json ResultStore::query(const std::string& sql) const {
+  Statement statement(database, sql);
+  json rows = json::array();
+  while (statement.step()) {
+    rows.push_back(statement.get_row());
+  }
+  return rows;
+}
+
+#else
+
+ResultStore::ResultStore(const std::string& _filepath) : filepath(_filepath) {
+  throw std::invalid_argument("the result store is not available in this build of poolsim");
+}
+
+ResultStore::~ResultStore() {}
+
+void ResultStore::execute(const std::string& sql) const {}
+
+int64_t ResultStore::append(const StoredRun& run) {
+  return -1;
+}
+
+json ResultStore::query(const std::string& sql) const {
+  return json::array();
+}
+
+#endif
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "summary.h"
+
+struct sqlite3;
+
+namespace poolsim {
+
+// Summary of a run appended to a result store
+struct StoredRun {
+  // config of the simulation, with the values of the sweep point if any
+  nlohmann::json config;
+  // values of the sweep axes, keyed by path
+  nlohmann::json parameters = nlohmann::json::object();
+  uint64_t seed = 0;
+  // index of the replica, or -1 for a single simulation or a sweep point
+  int64_t replica = -1;
+  std::string output;
+  uint64_t blocks = 0;
+  uint64_t total_work = 0;
+  double runtime_milliseconds = 0;
+  std::vector<BehaviorSummary> behaviors;
+  std::vector<PoolSummary> pools;
+};
+
+// Returns the hash of the config, as 16 hexadecimal digits
+std::string get_config_hash(const nlohmann::json& config);
+
+
+// SQLite database collecting the summaries of many runs, so that they can be
+// compared without reading their outputs, with the tables
+//   runs: the config and its hash, the seed, the replica, the output, the number
+//     of blocks, the total work and the runtime of each run
+//   parameters: the values of the sweep axes of each run, by path
+//   behaviors: the totals of the miners of each behavior in each run
+//   pools: the blocks, shares and luck of each pool in each run
+// The database is opened in WAL mode and each run is appended in a single
+// transaction, so several threads and processes can append to it at once
+class ResultStore {
+public:
+  // Opens the database, creating it and its tables if needed
+  // Throws std::invalid_argument if it cannot be opened or if poolsim was built without SQLite
+  explicit ResultStore(const std::string& filepath);
+  ~ResultStore();
+
+  ResultStore(ResultStore const&) = delete;
+  void operator=(ResultStore const&) = delete;
+
+  // Appends the run, waiting while another connection is appending
+  // Returns the id of the run in the runs table
+  int64_t append(const StoredRun& run);
+
+  // Returns the rows of the query as objects keyed by column
+  nlohmann::json query(const std::string& sql) const;
+
+private:
+  std::string filepath;
+  sqlite3* database = nullptr;
+
+  // Executes statements without results
+  void execute(const std::string& sql) const;
+};
+
+}
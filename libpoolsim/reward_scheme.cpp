@@ -15,6 +15,8 @@ void from_json(const nlohmann::json& j, PPLNSConfig& r) {
     j.at("n").get_to(r.n);
     if (j.find("pool_fee") != j.end())
         j.at("pool_fee").get_to(r.pool_fee);
+    if (j.find("run_length_encoding") != j.end())
+        j.at("run_length_encoding").get_to(r.run_length_encoding);
 }
 void from_json(const nlohmann::json& j, RewardConfig& r) {
 
@@ -22,26 +24,6 @@ void from_json(const nlohmann::json& j, RewardConfig& r) {
         j.at("pool_fee").get_to(r.pool_fee);
 }
 
-void to_json(nlohmann::json& j, const BlockMetaData& b) {
-    j = nlohmann::json{
-        {"shares_per_block", b.shares_per_block},
-        {"pool_luck", b.pool_luck}
-    };
-}
-
-void to_json(nlohmann::json& j, const QBBlockMetaData& b) {
-    j = nlohmann::json{
-        {"shares_per_block", b.shares_per_block},
-        {"pool_luck", b.pool_luck},
-        {"credit_balance_receiver", b.credit_balance_receiver},
-        {"receiver_address", b.receiver_address},
-        {"reset_balance_receiver", b.reset_balance_receiver},
-        {"proportion_credits_lost", b.prop_credits_lost},
-        {"total_credits_lost", b.total_credits_lost},
-        {"average_credits_lost", b.average_credits_lost}
-    };
-}
-
 RewardScheme::~RewardScheme() {}
 
 void RewardScheme::set_pool_fee(double _fee) {
@@ -51,12 +33,43 @@ void RewardScheme::set_pool_fee(double _fee) {
 
 void RewardScheme::set_mining_pool(std::shared_ptr<MiningPool> _mining_pool) {
   mining_pool = _mining_pool;
+  random = _mining_pool->get_random();
 }
 
 std::shared_ptr<MiningPool> RewardScheme::get_mining_pool() {
   return mining_pool.lock();
 }
 
+void RewardScheme::handle_share(const std::string& miner_address, const Share& share) {
+    handle_share(get_miner_id(miner_address), share);
+}
+
+void RewardScheme::handle_shares(uint32_t miner_id, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        handle_share(miner_id, Share(Share::Property::none));
+    }
+}
+
+bool RewardScheme::needs_individual_shares() const {
+    return true;
+}
+
+void RewardScheme::save(CheckpointWriter& writer) const {
+    writer.write(shares_per_block);
+}
+
+void RewardScheme::load(CheckpointReader& reader) {
+    reader.read(shares_per_block);
+}
+
+uint32_t RewardScheme::get_miner_id(const std::string& miner_address) {
+    return get_mining_pool()->get_network()->get_miner_id(miner_address);
+}
+
+std::string RewardScheme::get_miner_address(uint32_t miner_id) const {
+    return mining_pool.lock()->get_network()->get_miner_address(miner_id);
+}
+
 double RewardScheme::get_pool_luck() {
     if (shares_per_block == 0) {
         return 0.0;
@@ -79,9 +92,9 @@ PPSRewardScheme::PPSRewardScheme(const nlohmann::json& _args) {
     set_pool_fee(pps_config.pool_fee);
 }
 
-void PPSRewardScheme::handle_share(const std::string& miner_address, const Share& share) {
+void PPSRewardScheme::handle_share(uint32_t miner_id, const Share& share) {
    shares_per_block++;
-   auto record = find_record(miner_address);
+   auto record = find_record(miner_id);
    update_record(record, share);
 
     if (!share.is_valid_block())
@@ -91,24 +104,37 @@ void PPSRewardScheme::handle_share(const std::string& miner_address, const Share
     block_meta_data.pool_luck = get_pool_luck();
 
     if (!share.is_uncle()) {
-        record->inc_blocks_mined();
+        record.inc_blocks_mined();
         shares_per_block = 0;
         return;
     }
 
-    handle_uncle(miner_address);
-    record->inc_uncles_mined();
+    handle_uncle(miner_id);
+    record.inc_uncles_mined();
+}
+
+void PPSRewardScheme::handle_shares(uint32_t miner_id, uint64_t count) {
+    shares_per_block += count;
+    auto record = find_record(miner_id);
+    record.inc_shares_count(count);
+    uint64_t network_difficulty = get_mining_pool()->get_network()->get_difficulty();
+    double p = get_mining_pool()->get_difficulty()/(double)network_difficulty;
+    record.inc_blocks_received(count*(1-pool_fee)*p);
+}
+
+bool PPSRewardScheme::needs_individual_shares() const {
+    return false;
 }
 
-void PPSRewardScheme::handle_uncle(const std::string& miner_address) {
+void PPSRewardScheme::handle_uncle(uint32_t miner_id) {
     // Not relevant for a traditional PPS scheme, as all shares are paid for directly by the pool
 }
 
-void PPSRewardScheme::update_record(std::shared_ptr<MinerRecord> record, const Share& share) {
-    record->inc_shares_count();
+void PPSRewardScheme::update_record(RecordView record, const Share& share) {
+    record.inc_shares_count();
     uint64_t network_difficulty = get_mining_pool()->get_network()->get_difficulty();
     double p = get_mining_pool()->get_difficulty()/(double)network_difficulty;
-    record->inc_blocks_received((1-pool_fee)*p);
+    record.inc_blocks_received((1-pool_fee)*p);
 }
 
 REGISTER(RewardScheme, PPSRewardScheme, "pps")
@@ -121,22 +147,17 @@ std::string PPLNSRewardScheme::get_scheme_name() const {
 PPLNSRewardScheme::PPLNSRewardScheme(const nlohmann::json& _args) {
     PPLNSConfig pplns_config;
     from_json(_args, pplns_config);
-    set_n(pplns_config.n);
+    assert(pplns_config.n > 0);
+    n = pplns_config.n;
+    window = PPLNSWindow(n, pplns_config.run_length_encoding);
     set_pool_fee(pplns_config.pool_fee);
 }
 
-void PPLNSRewardScheme::insert_share(std::string miner_address) {
-    last_n_shares.push_back(miner_address);
-    while (last_n_shares.size() > n) {
-        last_n_shares.pop_front();
-    }
-}
-
-void PPLNSRewardScheme::handle_share(const std::string& miner_address, const Share& share) {
-    auto miner_record = find_record(miner_address);
+void PPLNSRewardScheme::handle_share(uint32_t miner_id, const Share& share) {
+    auto miner_record = find_record(miner_id);
     update_record(miner_record, share);
     shares_per_block++;
-    insert_share(miner_address);
+    window.push(miner_id);
 
     if (!share.is_valid_block())
         return;
@@ -145,34 +166,50 @@ void PPLNSRewardScheme::handle_share(const std::string& miner_address, const Sha
     block_meta_data.pool_luck = get_pool_luck();
 
     if (!share.is_uncle()) {
-        for (const std::string& miner_address : last_n_shares) {
-            auto record = find_record(miner_address);
-            record->inc_blocks_received((1.0/last_n_shares.size()));
+        // each miner receives its part of the shares of the window at once
+        for (const WindowMiner& miner : window.get_miners()) {
+            auto record = find_record(miner.miner_id);
+            record.inc_blocks_received((double) miner.shares / window.size());
         }
         shares_per_block = 0;
         return;
     }
 
-    handle_uncle(miner_address);
+    handle_uncle(miner_id);
 }
 
-void PPLNSRewardScheme::update_record(std::shared_ptr<MinerRecord> record, const Share& share) {
-    record->inc_shares_count();
+void PPLNSRewardScheme::update_record(RecordView record, const Share& share) {
+    record.inc_shares_count();
     if (share.is_network_share())
-        record->inc_blocks_mined();
+        record.inc_blocks_mined();
     else if (share.is_uncle())
-        record->inc_uncles_mined();
+        record.inc_uncles_mined();
 }
 
 void PPLNSRewardScheme::set_n(uint64_t _n) {
     assert(_n > 0);
     n = _n;
+    PPLNSWindow resized(n, window.is_run_length_encoded());
+    for (uint32_t miner_id : window.get_miner_ids()) {
+        resized.push(miner_id);
+    }
+    window = resized;
+}
+
+void PPLNSRewardScheme::save(CheckpointWriter& writer) const {
+    BaseRewardScheme::save(writer);
+    window.save(writer);
+}
+
+void PPLNSRewardScheme::load(CheckpointReader& reader) {
+    BaseRewardScheme::load(reader);
+    window.load(reader);
 }
 
-void PPLNSRewardScheme::handle_uncle(const std::string& miner_address) {
-    for (const std::string& miner_address : last_n_shares) {
-        auto record = find_record(miner_address);
-        record->inc_uncles_received(1.0/last_n_shares.size());
+void PPLNSRewardScheme::handle_uncle(uint32_t miner_id) {
+    for (const WindowMiner& miner : window.get_miners()) {
+        auto record = find_record(miner.miner_id);
+        record.inc_uncles_received((double) miner.shares / window.size());
     }
 }
 
@@ -188,40 +225,42 @@ QBRewardScheme::QBRewardScheme(const nlohmann::json& _args) {
     set_pool_fee(qb_config.pool_fee);
 }
 
-void QBRewardScheme::update_record(std::shared_ptr<QBRecord> record, const Share& share) {
+void QBRewardScheme::update_record(RecordView record, const Share& share) {
     auto share_difficulty = get_mining_pool()->get_difficulty();
-    record->inc_credits(share_difficulty);
-    record->inc_shares_count();
+    record.inc_credits(share_difficulty);
+    ranking.set_credits(record.get_miner_id(), record.get_credits());
+    record.inc_shares_count();
     if (share.is_network_share()) {
-        record->inc_blocks_mined();
-        record->update_avg_credits_per_block();
+        record.inc_blocks_mined();
+        record.update_avg_credits_per_block();
     } else if (share.is_uncle())
-        record->inc_uncles_mined();
+        record.inc_uncles_mined();
 }
 
 void QBRewardScheme::reward_top_miner() {
-    if (records.empty()) {
+    if (ranking.size() == 0) {
         return;
     }
 
-    if (records.size() == 1) {
-        records[0]->inc_blocks_received();
-        block_meta_data.credit_balance_receiver = records[0]->get_credits();
-        block_meta_data.receiver_address = records[0]->get_miner_address();
+    auto top_record = find_record(ranking.at(0));
+    if (ranking.size() == 1) {
+        top_record.inc_blocks_received();
+        block_meta_data.credit_balance_receiver = top_record.get_credits();
+        block_meta_data.receiver_id = top_record.get_miner_id();
         shares_per_block = 0;
         return;
     }
 
-    std::sort(records.begin(), records.end(), QBSortObj());
-    records[0]->inc_blocks_received();
-    block_meta_data.credit_balance_receiver = records[0]->get_credits();
-    block_meta_data.receiver_address = records[0]->get_miner_address();
-    uint64_t credits_diff = records[0]->get_credits() - records[1]->get_credits();
+    auto second_record = find_record(ranking.at(1));
+    top_record.inc_blocks_received();
+    block_meta_data.credit_balance_receiver = top_record.get_credits();
+    block_meta_data.receiver_id = top_record.get_miner_id();
+    uint64_t credits_diff = top_record.get_credits() - second_record.get_credits();
     block_meta_data.reset_balance_receiver = credits_diff;
 
     uint64_t credits_sum = get_credits_sum();
     if (credits_sum)
-        block_meta_data.prop_credits_lost = (double)records[1]->get_credits()/credits_sum;
+        block_meta_data.prop_credits_lost = (double)second_record.get_credits()/credits_sum;
     else
         block_meta_data.prop_credits_lost = 0;
 
@@ -229,20 +268,29 @@ void QBRewardScheme::reward_top_miner() {
     block_meta_data.average_credits_lost = block_meta_data.total_credits_lost / get_mining_pool()->get_blocks_mined();
 
     shares_per_block = 0;
-    records[0]->set_credits(credits_diff);
+    top_record.set_credits(credits_diff);
+    ranking.set_credits(top_record.get_miner_id(), credits_diff);
 }
 
 uint_fast64_t QBRewardScheme::get_credits_sum() {
-    uint64_t sum = 0;
-    for (auto record : records) {
-        sum += record->get_credits();
+    return ranking.get_credits_sum();
+}
+
+const CreditRanking& QBRewardScheme::get_ranking() const {
+    return ranking;
+}
+
+void QBRewardScheme::load(CheckpointReader& reader) {
+    BaseRewardScheme::load(reader);
+    ranking.clear();
+    for (uint32_t slot = 0; slot < store.size(); slot++) {
+        ranking.set_credits(store.miner_ids[slot], store.credits[slot]);
     }
-    return sum;
 }
 
-void QBRewardScheme::handle_share(const std::string& miner_address, const Share& share) {
+void QBRewardScheme::handle_share(uint32_t miner_id, const Share& share) {
     shares_per_block++;
-    auto record = this->find_record(miner_address);
+    auto record = this->find_record(miner_id);
     this->update_record(record, share);
     
     if (!share.is_valid_block())
@@ -254,18 +302,18 @@ void QBRewardScheme::handle_share(const std::string& miner_address, const Share&
     if (share.is_network_share()) {
         this->reward_top_miner();
     } else if (share.is_uncle()) {
-        handle_uncle(miner_address);
+        handle_uncle(miner_id);
     }
 }
 
 uint64_t QBRewardScheme::get_credits(const std::string& miner_address) {
-    auto record = this->find_record(miner_address);
-    return record->get_credits();
+    auto record = this->find_record(get_miner_id(miner_address));
+    return record.get_credits();
 }
 
-void QBRewardScheme::handle_uncle(const std::string& miner_address) {
-    auto random_miner = random->random_element(records.begin(), records.end());
-    random_miner->inc_uncles_received();
+void QBRewardScheme::handle_uncle(uint32_t miner_id) {
+    uint32_t random_miner_id = random->random_element(store.miner_ids.begin(), store.miner_ids.end());
+    find_record(random_miner_id).inc_uncles_received();
 }
 
 REGISTER(RewardScheme, QBRewardScheme, "qb")
@@ -280,9 +328,9 @@ PROPRewardScheme::PROPRewardScheme(const nlohmann::json& _args) {
     set_pool_fee(prop_config.pool_fee);
 }
 
-void PROPRewardScheme::handle_share(const std::string& miner_address, const Share& share) {
+void PROPRewardScheme::handle_share(uint32_t miner_id, const Share& share) {
     shares_per_block++;
-    auto record = find_record(miner_address);
+    auto record = find_record(miner_id);
     update_record(record, share);
 
     if (!share.is_valid_block())
@@ -292,45 +340,78 @@ void PROPRewardScheme::handle_share(const std::string& miner_address, const Shar
     block_meta_data.pool_luck = get_pool_luck();
 
     if (share.is_network_share()) {
-        for (auto miner_record : records) {
-            double reward = 1.0*(miner_record->get_shares_per_round()/(double)shares_per_block);
-            miner_record->inc_blocks_received(reward);
-            miner_record->reset_shares_per_round();
+        for (uint32_t slot : round_slots) {
+            RecordView miner_record(store, slot);
+            double reward = 1.0*(miner_record.get_shares_per_round()/(double)shares_per_block);
+            miner_record.inc_blocks_received(reward);
+            miner_record.reset_shares_per_round();
         }
+        round_slots.clear();
         shares_per_block = 0;
     } else if (share.is_uncle()) {
-        handle_uncle(miner_address);
+        handle_uncle(miner_id);
+    }
+}
+
+void PROPRewardScheme::handle_shares(uint32_t miner_id, uint64_t count) {
+    shares_per_block += count;
+    auto record = find_record(miner_id);
+    record.inc_shares_count(count);
+    add_round_shares(record, count);
+}
+
+bool PROPRewardScheme::needs_individual_shares() const {
+    return false;
+}
+
+void PROPRewardScheme::handle_uncle(uint32_t miner_id) {
+    for (uint32_t slot : round_slots) {
+        RecordView record(store, slot);
+        double reward = (record.get_shares_per_round()/(double)shares_per_block);
+        record.inc_uncles_received(reward);
     }
 }
 
-void PROPRewardScheme::handle_uncle(const std::string& miner_address) {
-    for (auto record : records) {
-        double reward = (record->get_shares_per_round()/(double)shares_per_block);
-        record->inc_uncles_received(reward);
+void PROPRewardScheme::add_round_shares(RecordView record, uint64_t count) {
+    if (record.get_shares_per_round() == 0 && count > 0)
+        round_slots.push_back(record.get_slot());
+    record.inc_shares_per_round(count);
+}
+
+void PROPRewardScheme::load(CheckpointReader& reader) {
+    BaseRewardScheme::load(reader);
+    round_slots.clear();
+    for (uint32_t slot = 0; slot < store.size(); slot++) {
+        if (store.shares_per_round[slot] > 0)
+            round_slots.push_back(slot);
     }
 }
 
-std::list<std::string>& PPLNSRewardScheme::get_last_n_shares() {
-    return last_n_shares;
+std::vector<uint32_t> PPLNSRewardScheme::get_last_n_shares() const {
+    return window.get_miner_ids();
 }
 
 uint64_t PPLNSRewardScheme::get_last_n_shares_size() const {
-    return last_n_shares.size();
+    return window.size();
+}
+
+const PPLNSWindow& PPLNSRewardScheme::get_window() const {
+    return window;
 }
 
-void PROPRewardScheme::update_record(std::shared_ptr<MinerRecord> record, const Share& share) {
-    record->inc_shares_count();
-    record->inc_shares_per_round();
+void PROPRewardScheme::update_record(RecordView record, const Share& share) {
+    record.inc_shares_count();
+    add_round_shares(record, 1);
 
     if (!share.is_valid_block())
         return;
 
     if (share.is_uncle()) {
-        record->inc_uncles_mined();
+        record.inc_uncles_mined();
         return;
     }
 
-    record->inc_blocks_mined();
+    record.inc_blocks_mined();
 }
 
 REGISTER(RewardScheme, PROPRewardScheme, "prop")
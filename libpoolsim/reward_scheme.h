@@ -1,56 +1,69 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <nlohmann/json.hpp>
-#include <list>
 #include <map>
+#include <vector>
 
 #include "share.h"
 #include "factory.h"
 #include "random.h"
 #include "miner_record.h"
+#include "checkpoint.h"
+#include "block_event.h"
+#include "credit_ranking.h"
+#include "pplns_window.h"
 
 namespace poolsim {
 
 class MiningPool;
 
+// Receives the records exported by a reward scheme
+using RecordCallback = std::function<void(const MinerRecord&)>;
+
 struct RewardConfig {
     double pool_fee = 0;
 };
 
 struct PPLNSConfig : RewardConfig {
     uint64_t n = 0;
+    // whether the window is kept as runs of shares of the same miner (see PPLNSWindow)
+    bool run_length_encoding = false;
 };
 
-struct BlockMetaData {
-    uint64_t shares_per_block = 0;
-    double pool_luck = 0;
-};
-
-struct QBBlockMetaData : BlockMetaData {
-    uint64_t credit_balance_receiver = 0;
-    std::string receiver_address;
-    uint64_t reset_balance_receiver = 0;
-    double prop_credits_lost = 0;
-    double total_credits_lost = 0;
-    double average_credits_lost = 0;
-};
 
 class RewardScheme {
 public:
     virtual ~RewardScheme();
 
-    virtual void handle_share(const std::string& miner_address, const Share& share) = 0;
+    virtual void handle_share(uint32_t miner_id, const Share& share) = 0;
+
+    // Resolves the address to its miner id and handles the share
+    // the simulator itself only ever submits miner ids
+    void handle_share(const std::string& miner_address, const Share& share);
+
+    // Handles `count` shares of the miner that are not valid blocks
+    // Defaults to handling them one by one
+    virtual void handle_shares(uint32_t miner_id, uint64_t count);
+
+    // Returns whether the scheme needs to see each share that is not a valid block
+    // individually, rather than only the number of such shares per miner and round
+    virtual bool needs_individual_shares() const;
 
     // Set the mining pool for this reward scheme
     // RewardScheme and MiningPool should be a 1 to 1 relationship
+    // The reward scheme uses the random instance of the pool
     void set_mining_pool(std::shared_ptr<MiningPool> mining_pool);
 
-    // returns the metadata of the last block mined as json (including uncle blocks)
-    virtual nlohmann::json get_json_metadata() = 0;
+    // returns the metadata of the last block mined (including uncle blocks)
+    virtual BlockSchemeData get_block_data() const = 0;
 
-    // returns the metadata for a miner
-    virtual nlohmann::json get_miner_metadata(const std::string& miner_address) = 0;
+    // calls `callback` with the record of each miner of `miner_ids`, in the given order
+    // miners which have not submitted any share get an empty record
+    virtual void export_records(const std::vector<uint32_t>& miner_ids, const RecordCallback& callback) const = 0;
 
     // returns the name of the reward scheme
     virtual std::string get_scheme_name() const = 0;
@@ -64,6 +77,13 @@ public:
     // returns the luck of the mining pool for the current round
     double get_pool_luck();
 
+    // writes the state of the scheme to a checkpoint
+    virtual void save(CheckpointWriter& writer) const;
+
+    // restores the state written by save()
+    // the network must already be restored, as records are created from it
+    virtual void load(CheckpointReader& reader);
+
     // USED FOR TESTING
     virtual double get_blocks_received(const std::string& miner_address) = 0;
     virtual uint64_t get_blocks_mined(const std::string& miner_address) = 0;
@@ -71,15 +91,21 @@ public:
 
 protected:
     // logic for distributing uncle block reward in pool
-    virtual void handle_uncle(const std::string& miner_address) = 0;
+    virtual void handle_uncle(uint32_t miner_id) = 0;
+
+    // returns the id of the miner address in the network of the pool
+    uint32_t get_miner_id(const std::string& miner_address);
+
+    // returns the address of the miner id in the network of the pool
+    std::string get_miner_address(uint32_t miner_id) const;
 
     std::weak_ptr<MiningPool> mining_pool;
+    // random instance of the pool
+    std::shared_ptr<Random> random;
     // number of shares submitted per block mined (NOT including uncles)
     uint64_t shares_per_block = 0;
     // the percentage of a block reward taken by the pool operator
     double pool_fee = 0;    
-    // random instance
-    std::shared_ptr<Random> random = SystemRandom::get_instance();
 };
 
 MAKE_FACTORY(RewardSchemeFactory, RewardScheme, const nlohmann::json&);
@@ -89,44 +115,65 @@ class BaseRewardScheme :
     public RewardScheme,
     public Creatable1<RewardScheme, T, const nlohmann::json&> {
 public:
-    // returns all the records
-    std::vector<std::shared_ptr<RecordClass>> get_records();
+    // returns the records, in the order they were added, without copying them
+    const RecordStore& get_record_store() const;
+
+    // returns a copy of all the records, in the order they were added
+    std::vector<std::shared_ptr<RecordClass>> copy_records() const;
 
     // returns the last block metadat
     BlockData get_block_metadata() const;
 
+    // writes the records, in their current order, and the last block metadata
+    void save(CheckpointWriter& writer) const override;
+    void load(CheckpointReader& reader) override;
+
     using record_class = RecordClass;
     using block_metadata_class = BlockData;
 
 protected:
-    std::vector<std::shared_ptr<RecordClass>> records;
+    // balances of the records, by slot
+    RecordStore store;
+    // slot of the record of each miner id, invalid_slot for the miners without a record
+    std::vector<uint32_t> slots_by_id;
+    static const uint32_t invalid_slot = std::numeric_limits<uint32_t>::max();
 
     // increments mined block and credits stats for a given record
-    virtual void update_record(std::shared_ptr<RecordClass> record, const Share& share) = 0;
+    virtual void update_record(RecordView record, const Share& share) = 0;
 
     // returns the metadata needed when a block has been mined
-    virtual nlohmann::json get_json_metadata() override;
+    virtual BlockSchemeData get_block_data() const override;
 
-    // returns the metadata for a miner
-    virtual nlohmann::json get_miner_metadata(const std::string& miner_address) override;
+    void export_records(const std::vector<uint32_t>& miner_ids, const RecordCallback& callback) const override;
 
     // returns record of a miner if it exists, otherwise a new record is created and returned
-    std::shared_ptr<RecordClass> find_record(const std::string& miner_address);
+    RecordView find_record(uint32_t miner_id);
 
     //stores the meta data associated to the last block mined
     BlockData block_meta_data;
 
-    // returns the list of all miner records
-    //std::vector<shared_ptr<RecordClass>> get_all_records();
-    
     // USED FOR TESTING
     virtual double get_blocks_received(const std::string& miner_address) override;
     virtual uint64_t get_blocks_mined(const std::string& miner_address) override;
+    // returns a copy of the record
     virtual std::shared_ptr<MinerRecord> get_record(const std::string& miner_address) override;
 };
 
 template <typename T, typename RecordClass, typename BlockData>
-std::vector<std::shared_ptr<RecordClass>> BaseRewardScheme<T, RecordClass, BlockData>::get_records() {
+const uint32_t BaseRewardScheme<T, RecordClass, BlockData>::invalid_slot;
+
+template <typename T, typename RecordClass, typename BlockData>
+const RecordStore& BaseRewardScheme<T, RecordClass, BlockData>::get_record_store() const {
+    return store;
+}
+
+template <typename T, typename RecordClass, typename BlockData>
+std::vector<std::shared_ptr<RecordClass>> BaseRewardScheme<T, RecordClass, BlockData>::copy_records() const {
+    std::vector<std::shared_ptr<RecordClass>> records;
+    records.reserve(store.size());
+    for (uint32_t slot = 0; slot < store.size(); slot++) {
+        records.push_back(std::make_shared<RecordClass>(store, slot, this->get_miner_address(store.miner_ids[slot])));
+    }
     return records;
 }
 
@@ -135,52 +182,74 @@ BlockData BaseRewardScheme<T, RecordClass, BlockData>::get_block_metadata() cons
     return block_meta_data;
 }
 
+template <typename T, typename RecordClass, typename BlockData>
+void BaseRewardScheme<T, RecordClass, BlockData>::save(CheckpointWriter& writer) const {
+    RewardScheme::save(writer);
+    store.save(writer);
+    poolsim::save(writer, block_meta_data);
+}
 
 template <typename T, typename RecordClass, typename BlockData>
-std::shared_ptr<RecordClass> BaseRewardScheme<T, RecordClass, BlockData>::find_record(const std::string& miner_address) {
-  for (auto iter = records.begin(); iter != records.end(); ++iter) {
-    if ((*iter)->get_miner_address() == miner_address)
-      return (*iter);
-  }
-
-  auto record = std::make_shared<RecordClass>(miner_address);
-  records.push_back(record);
-  return record;
+void BaseRewardScheme<T, RecordClass, BlockData>::load(CheckpointReader& reader) {
+    RewardScheme::load(reader);
+    store.load(reader);
+    slots_by_id.clear();
+    for (uint32_t slot = 0; slot < store.size(); slot++) {
+        uint32_t miner_id = store.miner_ids[slot];
+        if (miner_id >= slots_by_id.size())
+            slots_by_id.resize(miner_id + 1, invalid_slot);
+        slots_by_id[miner_id] = slot;
+    }
+    poolsim::load(reader, block_meta_data);
+}
+
+template <typename T, typename RecordClass, typename BlockData>
+RecordView BaseRewardScheme<T, RecordClass, BlockData>::find_record(uint32_t miner_id) {
+  if (miner_id < slots_by_id.size() && slots_by_id[miner_id] != invalid_slot)
+    return RecordView(store, slots_by_id[miner_id]);
+
+  if (miner_id >= slots_by_id.size())
+    slots_by_id.resize(miner_id + 1, invalid_slot);
+  slots_by_id[miner_id] = store.add(miner_id);
+  return RecordView(store, slots_by_id[miner_id]);
 }
 
 template<typename T, typename RecordClass, typename BlockData>
-nlohmann::json BaseRewardScheme<T, RecordClass, BlockData>::get_json_metadata() {
-    nlohmann::json j;
-    to_json(j, block_meta_data);
-    return j;
+BlockSchemeData BaseRewardScheme<T, RecordClass, BlockData>::get_block_data() const {
+    return BlockSchemeData(block_meta_data);
 }
 
 template<typename T, typename RecordClass, typename BlockData>
-nlohmann::json BaseRewardScheme<T, RecordClass, BlockData>::get_miner_metadata(const std::string& miner_address) {
-    nlohmann::json j;
-    to_json(j, *find_record(miner_address));
-    return j;
+void BaseRewardScheme<T, RecordClass, BlockData>::export_records(const std::vector<uint32_t>& miner_ids,
+                                                                const RecordCallback& callback) const {
+    for (uint32_t miner_id : miner_ids) {
+        if (miner_id < slots_by_id.size() && slots_by_id[miner_id] != invalid_slot) {
+            callback(RecordClass(store, slots_by_id[miner_id], this->get_miner_address(miner_id)));
+        } else {
+            callback(RecordClass(miner_id, this->get_miner_address(miner_id)));
+        }
+    }
 }
 
 // USED FOR TESTING
 template<typename T, typename RecordClass, typename BlockData>
 double BaseRewardScheme<T, RecordClass, BlockData>::get_blocks_received(const std::string& miner_address) {
-    auto record = find_record(miner_address);
-    return record->get_blocks_received();
+    auto record = find_record(get_miner_id(miner_address));
+    return record.get_blocks_received();
 }
 
 // USED FOR TESTING
 template<typename T, typename RecordClass, typename BlockData>
 uint64_t BaseRewardScheme<T, RecordClass, BlockData>::get_blocks_mined(const std::string& miner_address) {
-    auto record = find_record(miner_address);
-    return record->get_blocks_mined();
+    auto record = find_record(get_miner_id(miner_address));
+    return record.get_blocks_mined();
 }
 
 // USED FOR TESTING
 template<typename T, typename RecordClass, typename BlockData>
 std::shared_ptr<MinerRecord> BaseRewardScheme<T, RecordClass, BlockData>::get_record(const std::string& miner_address) {
-    auto record = find_record(miner_address);
-    return record;
+    auto record = find_record(get_miner_id(miner_address));
+    return std::make_shared<RecordClass>(store, record.get_slot(), miner_address);
 }
 
 // Pay-per-share reward scheme
@@ -190,11 +259,15 @@ public:
 
     std::string get_scheme_name() const override;
 
-    void handle_share(const std::string& miner_address, const Share& share) override;
+    using RewardScheme::handle_share;
+    void handle_share(uint32_t miner_id, const Share& share) override;
+
+    void handle_shares(uint32_t miner_id, uint64_t count) override;
+    bool needs_individual_shares() const override;
 private:
-    void handle_uncle(const std::string& miner_address) override;
+    void handle_uncle(uint32_t miner_id) override;
 
-    void update_record(std::shared_ptr<MinerRecord> record, const Share& share) override;
+    void update_record(RecordView record, const Share& share) override;
 };
 
 // Pay-per-last-n-shares reward scheme
@@ -204,25 +277,30 @@ public:
 
     std::string get_scheme_name() const override;
 
-    void handle_share(const std::string& miner_address, const Share& share) override;
+    using RewardScheme::handle_share;
+    void handle_share(uint32_t miner_id, const Share& share) override;
 
+    // keeps the last shares of the window, up to the new n
     void set_n(uint64_t _n);
 
+    // also writes the miners of the last n shares
+    void save(CheckpointWriter& writer) const override;
+    void load(CheckpointReader& reader) override;
+
     // USED FOR TESTS
-    std::list<std::string>& get_last_n_shares();
+    std::vector<uint32_t> get_last_n_shares() const;
     uint64_t get_last_n_shares_size() const;
+    const PPLNSWindow& get_window() const;
 
 private:
-    void handle_uncle(const std::string& miner_address) override;
+    void handle_uncle(uint32_t miner_id) override;
     
-    void update_record(std::shared_ptr<MinerRecord> record, const Share& share) override;
+    void update_record(RecordView record, const Share& share) override;
 
     // the number of last shares over which a reward will be distributed
     uint64_t n = 0;
-    // list of miner addresses that submitted last n shares
-    std::list<std::string> last_n_shares;
-    // inserts a miners address to the list of address of last n miners that submitted a share
-    void insert_share(std::string miner_address);
+    // miner ids of the last n shares, with the number of shares of each miner
+    PPLNSWindow window;
 };
 
 // Queue-based reward scheme
@@ -232,19 +310,30 @@ public:
 
     std::string get_scheme_name() const override;
 
-    void handle_share(const std::string& miner_address, const Share& share) override;
+    using RewardScheme::handle_share;
+    void handle_share(uint32_t miner_id, const Share& share) override;
     
     uint64_t get_credits(const std::string& miner_address);
 
+    // returns the miners of the pool ranked by credits
+    const CreditRanking& get_ranking() const;
+
+    // also ranks the loaded records
+    void load(CheckpointReader& reader) override;
+
 protected:
     // by default: sample a random miner from the pool for receiving the full uncle reward
-    void handle_uncle(const std::string& miner_address) override;
+    void handle_uncle(uint32_t miner_id) override;
     // updates stats of top miner in pool and resets the top miners credits
     void reward_top_miner();
     // updates the given record based on the type of share accordingly 
-    void update_record(std::shared_ptr<QBRecord> record, const Share& share) override;
+    void update_record(RecordView record, const Share& share) override;
     // returns the total sum of credit balances by pool
     uint64_t get_credits_sum();
+
+private:
+    // the credits of every record, kept up to date with the records
+    CreditRanking ranking;
 };
 
 // Proportional reward scheme
@@ -254,17 +343,28 @@ public:
 
     std::string get_scheme_name() const override;
 
-    void handle_share(const std::string& miner_address, const Share& share) override;
+    using RewardScheme::handle_share;
+    void handle_share(uint32_t miner_id, const Share& share) override;
+
+    void handle_shares(uint32_t miner_id, uint64_t count) override;
+    bool needs_individual_shares() const override;
+
+    // also collects the records with shares in the current round
+    void load(CheckpointReader& reader) override;
 
 private:
-    void handle_uncle(const std::string& miner_address) override;   
+    void handle_uncle(uint32_t miner_id) override;   
     
-    void update_record(std::shared_ptr<MinerRecord> record, const Share& share) override;
+    void update_record(RecordView record, const Share& share) override;
+
+    // adds shares to the round of the record, collecting it on its first share of the round
+    void add_round_shares(RecordView record, uint64_t count);
+
+    // slots of the records with shares in the current round, the only ones paid for a block or an uncle
+    std::vector<uint32_t> round_slots;
 };
 
 void from_json(const nlohmann::json& j, PPLNSConfig& r);
 void from_json(const nlohmann::json& j, RewardConfig& r);
-void to_json(nlohmann::json& j, const BlockMetaData& b);
-void to_json(nlohmann::json& j, const QBBlockMetaData& b);
 
 }
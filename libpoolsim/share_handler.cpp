@@ -43,6 +43,8 @@ void to_json(nlohmann::json& j, const HopEvent& event) {
 }
 
 
+ShareHandler::ShareHandler(std::shared_ptr<Random> _random) : random(_random) {}
+
 ShareHandler::~ShareHandler() {}
 
 void ShareHandler::set_miner(std::shared_ptr<Miner> _miner) {
@@ -65,12 +67,53 @@ std::string ShareHandler::get_address() const {
     return get_miner()->get_address();
 }
 
+uint32_t ShareHandler::get_miner_id() const {
+    return get_miner()->get_id();
+}
+
+void ShareHandler::set_random(std::shared_ptr<Random> _random) {
+    random = _random;
+}
+
+void ShareHandler::set_metadata_enabled(bool enabled) {
+    metadata_enabled = enabled;
+}
+
+void ShareHandler::initialize() {}
+
+void ShareHandler::save(CheckpointWriter& writer) const {}
+
+void ShareHandler::load(CheckpointReader& reader) {}
+
+bool ShareHandler::can_change_pool() const {
+    return false;
+}
+
+void ShareHandler::handle_shares(uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        handle_share(Share(Share::Property::none));
+    }
+}
+
+bool ShareHandler::needs_individual_shares() const {
+    return true;
+}
+
 // NOTE: this particular class probably does not need for args
 // but it must accept them because of the current factory implementation
-DefaultShareHandler::DefaultShareHandler(const nlohmann::json& _args) {}
+DefaultShareHandler::DefaultShareHandler(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : BaseShareHandler(_random) {}
 
 void DefaultShareHandler::handle_share(const Share& share) {
-    get_pool()->submit_share(get_address(), share);
+    get_pool()->submit_share(get_miner_id(), share);
+}
+
+void DefaultShareHandler::handle_shares(uint64_t count) {
+    get_pool()->submit_shares(get_miner_id(), count);
+}
+
+bool DefaultShareHandler::needs_individual_shares() const {
+    return false;
 }
 
 std::string DefaultShareHandler::get_name() const {
@@ -79,11 +122,12 @@ std::string DefaultShareHandler::get_name() const {
 
 REGISTER(ShareHandler, DefaultShareHandler, "default")
 
-WithholdingShareHandler::WithholdingShareHandler(const nlohmann::json& _args) {}
+WithholdingShareHandler::WithholdingShareHandler(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : BaseShareHandler(_random) {}
 
 void WithholdingShareHandler::handle_share(const Share& share) {
     if (!share.is_valid_block())
-        get_pool()->submit_share(get_address(), share);
+        get_pool()->submit_share(get_miner_id(), share);
     
 }
 
@@ -93,6 +137,8 @@ std::string WithholdingShareHandler::get_name() const {
 
 REGISTER(ShareHandler, WithholdingShareHandler, "share_withholding")
 
+QBShareHandler::QBShareHandler(std::shared_ptr<Random> _random) : ShareHandler(_random) {}
+
 nlohmann::json QBShareHandler::get_json_metadata() {
     return nlohmann::json::object();
 }
@@ -109,28 +155,45 @@ uint64_t QBShareHandler::get_valid_shares_donated() const {
     return valid_shares_donated;
 }
 
-bool QBShareHandler::should_attack(std::vector<std::shared_ptr<QBRecord>>& records) {
-    return get_victim_address(records) != "";
+void QBShareHandler::save(CheckpointWriter& writer) const {
+    writer.write(shares_withheld);
+    writer.write(shares_donated);
+    writer.write(valid_shares_donated);
+}
+
+void QBShareHandler::load(CheckpointReader& reader) {
+    reader.read(shares_withheld);
+    reader.read(shares_donated);
+    reader.read(valid_shares_donated);
+}
+
+bool QBShareHandler::should_attack(const CreditRanking& ranking) {
+    return get_victim_id(ranking) != invalid_miner_id;
+}
+
+const CreditRanking& QBShareHandler::get_ranking() const {
+    return get_pool()->get_reward_scheme<QBRewardScheme>()->get_ranking();
 }
 
 bool QBShareHandler::is_pool_queue_based() const {
     return get_pool()->get_scheme_name() == "QB";
 }
 
-std::string QBShareHandler::get_victim_address(std::vector<std::shared_ptr<QBRecord>>& records) {
-    for (size_t i = 0; i + 1 < records.size() && i < top_n; i++) {
-        auto record = records[i];
-        if (record->get_miner_address() == get_address()) {
-            auto victim = records[i + 1];
-            if (record->get_credits() * threshold <= victim->get_credits()) {
-                return victim->get_miner_address();
-            } 
-        }
+uint32_t QBShareHandler::get_victim_id(const CreditRanking& ranking) {
+    uint32_t miner_id = get_miner_id();
+    if (ranking.rank_of(miner_id) >= top_n)
+        return invalid_miner_id;
+    // the miner ranked right after, if any
+    uint32_t victim_id = ranking.successor_of(miner_id);
+    if (victim_id != invalid_miner_id &&
+        ranking.get_credits(miner_id) * threshold <= ranking.get_credits(victim_id)) {
+        return victim_id;
     }
-    return "";
+    return invalid_miner_id;
 }
 
-QBWithholdingShareHandler::QBWithholdingShareHandler(const nlohmann::json& _args) {
+QBWithholdingShareHandler::QBWithholdingShareHandler(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : QBBaseShareHandler(_random) {
     BehaviourConfig config;
     from_json(_args, config);
     top_n = config.top_n;
@@ -139,15 +202,12 @@ QBWithholdingShareHandler::QBWithholdingShareHandler(const nlohmann::json& _args
 
 void QBWithholdingShareHandler::handle_share(const Share& share) {
     if (!is_pool_queue_based()) {
-        get_pool()->submit_share(get_address(), share);
+        get_pool()->submit_share(get_miner_id(), share);
         return;   
     }
     
-    auto records = get_pool()->get_records<QBRewardScheme>();
-    std::sort(records.begin(), records.end(), QBSortObj());
-    
-    if (!should_attack(records)) {
-        get_pool()->submit_share(get_address(), share);
+    if (!should_attack(get_ranking())) {
+        get_pool()->submit_share(get_miner_id(), share);
         return;
     }
 
@@ -160,10 +220,21 @@ std::string QBWithholdingShareHandler::get_name() const {
     return "qb_share_withholding";
 }
 
+void QBWithholdingShareHandler::save(CheckpointWriter& writer) const {
+    QBShareHandler::save(writer);
+    writer.write(valid_shares_withheld);
+}
+
+void QBWithholdingShareHandler::load(CheckpointReader& reader) {
+    QBShareHandler::load(reader);
+    reader.read(valid_shares_withheld);
+}
+
 REGISTER(ShareHandler, QBWithholdingShareHandler, "qb_share_withholding")
 
 
-DonationShareHandler::DonationShareHandler(const nlohmann::json& _args) {
+DonationShareHandler::DonationShareHandler(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : QBBaseShareHandler(_random) {
     BehaviourConfig config;
     from_json(_args, config);
     top_n = config.top_n;
@@ -172,16 +243,13 @@ DonationShareHandler::DonationShareHandler(const nlohmann::json& _args) {
 
 void DonationShareHandler::handle_share(const Share& share) {
     if (!is_pool_queue_based()) {
-        get_pool()->submit_share(get_address(), share);
+        get_pool()->submit_share(get_miner_id(), share);
         return;   
     }
     
-    auto records = get_pool()->get_records<QBRewardScheme>();
-    std::sort(records.begin(), records.end(), QBSortObj());
-    
-    std::string victim_address = get_victim_address(records);
-    if (victim_address == "") {
-        get_pool()->submit_share(get_address(), share);
+    uint32_t victim_id = get_victim_id(get_ranking());
+    if (victim_id == invalid_miner_id) {
+        get_pool()->submit_share(get_miner_id(), share);
         return;
     }
 
@@ -189,7 +257,7 @@ void DonationShareHandler::handle_share(const Share& share) {
     if (share.is_valid_block())
         valid_shares_donated++;
 
-    get_pool()->submit_share(victim_address, share);
+    get_pool()->submit_share(victim_id, share);
 }
 
 std::string DonationShareHandler::get_name() const {
@@ -198,16 +266,20 @@ std::string DonationShareHandler::get_name() const {
 
 REGISTER(ShareHandler, DonationShareHandler, "share_donation")
 
-MultipleAddressesShareHandler::MultipleAddressesShareHandler(const nlohmann::json& _args) {
+MultipleAddressesShareHandler::MultipleAddressesShareHandler(const nlohmann::json& _args,
+                                                             std::shared_ptr<Random> _random)
+    : QBBaseShareHandler(_random) {
     MultiAddressConfig config;
     from_json(_args, config);
     top_n = config.top_n;
     threshold = config.threshold;
-    uint64_t addresses_count = config.addresses;
+    addresses_count = config.addresses;
     if (addresses_count == 0) {
         throw std::invalid_argument("'addresses' must be set when using multiple_addresses");
     }
+}
 
+void MultipleAddressesShareHandler::initialize() {
     for (size_t count = 0; count < addresses_count; count++) {
         std::string new_address = random->get_address();
         addresses.push_back(new_address);
@@ -215,24 +287,26 @@ MultipleAddressesShareHandler::MultipleAddressesShareHandler(const nlohmann::jso
 }
 
 uint64_t MultipleAddressesShareHandler::get_addresses_count() const {
-    return addresses.size();
+    return addresses_count;
 }
 
-std::string MultipleAddressesShareHandler::get_random_address() const {
-    return random->random_element(addresses.begin(), addresses.end());
+uint32_t MultipleAddressesShareHandler::get_random_address_id() {
+    if (address_ids.empty()) {
+        for (const std::string& address : addresses) {
+            address_ids.push_back(get_network()->get_miner_id(address));
+        }
+    }
+    return random->random_element(address_ids.begin(), address_ids.end());
 }
 
 void MultipleAddressesShareHandler::handle_share(const Share& share) {
     if (!is_pool_queue_based()) {
-        get_pool()->submit_share(get_address(), share);
+        get_pool()->submit_share(get_miner_id(), share);
         return;   
     }
     
-    auto records = get_pool()->get_records<QBRewardScheme>();
-    std::sort(records.begin(), records.end(), QBSortObj());
-    
-    if (!should_attack(records)) {
-        get_pool()->submit_share(get_address(), share);
+    if (!should_attack(get_ranking())) {
+        get_pool()->submit_share(get_miner_id(), share);
         return;
     }
 
@@ -241,10 +315,10 @@ void MultipleAddressesShareHandler::handle_share(const Share& share) {
         valid_shares_donated++;
 
 
-    std::string other_address = get_random_address();
+    uint32_t other_address_id = get_random_address_id();
     // NOTE: join will be a no-op if the other address is already in the pool
-    get_pool()->join(other_address);
-    get_pool()->submit_share(other_address, share);
+    get_pool()->join(other_address_id);
+    get_pool()->submit_share(other_address_id, share);
 }
 
 std::string MultipleAddressesShareHandler::get_name() const {
@@ -253,26 +327,49 @@ std::string MultipleAddressesShareHandler::get_name() const {
 
 REGISTER(ShareHandler, MultipleAddressesShareHandler, "multiple_addresses");
 
+QBPoolHopping::QBPoolHopping(std::shared_ptr<Random> _random) : QBShareHandler(_random) {}
+
 nlohmann::json QBPoolHopping::get_json_metadata() {
     nlohmann::json j;
     j["hop_events"] = hop_events;
     return j;
 }
 
+void QBPoolHopping::save(CheckpointWriter& writer) const {
+    QBShareHandler::save(writer);
+    writer.write((uint64_t) hop_events.size());
+    for (const HopEvent& event : hop_events) {
+        writer.write(event.previous_pool);
+        writer.write(event.next_pool);
+        writer.write(event.time);
+    }
+}
+
+void QBPoolHopping::load(CheckpointReader& reader) {
+    QBShareHandler::load(reader);
+    hop_events.resize(reader.read<uint64_t>());
+    for (HopEvent& event : hop_events) {
+        reader.read(event.previous_pool);
+        reader.read(event.next_pool);
+        reader.read(event.time);
+    }
+}
+
+bool QBPoolHopping::can_change_pool() const {
+    return true;
+}
+
 void QBPoolHopping::handle_share(const Share& share) {
     if (!is_pool_queue_based()) {
-        get_pool()->submit_share(get_address(), share);
+        get_pool()->submit_share(get_miner_id(), share);
         return;
     }
 
     auto current_pool = get_pool();
 
-    auto records = current_pool->get_records<QBRewardScheme>();
-    std::sort(records.begin(), records.end(), QBSortObj());
-
     /*
-    if (!should_attack(records)) {
-        get_miner()->get_pool()->submit_share(get_miner()->get_address(), share);
+    if (!should_attack(get_ranking())) {
+        get_miner()->get_pool()->submit_share(get_miner()->get_id(), share);
         return;
     }
     */
@@ -283,21 +380,24 @@ void QBPoolHopping::handle_share(const Share& share) {
         auto pool_to_hop = get_hop_target();
         if (pool_to_hop != current_pool) {
             get_miner()->join_pool(pool_to_hop);
-            HopEvent event {
-                .previous_pool = current_pool->get_name(),
-                .next_pool = pool_to_hop->get_name(),
-                .time = get_network()->get_current_time()
-            };
-            hop_events.push_back(event);
+            if (metadata_enabled) {
+                HopEvent event {
+                    .previous_pool = current_pool->get_name(),
+                    .next_pool = pool_to_hop->get_name(),
+                    .time = get_network()->get_current_time()
+                };
+                hop_events.push_back(event);
+            }
        }
     }
 
-    get_pool()->submit_share(get_address(), share);
+    get_pool()->submit_share(get_miner_id(), share);
 }
 
 
 
-QBLuckPoolHopping::QBLuckPoolHopping(const nlohmann::json& _args) {
+QBLuckPoolHopping::QBLuckPoolHopping(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : QBBasePoolHopping(_random) {
     QBLuckHoppingConfig config;
     from_json(_args, config);
     top_n = config.top_n;
@@ -307,10 +407,9 @@ QBLuckPoolHopping::QBLuckPoolHopping(const nlohmann::json& _args) {
 
 
 std::shared_ptr<MiningPool> QBLuckPoolHopping::get_hop_target() {
-    std::vector<std::shared_ptr<MiningPool>> pools = get_network()->get_pools();
     double pool_luck = get_pool()->get_luck();
     std::shared_ptr<MiningPool> luckiest_pool = get_pool();
-    for (auto pool : pools) {
+    for (auto& pool : get_network()->get_pools()) {
         if (pool->get_luck() > pool_luck && pool != luckiest_pool) {
             pool_luck = pool->get_luck();
             luckiest_pool = pool;
@@ -330,7 +429,8 @@ std::string QBLuckPoolHopping::get_name() const {
 REGISTER(ShareHandler, QBLuckPoolHopping, "qb_luck_pool_hopping");
 
 
-QBLossPoolHopping::QBLossPoolHopping(const nlohmann::json& _args) {
+QBLossPoolHopping::QBLossPoolHopping(const nlohmann::json& _args, std::shared_ptr<Random> _random)
+    : QBBasePoolHopping(_random) {
     BehaviourConfig config;
     from_json(_args, config);
     top_n = config.top_n;
@@ -338,10 +438,9 @@ QBLossPoolHopping::QBLossPoolHopping(const nlohmann::json& _args) {
 }
 
 std::shared_ptr<MiningPool> QBLossPoolHopping::get_hop_target() {
-    std::vector<std::shared_ptr<MiningPool>> pools = get_network()->get_pools();
     auto max_loss = get_pool()->get_block_metadata<QBRewardScheme>().average_credits_lost;
     auto best_pool = get_pool();
-    for (auto pool : pools) {
+    for (auto& pool : get_network()->get_pools()) {
         auto pool_loss = pool->get_block_metadata<QBRewardScheme>().average_credits_lost;
         if (pool_loss > max_loss && pool != best_pool) {
             max_loss = pool_loss;
@@ -26,6 +26,7 @@ struct QBLuckHoppingConfig : BehaviourConfig {
 
 class ShareHandler {
 public:
+    explicit ShareHandler(std::shared_ptr<Random> random);
     virtual ~ShareHandler();
 
     // Miners delegates to this method to handle the share that it found
@@ -37,6 +38,17 @@ public:
     // Returns the metadata of the share handler (if any)
     virtual nlohmann::json get_json_metadata() = 0;
 
+    // Returns whether handling a share may make the miner join another pool
+    virtual bool can_change_pool() const;
+
+    // Handles `count` shares that are not valid blocks
+    // Defaults to handling them one by one
+    virtual void handle_shares(uint64_t count);
+
+    // Returns whether the handler needs to see each share that is not a valid block,
+    // rather than only their number
+    virtual bool needs_individual_shares() const;
+
     // Set the miner for this share handler
     // ShareHandler and Miner must be a 1 to 1 relationship
     void set_miner(std::shared_ptr<Miner> miner);
@@ -53,17 +65,43 @@ public:
 
     // Returns the address
     std::string get_address() const;
+
+    // Returns the id of the miner
+    uint32_t get_miner_id() const;
+
+    // Replaces the random instance used by the handler,
+    // e.g. with the stream of the miner once it is known
+    void set_random(std::shared_ptr<Random> random);
+
+    // Sets whether the handler records the events returned in its metadata,
+    // which is the default, disabled when the metadata is not written
+    void set_metadata_enabled(bool enabled);
+
+    // Called by the miner creators once the handler has been created,
+    // for handlers which need to draw part of their state
+    virtual void initialize();
+
+    // Writes the state of the handler to a checkpoint
+    // State created by initialize() is not written, as it is created again on resume
+    virtual void save(CheckpointWriter& writer) const;
+
+    // Restores the state written by save()
+    virtual void load(CheckpointReader& reader);
 protected:
     std::weak_ptr<Miner> miner;
 
+    // whether the events of the metadata are recorded
+    bool metadata_enabled = true;
+
     // random instance
-    std::shared_ptr<Random> random = SystemRandom::get_instance();
+    std::shared_ptr<Random> random;
 };
 
-MAKE_FACTORY(ShareHandlerFactory, ShareHandler, const nlohmann::json&)
+MAKE_FACTORY(ShareHandlerFactory, ShareHandler, const nlohmann::json&, std::shared_ptr<Random>)
 
 class QBShareHandler : public ShareHandler {
 public:
+    explicit QBShareHandler(std::shared_ptr<Random> random);
     virtual void handle_share(const Share& share) = 0;
 
     nlohmann::json get_json_metadata() override;
@@ -73,15 +111,20 @@ public:
     uint64_t get_shares_withheld() const;
 
     uint64_t get_valid_shares_donated() const;
-    
+
+    void save(CheckpointWriter& writer) const override;
+    void load(CheckpointReader& reader) override;
+
 protected:
     // Checks if the current mining pool uses a queue based reward scheme
     bool is_pool_queue_based() const;
     // Checks the specified condition logic under which a share should
     // be submitted
-    bool should_attack(std::vector<std::shared_ptr<QBRecord>>& records);
-    // returns the address of the attack victim
-    std::string get_victim_address(std::vector<std::shared_ptr<QBRecord>>& records);
+    bool should_attack(const CreditRanking& ranking);
+    // returns the id of the attack victim or invalid_miner_id if there is none
+    uint32_t get_victim_id(const CreditRanking& ranking);
+    // returns the credit ranking of the current pool
+    const CreditRanking& get_ranking() const;
     // used to check if miner is in top N of the pool
     uint64_t top_n = 0;
     // used to check if credits of another miner are within a specified range
@@ -97,8 +140,9 @@ protected:
 template <typename T>
 class BaseShareHandler :
     public ShareHandler,
-    public Creatable1<ShareHandler, T, const nlohmann::json&> {   
+    public Creatable2<ShareHandler, T, const nlohmann::json&, std::shared_ptr<Random>> {   
 public:
+    explicit BaseShareHandler(std::shared_ptr<Random> random) : ShareHandler(random) {}
     nlohmann::json get_json_metadata() override;
 };
 
@@ -111,16 +155,22 @@ nlohmann::json BaseShareHandler<T>::get_json_metadata() {
 template <typename T>
 class QBBaseShareHandler :
     public QBShareHandler,
-    public Creatable1<ShareHandler, T, const nlohmann::json&> {
+    public Creatable2<ShareHandler, T, const nlohmann::json&, std::shared_ptr<Random>> {
+public:
+    explicit QBBaseShareHandler(std::shared_ptr<Random> random) : QBShareHandler(random) {}
 };
   
 // Default implementation for ShareHandler
 class DefaultShareHandler: public BaseShareHandler<DefaultShareHandler> {
 public:
-    explicit DefaultShareHandler(const nlohmann::json& args);
+    DefaultShareHandler(const nlohmann::json& args, std::shared_ptr<Random> random);
     // Simply submits the share to the mining pool
     virtual void handle_share(const Share& share) override;
 
+    // Submits all the shares to the mining pool at once
+    void handle_shares(uint64_t count) override;
+    bool needs_individual_shares() const override;
+
     std::string get_name() const override;
 };
 
@@ -130,7 +180,7 @@ public:
 // Else, the share is submitted as specified by the default behaviour. 
 class WithholdingShareHandler : public BaseShareHandler<WithholdingShareHandler> {
 public:
-    explicit WithholdingShareHandler(const nlohmann::json& args);
+    WithholdingShareHandler(const nlohmann::json& args, std::shared_ptr<Random> random);
     // Withholds valid shares (including uncles) from submitting to pool operator
     void handle_share(const Share& share) override;
 
@@ -145,11 +195,14 @@ public:
 class QBWithholdingShareHandler : public QBBaseShareHandler<QBWithholdingShareHandler> {
 //class QBWithholdingShareHandler : public BaseShareHandler<QBWithholdingShareHandler, QBRewardScheme> {
 public:
-    explicit QBWithholdingShareHandler(const nlohmann::json& args);
+    QBWithholdingShareHandler(const nlohmann::json& args, std::shared_ptr<Random> random);
     // Withholds valid shares (including uncles) from submitting to pool operator
     void handle_share(const Share& share) override;
 
     std::string get_name() const override;
+
+    void save(CheckpointWriter& writer) const override;
+    void load(CheckpointReader& reader) override;
 private:
     // counts the total number of valid shares withheld
     uint64_t valid_shares_withheld = 0;
@@ -162,7 +215,7 @@ private:
 // Else, the share is submitted as specified by the default behaviour.
 class DonationShareHandler : public QBBaseShareHandler<DonationShareHandler> {
 public:
-    explicit DonationShareHandler(const nlohmann::json& args);
+    DonationShareHandler(const nlohmann::json& args, std::shared_ptr<Random> random);
     // Donates the share to a specified address if a defined condition is true
     void handle_share(const Share& share) override;
 
@@ -176,7 +229,9 @@ public:
 // Else, the share is submitted as specified by the default behaviour.
 class MultipleAddressesShareHandler : public QBBaseShareHandler<MultipleAddressesShareHandler> {
 public:
-    explicit MultipleAddressesShareHandler(const nlohmann::json& args);
+    MultipleAddressesShareHandler(const nlohmann::json& args, std::shared_ptr<Random> random);
+    // Generates the addresses of the miner
+    void initialize() override;
     // Donates the share to any of the other addresses belonging to
     // the miner in a pool
     void handle_share(const Share& share) override;
@@ -185,17 +240,21 @@ public:
 
     std::string get_name() const override;
 private:
+    // number of addresses to generate
+    uint64_t addresses_count;
     // list of all addresses in pool controlled by miner
     std::vector<std::string> addresses;
-    // returns an address owned by the miner at random from the list of addresses
-    std::string get_random_address() const;
+    // ids of the addresses, resolved the first time they are needed
+    std::vector<uint32_t> address_ids;
+    // returns the id of an address owned by the miner at random from the list of addresses
+    uint32_t get_random_address_id();
 };
 
 
 struct HopEvent {
     std::string previous_pool;
     std::string next_pool;
-    uint64_t time;
+    double time;
 };
 
 // IMPLEMENTED: YES
@@ -204,9 +263,15 @@ struct HopEvent {
 // that is luckiest. 
 class QBPoolHopping : public QBShareHandler {
 public:
+    explicit QBPoolHopping(std::shared_ptr<Random> random);
     void handle_share(const Share& share) override;
 
+    bool can_change_pool() const override;
+
     nlohmann::json get_json_metadata() override;
+
+    void save(CheckpointWriter& writer) const override;
+    void load(CheckpointReader& reader) override;
 protected:
     virtual std::shared_ptr<MiningPool> get_hop_target() = 0;
     virtual bool should_hop() = 0;
@@ -218,14 +283,15 @@ private:
 
 template <typename T>
 class QBBasePoolHopping : public QBPoolHopping,
-                          public Creatable1<ShareHandler, T, const nlohmann::json&> {
-
+                          public Creatable2<ShareHandler, T, const nlohmann::json&, std::shared_ptr<Random>> {
+public:
+    explicit QBBasePoolHopping(std::shared_ptr<Random> random) : QBPoolHopping(random) {}
 };
 
 
 class QBLuckPoolHopping : public QBBasePoolHopping<QBLuckPoolHopping> {
 public:
-    explicit QBLuckPoolHopping(const nlohmann::json& args);
+    QBLuckPoolHopping(const nlohmann::json& args, std::shared_ptr<Random> random);
     std::string get_name() const override;
 
 protected:
@@ -239,7 +305,7 @@ private:
 
 class QBLossPoolHopping : public QBBasePoolHopping<QBLossPoolHopping> {
 public:
-    explicit QBLossPoolHopping(const nlohmann::json& args);
+    QBLossPoolHopping(const nlohmann::json& args, std::shared_ptr<Random> random);
     std::string get_name() const override;
 
 protected:
@@ -2,8 +2,10 @@
 
 #include <fstream>
 #include <sstream>
+#include <stdexcept>
 
 #include "simulation.h"
+#include "summary.h"
 
 namespace poolsim {
 
@@ -33,13 +35,152 @@ void from_json(const json& j, PoolConfig& pool_config) {
 }
 
 void from_json(const json& j, Simulation& simulation) {
-    j.at("output").get_to(simulation.output);
+    // either the path of the output, or an object with the path and what to write
+    if (j.at("output").is_object()) {
+        j["output"].at("path").get_to(simulation.output);
+        j["output"].get_to(simulation.output_config);
+    } else {
+        j.at("output").get_to(simulation.output);
+    }
+    if (j.find("compression") != j.end()) {
+        j.at("compression").get_to(simulation.compression);
+    }
+    if (j.find("blocks_output") != j.end()) {
+        j.at("blocks_output").get_to(simulation.blocks_output);
+    }
+    if (j.find("store") != j.end()) {
+        j.at("store").get_to(simulation.store);
+    }
     j.at("blocks").get_to(simulation.blocks);
     j.at("network_difficulty").get_to(simulation.network_difficulty);
     j.at("pools").get_to(simulation.pools);
     if (j.find("seed") != j.end()) {
         j.at("seed").get_to(simulation.seed);
     }
+    if (j.find("rng") != j.end()) {
+        j.at("rng").get_to(simulation.rng);
+    }
+    if (j.find("event_queue") != j.end()) {
+        j.at("event_queue").get_to(simulation.event_queue);
+    }
+    if (j.find("engine") != j.end()) {
+        j.at("engine").get_to(simulation.engine);
+    }
+    if (j.find("checkpoint") != j.end()) {
+        j.at("checkpoint").at("path").get_to(simulation.checkpoint_path);
+        if (j["checkpoint"].find("every") != j["checkpoint"].end()) {
+            j["checkpoint"].at("every").get_to(simulation.checkpoint_every);
+        }
+    }
+    if (j.find("sweep") != j.end()) {
+        j.at("sweep").at("axes").get_to(simulation.sweep);
+    }
+    simulation.config = j;
+}
+
+// sections of the result, and the fields of their items
+static const std::map<std::string, std::set<std::string>> output_fields = {
+    {"blocks", {"is_uncle", "miner_address", "pool_name", "reward_scheme_data", "time"}},
+    {"pools", {"difficulty", "miners", "name", "reward_scheme"}},
+    {"records", {"blocks_mined", "blocks_received", "miner_address", "share_count",
+                 "uncles_mined", "uncles_received"}},
+    {"miners", {"address", "behavior", "blocks_found", "handler_metadata", "hashrate", "total_work"}}
+};
+
+// reads a list of names, each of which must be in `valid`
+static Selection get_selection(const json& j, const std::set<std::string>& valid, const std::string& kind) {
+    std::set<std::string> names;
+    for (const json& name : j) {
+        if (valid.find(name.get<std::string>()) == valid.end()) {
+            throw std::invalid_argument("unknown output " + kind + " " + name.get<std::string>());
+        }
+        names.insert(name.get<std::string>());
+    }
+    return Selection(names);
+}
+
+void from_json(const json& j, OutputConfig& output_config) {
+    if (j.find("sections") != j.end()) {
+        output_config.sections = get_selection(j["sections"], {"blocks", "pools", "miners"}, "section");
+    }
+    if (j.find("fields") != j.end()) {
+        for (auto it = j["fields"].begin(); it != j["fields"].end(); ++it) {
+            auto valid = output_fields.find(it.key());
+            if (valid == output_fields.end()) {
+                throw std::invalid_argument("unknown output fields " + it.key());
+            }
+            output_config.fields[it.key()] = get_selection(it.value(), valid->second, it.key() + " field");
+        }
+    }
+    if (j.find("miners") != j.end()) {
+        if (j["miners"].find("addresses") != j["miners"].end()) {
+            j["miners"].at("addresses").get_to(output_config.tracked_miners);
+        }
+        if (j["miners"].find("top_hashrate") != j["miners"].end()) {
+            j["miners"].at("top_hashrate").get_to(output_config.top_hashrate);
+        }
+    }
+    // either whether a summary is written, or its path
+    if (j.find("summary") != j.end()) {
+        if (j["summary"].is_string()) {
+            j["summary"].get_to(output_config.summary_path);
+        } else {
+            j["summary"].get_to(output_config.summary);
+        }
+    }
+    if (j.find("index") != j.end()) {
+        j.at("index").get_to(output_config.index);
+    }
+    if (j.find("blocks_every") != j.end()) {
+        j.at("blocks_every").get_to(output_config.blocks_every);
+        if (output_config.blocks_every == 0) {
+            throw std::invalid_argument("output blocks_every must be positive");
+        }
+    }
+}
+
+Selection OutputConfig::get_fields(const std::string& items) const {
+    auto it = fields.find(items);
+    return it != fields.end() ? it->second : Selection();
+}
+
+bool OutputConfig::tracks_miners() const {
+    return !tracked_miners.empty() || top_hashrate > 0;
+}
+
+std::string OutputConfig::get_summary_output(const std::string& output) const {
+    if (!summary) {
+        return "";
+    }
+    return summary_path.empty() ? get_summary_path(output) : summary_path;
+}
+
+void from_json(const json& j, SweepAxis& sweep_axis) {
+    j.at("path").get_to(sweep_axis.path);
+    if (j.find("values") != j.end()) {
+        j.at("values").get_to(sweep_axis.values);
+    } else if (j.find("grid") != j.end()) {
+        double start = j["grid"].at("start");
+        double stop = j["grid"].at("stop");
+        double step = j["grid"].at("step");
+        if (step <= 0) {
+            throw std::invalid_argument("sweep grid step must be positive");
+        }
+        // integer grids, e.g. of difficulties, keep integer values
+        bool integers = j["grid"]["start"].is_number_integer() && j["grid"]["step"].is_number_integer();
+        // computed from the index to avoid accumulating rounding errors
+        for (size_t i = 0; start + i * step <= stop + step * 1e-9; i++) {
+            if (integers) {
+                sweep_axis.values.push_back(j["grid"]["start"].get<int64_t>() +
+                                            (int64_t) i * j["grid"]["step"].get<int64_t>());
+            } else {
+                sweep_axis.values.push_back(start + i * step);
+            }
+        }
+    }
+    if (sweep_axis.values.empty()) {
+        throw std::invalid_argument("sweep axis " + sweep_axis.path + " has no values");
+    }
 }
 
 
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <iostream>
+#include <map>
+#include <set>
 #include <string>
 
 #include <nlohmann/json.hpp>
 
+#include "codec.h"
+#include "json_writer.h"
+
 namespace poolsim {
 
 class InvalidSimulationException : public std::exception {
@@ -42,6 +47,54 @@ struct PoolConfig {
     std::vector<MinerConfig> miners_config;
 };
 
+// Axis of a parameter sweep
+struct SweepAxis {
+    // JSON pointer to the swept value in the config, e.g. /pools/0/difficulty
+    std::string path;
+
+    // Values taken along the axis, either listed in `values` or generated
+    // from a `grid` with `start`, `stop` (included) and `step`
+    std::vector<nlohmann::json> values;
+};
+
+// Parts of the result written to the output
+struct OutputConfig {
+    // Sections of the result: "blocks", "pools" and "miners"
+    Selection sections;
+
+    // Fields of the "blocks", "pools", "records" (the miners of the pools)
+    // and "miners", all of them for the items not listed
+    std::map<std::string, Selection> fields;
+
+    // Addresses of the miners written in the records and the miners
+    std::set<std::string> tracked_miners;
+
+    // Number of miners with the highest hashrate to write, in addition to the tracked ones
+    // All the miners are written when none is tracked
+    size_t top_hashrate = 0;
+
+    // Only one block out of `blocks_every` is written
+    uint64_t blocks_every = 1;
+
+    // Whether a summary is written with the output
+    bool summary = true;
+
+    // Path of the summary, next to the output when empty (see get_summary_path)
+    std::string summary_path;
+
+    // Whether an index of the json output is written next to it (see result_index.h)
+    bool index = true;
+
+    // Returns the selected fields of the items
+    Selection get_fields(const std::string& items) const;
+
+    // Returns whether only some of the miners are written
+    bool tracks_miners() const;
+
+    // Returns the path of the summary of the given output, or an empty string if disabled
+    std::string get_summary_output(const std::string& output) const;
+};
+
 struct Simulation {
     // Creates a Simulation from a config file
     static Simulation from_config_file(const std::string& filepath);
@@ -53,6 +106,19 @@ struct Simulation {
     // The output file for the simulation
     std::string output;
 
+    // What is written to the output, set when the output is given as an object
+    OutputConfig output_config;
+
+    // How the output is compressed
+    CompressionConfig compression;
+
+    // File the blocks are streamed to as newline-delimited JSON while the simulation runs
+    // When empty, the blocks are kept in memory and written with the rest of the result
+    std::string blocks_output;
+
+    // Database the summary of each run is appended to (see ResultStore), none if empty
+    std::string store;
+
     // The number of blocks to reach before ending the simulation
     uint64_t blocks;
 
@@ -64,11 +130,38 @@ struct Simulation {
 
     // Random seed to use for the simulation
     long seed = 0;
+
+    // Name of the random number generator (see RandomFactory)
+    std::string rng = "drand48";
+
+    // Name of the event queue implementation (see EventQueueFactory)
+    std::string event_queue = "binary_heap";
+
+    // How shares are generated, either "per_miner" (one pending event per miner),
+    // "aggregated" (one share at a time at the rate of the whole network) or
+    // "fast_forward" (whole rounds at once for the pools whose reward scheme only
+    // depends on share counts, the other pools falling back to the event queue)
+    std::string engine = "per_miner";
+
+    // File the state of the simulation is checkpointed to, none if empty
+    std::string checkpoint_path;
+
+    // Number of blocks between two checkpoints
+    // With 0, a checkpoint is only written when the simulation is stopped with SIGTERM
+    uint64_t checkpoint_every = 0;
+
+    // Axes of the parameter sweep, every combination of their values is simulated
+    std::vector<SweepAxis> sweep;
+
+    // Config the simulation was created from, with the sweep applied to it
+    nlohmann::json config;
 };
 
 void from_json(const nlohmann::json& j, Simulation& simulation);
+void from_json(const nlohmann::json& j, OutputConfig& output_config);
 void from_json(const nlohmann::json& j, PoolConfig& pool_config);
 void from_json(const nlohmann::json& j, MinerConfig& miner_config);
 void from_json(const nlohmann::json& j, RewardSchemeConfig& reward_scheme_config);
+void from_json(const nlohmann::json& j, SweepAxis& sweep_axis);
 
 }
@@ -4,14 +4,12 @@
 #include <iomanip>
 #include <cassert>
 #include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <algorithm>
+#include <map>
 
 
-#ifdef USE_BOOST_IOSTREAMS
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/copy.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
-#endif
-
 #include <spdlog/spdlog.h>
 
 #include "simulator.h"
@@ -20,29 +18,51 @@
 #include "miner.h"
 #include "event.h"
 #include "miner_creator.h"
+#include "checkpoint.h"
+#include "columnar.h"
+#include "codec.h"
+#include "json_writer.h"
 
 namespace poolsim {
 
 using nlohmann::json;
 
+static std::string save_random_state(const Random& random) {
+    std::ostringstream stream;
+    CheckpointWriter writer(stream);
+    random.save(writer);
+    return stream.str();
+}
 
-Simulator::Simulator(Simulation _simulation)
-    : Simulator(_simulation, SystemRandom::get_instance()) {}
+static void load_random_state(Random& random, const std::string& state) {
+    std::istringstream stream(state);
+    CheckpointReader reader(stream);
+    random.load(reader);
+}
 
 Simulator::Simulator(Simulation _simulation, std::shared_ptr<Random> _random)
     : simulation(_simulation), network(std::make_shared<Network>(_simulation.network_difficulty)),
-      random(_random) {}
+      random(_random), uniforms(_random), queue(EventQueueFactory::create(_simulation.event_queue)) {}
 
 std::shared_ptr<Simulator> Simulator::from_config_file(const std::string& filepath) {
-    auto simulation = Simulation::from_config_file(filepath);
-    SystemRandom::initialize(simulation.seed);
-    spdlog::debug("initialized random with seed {}", simulation.seed);
+    return from_simulation(Simulation::from_config_file(filepath));
+}
+
+std::shared_ptr<Simulator> Simulator::from_simulation(const Simulation& simulation) {
+    std::shared_ptr<Random> random = RandomFactory::create(simulation.rng, simulation.seed);
+    spdlog::debug("initialized {} random with seed {}", simulation.rng, simulation.seed);
 
-    return  std::shared_ptr<Simulator>(new Simulator(simulation));
+    return  std::shared_ptr<Simulator>(new Simulator(simulation, random));
 }
 
 
 void Simulator::initialize() {
+    const OutputConfig& output_config = simulation.output_config;
+    if (!output_config.sections.has("blocks") && !simulation.blocks_output.empty()) {
+        throw std::invalid_argument("the blocks output needs the blocks section of the output");
+    }
+
+    size_t population_index = 0;
     for (size_t i = 0; i < simulation.pools.size(); i++) {
         auto pool_config = simulation.pools[i];
 
@@ -58,11 +78,30 @@ void Simulator::initialize() {
             pool_name = s.str();
         }
 
+        // With independent streams, each pool and each miner draws from its own
+        // stream, so that results do not depend on the order of the draws
+        auto creator_random = population_random ? population_random : random;
+        auto pool_random = random;
+        if (creator_random->has_streams()) {
+            creator_random = creator_random->get_stream(i, Random::population_stream);
+        }
+        if (random->has_streams()) {
+            pool_random = random->get_stream(i, Random::pool_stream);
+        }
+
         // Create all the miners in the configuration
         std::vector<std::shared_ptr<Miner>> pool_miners;
         for (const MinerConfig& miner_config : pool_config.miners_config) {
-            auto miner_creator = MinerCreatorFactory::create(miner_config.generator, network);
-            auto new_miners = miner_creator->create_miners(miner_config.params);
+            auto miner_creator = MinerCreatorFactory::create(miner_config.generator, network, creator_random);
+            std::vector<std::shared_ptr<Miner>> new_miners;
+            if (population) {
+                // the share handlers draw from where the specs left the random
+                load_random_state(*creator_random, population->random_states[population_index]);
+                new_miners = miner_creator->create_miners(population->specs[population_index]);
+                population_index++;
+            } else {
+                new_miners = miner_creator->create_miners(miner_config.params);
+            }
             pool_miners.insert(pool_miners.end(), new_miners.begin(), new_miners.end());
         }
 
@@ -76,103 +115,1052 @@ void Simulator::initialize() {
                                        pool_config.difficulty,
                                        pool_config.uncle_block_prob,
                                        std::move(reward_scheme),
-                                       network);
+                                       network,
+                                       pool_random);
         network->register_pool(pool);
-        pool->add_observer(shared_from_this());
+        if (blocks_enabled && output_config.sections.has("blocks")) {
+            pool->add_observer(shared_from_this());
+        }
         add_pool(pool);
 
         // Add all miners to pool and simulator
         for (auto miner : pool_miners) {
+            auto miner_random = random;
+            if (random->has_streams()) {
+                miner_random = random->get_stream(i, miner->get_id());
+                if (miner->get_id() >= miner_randoms.size()) {
+                    miner_randoms.resize(miner->get_id() + 1);
+                }
+                miner_randoms[miner->get_id()] = miner_random;
+            }
+            miner->set_random(miner_random);
             miner->join_pool(pool);
             add_miner(miner);
         }
     }
+
+    sort_miners();
+    select_output_miners();
 }
 
-void Simulator::run() {
-    initialize();
+void Simulator::sort_miners() {
+    if (miners_sorted) {
+        return;
+    }
+    std::sort(miner_ids_by_address.begin(), miner_ids_by_address.end(), [this](uint32_t left, uint32_t right) {
+        return miners[left]->get_address() < miners[right]->get_address();
+    });
+    miners_sorted = true;
+}
 
-    spdlog::debug("loaded {} pools with a total of {} miners", pools.size(), miners.size());
+void Simulator::select_output_miners() {
+    const OutputConfig& output_config = simulation.output_config;
+    if (output_config.tracks_miners()) {
+        std::set<std::string> addresses = output_config.tracked_miners;
+        std::vector<std::shared_ptr<Miner>> by_hashrate;
+        for (auto& miner : miners) {
+            if (miner) {
+                by_hashrate.push_back(miner);
+            }
+        }
+        size_t top = std::min(output_config.top_hashrate, by_hashrate.size());
+        std::partial_sort(by_hashrate.begin(), by_hashrate.begin() + top, by_hashrate.end(),
+                          [](const std::shared_ptr<Miner>& left, const std::shared_ptr<Miner>& right) {
+            return left->get_hashrate() > right->get_hashrate() ||
+                (left->get_hashrate() == right->get_hashrate() && left->get_id() < right->get_id());
+        });
+        for (size_t i = 0; i < top; i++) {
+            addresses.insert(by_hashrate[i]->get_address());
+        }
+        tracked_miners = Selection(addresses);
+    }
 
-    if (pools.empty() || miners.empty()) {
-        throw InvalidSimulationException("simulation must have at least one miner and one pool");
+    // e.g. hop events are only recorded for the miners whose metadata is written
+    bool metadata = output_config.sections.has("miners") &&
+        output_config.get_fields("miners").has("handler_metadata");
+    for (auto& miner : miners) {
+        if (miner) {
+            miner->set_metadata_enabled(metadata && tracked_miners.has(miner->get_address()));
+        }
+    }
+}
+
+void Simulator::set_population_random(std::shared_ptr<Random> _random) {
+    population_random = _random;
+}
+
+void Simulator::set_population(std::shared_ptr<const MinerPopulation> _population) {
+    population = _population;
+}
+
+MinerPopulation Simulator::create_population(const Simulation& simulation) {
+    MinerPopulation population;
+    std::shared_ptr<Random> random = RandomFactory::create(simulation.rng, simulation.seed);
+    auto network = std::make_shared<Network>(0);
+    for (size_t i = 0; i < simulation.pools.size(); i++) {
+        auto creator_random = random;
+        if (random->has_streams()) {
+            creator_random = random->get_stream(i, Random::population_stream);
+        }
+        for (const MinerConfig& miner_config : simulation.pools[i].miners_config) {
+            auto miner_creator = MinerCreatorFactory::create(miner_config.generator, network, creator_random);
+            auto specs = miner_creator->create_specs(miner_config.params);
+            population.random_states.push_back(save_random_state(*creator_random));
+            // the share handlers draw when created, before the specs of the next config
+            miner_creator->create_miners(specs);
+            population.specs.push_back(std::move(specs));
+        }
+    }
+    return population;
+}
+
+// set from signal handlers, hence not a member
+static volatile std::sig_atomic_t checkpoint_requested = 0;
+
+void Simulator::run() {
+    if (!started) {
+        initialize();
+        start_engine(true);
     }
 
-    schedule_all();
+    spdlog::info("running {} blocks using {} engine and {} event queue",
+                 simulation.blocks, simulation.engine, simulation.event_queue);
 
-    spdlog::info("running {} blocks", simulation.blocks);
+    if (!simulation.blocks_output.empty() && block_writer == nullptr) {
+        block_writer = std::unique_ptr<BlockEventWriter>(
+            new BlockEventWriter(simulation.blocks_output, network, 0,
+                                 simulation.output_config.get_fields("blocks")));
+    }
 
+    bool checkpoints = !simulation.checkpoint_path.empty();
+    int64_t previous_duration = duration;
     auto start = std::chrono::high_resolution_clock::now();
+    auto update_duration = [&]() {
+        auto now = std::chrono::high_resolution_clock::now();
+        duration = previous_duration +
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+    };
 
     while (network->get_current_block() < simulation.blocks) {
-        auto event = queue.pop();
-        process_event(event);
+        uint64_t stop_block = simulation.blocks;
+        if (checkpoints && simulation.checkpoint_every > 0) {
+            uint64_t every = simulation.checkpoint_every;
+            stop_block = std::min(stop_block, (network->get_current_block() / every + 1) * every);
+        }
+
+        run_until(stop_block, checkpoints);
+
+        if (checkpoints && !is_finished()) {
+            update_duration();
+            save_checkpoint(simulation.checkpoint_path);
+            spdlog::info("checkpoint written at block {}", network->get_current_block());
+            if (checkpoint_requested) {
+                checkpoint_requested = 0;
+                if (block_writer != nullptr) {
+                    block_writer->close();
+                }
+                spdlog::info("simulation stopped, resume it with --resume {}", simulation.checkpoint_path);
+                return;
+            }
+        }
     }
-    auto end = std::chrono::high_resolution_clock::now();
 
-    duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    // account for the shares found since the last block of each pool
+    for (auto& pool : fast_forward_pools) {
+        pool->settle(network->get_current_time());
+    }
+
+    if (block_writer != nullptr) {
+        block_writer->close();
+    }
+    update_duration();
 }
 
-void Simulator::output_result(const json& result) const {
-    auto filepath = simulation.output;
+void Simulator::start_engine(bool schedule) {
+    sort_miners();
+    spdlog::debug("loaded {} pools with a total of {} miners", pools.size(), miners_count);
+
+    if (pools.empty() || miners_count == 0) {
+        throw InvalidSimulationException("simulation must have at least one miner and one pool");
+    }
+
+    const std::string& engine = simulation.engine;
+    if (engine == "aggregated") {
+        initialize_sampler();
+    } else if (engine == "fast_forward") {
+        if (schedule) {
+            initialize_fast_forward();
+        } else {
+            create_fast_forward_pools();
+        }
+        spdlog::info("fast forwarding {} out of {} pools", fast_forward_pools.size(), pools.size());
+    } else if (engine == "per_miner") {
+        if (schedule) {
+            schedule_all();
+        }
+    } else {
+        throw InvalidSimulationException("engine must be one of per_miner, aggregated or fast_forward");
+    }
+    started = true;
+}
+
+void Simulator::run_until(uint64_t stop_block, bool interruptible) {
+    const std::string& engine = simulation.engine;
+    if (engine == "aggregated") {
+        while (network->get_current_block() < stop_block && !(interruptible && checkpoint_requested)) {
+            process_next_share();
+        }
+    } else if (engine == "fast_forward") {
+        while (network->get_current_block() < stop_block && !(interruptible && checkpoint_requested)) {
+            process_next_fast_forward();
+        }
+    } else {
+        while (network->get_current_block() < stop_block && !(interruptible && checkpoint_requested)) {
+            auto event = queue->pop();
+            process_event(event);
+        }
+    }
+}
+
+bool Simulator::is_finished() const {
+    return network->get_current_block() >= simulation.blocks;
+}
+
+void Simulator::request_checkpoint() {
+    checkpoint_requested = 1;
+}
+
+void Simulator::save_checkpoint(const std::string& filepath) const {
+    if (simulation.config.is_null()) {
+        throw std::invalid_argument("checkpoints need the config of the simulation");
+    }
+
+    // the config as it was run, so that the checkpoint is enough to resume
+    json config = simulation.config;
+    config["event_queue"] = simulation.event_queue;
+    config.erase("checkpoint");
+    if (!simulation.checkpoint_path.empty()) {
+        config["checkpoint"] = {{"path", simulation.checkpoint_path},
+                                {"every", simulation.checkpoint_every}};
+    }
+
+    // a preempted write must not destroy the previous checkpoint
+    std::string temporary_path = filepath + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        CheckpointWriter writer(file);
+        writer.write_header();
+        writer.write(config);
+        save_state(writer);
+        file.flush();
+        if (!file) {
+            throw std::invalid_argument("could not write checkpoint to " + temporary_path);
+        }
+    }
+    if (std::rename(temporary_path.c_str(), filepath.c_str()) != 0) {
+        throw std::invalid_argument("could not write checkpoint to " + filepath);
+    }
+}
+
+Simulation Simulator::read_checkpoint_simulation(const std::string& filepath) {
+    std::ifstream file(filepath, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        throw std::invalid_argument("could not read checkpoint " + filepath);
+    }
+    CheckpointReader reader(file);
+    reader.read_header();
+    return reader.read<json>().get<Simulation>();
+}
+
+void Simulator::load_checkpoint(const std::string& filepath) {
+    std::ifstream file(filepath, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+        throw std::invalid_argument("could not read checkpoint " + filepath);
+    }
+    CheckpointReader reader(file);
+    reader.read_header();
+    Simulation checkpoint_simulation = reader.read<json>().get<Simulation>();
+    if (checkpoint_simulation.seed != simulation.seed || checkpoint_simulation.rng != simulation.rng ||
+        checkpoint_simulation.engine != simulation.engine) {
+        throw std::invalid_argument("checkpoint " + filepath + " was written for another simulation");
+    }
+
+    // pools, miners and their ids are created again from the config,
+    // then everything that changed since is overwritten
+    initialize();
+    start_engine(false);
+    load_state(reader);
+    spdlog::info("resuming from block {}", network->get_current_block());
+}
+
+void Simulator::save_state(CheckpointWriter& writer) const {
+    writer.write(duration);
+    network->save(writer);
+
+    random->save(writer);
+    uniforms.save(writer);
+    if (random->has_streams()) {
+        for (auto pool : pools) {
+            pool->get_random()->save(writer);
+        }
+        for (auto miner_random : miner_randoms) {
+            if (miner_random) {
+                miner_random->save(writer);
+            }
+        }
+    }
+
+    for (auto pool : pools) {
+        pool->save(writer);
+    }
+
+    writer.write((uint64_t) miners_count);
+    for (auto miner : miners) {
+        if (miner) {
+            writer.write(miner->get_id());
+            writer.write((uint64_t) get_pool_index(miner->get_pool()));
+            miner->save(writer);
+        }
+    }
+
+    writer.write(blocks_seen);
+    writer.write((uint64_t) block_events.size());
+    for (const BlockEvent& block_event : block_events) {
+        save(writer, block_event);
+    }
+    // streamed blocks stay in their file, which is truncated to this size on resume
+    writer.write(block_writer != nullptr ? block_writer->flush() : (uint64_t) 0);
+
+    std::vector<Event> events = queue->get_events();
+    writer.write((uint64_t) events.size());
+    for (const Event& event : events) {
+        writer.write(event.miner_id);
+        writer.write(event.time);
+    }
+
+    writer.write(sampler != nullptr);
+    if (sampler != nullptr) {
+        sampler->save(writer);
+    }
+
+    writer.write((uint64_t) fast_forward_pools.size());
+    for (auto& pool : fast_forward_pools) {
+        pool->save(writer);
+    }
+}
+
+void Simulator::load_state(CheckpointReader& reader) {
+    auto mismatch = []() {
+        return std::invalid_argument("checkpoint does not match the simulation");
+    };
+
+    reader.read(duration);
+    network->load(reader);
+
+    random->load(reader);
+    uniforms.load(reader);
+    if (random->has_streams()) {
+        for (auto pool : pools) {
+            pool->get_random()->load(reader);
+        }
+        for (auto miner_random : miner_randoms) {
+            if (miner_random) {
+                miner_random->load(reader);
+            }
+        }
+    }
+
+    for (auto pool : pools) {
+        pool->load(reader);
+    }
+
+    if (reader.read<uint64_t>() != miners_count) {
+        throw mismatch();
+    }
+    for (size_t i = 0; i < miners_count; i++) {
+        uint32_t miner_id = reader.read<uint32_t>();
+        uint64_t pool_index = reader.read<uint64_t>();
+        if (miner_id >= miners.size() || !miners[miner_id] || pool_index >= pools.size()) {
+            throw mismatch();
+        }
+        auto miner = miners[miner_id];
+        // miners may have hopped to another pool
+        if (miner->get_pool() != pools[pool_index]) {
+            miner->join_pool(pools[pool_index]);
+        }
+        miner->load(reader);
+    }
+
+    reader.read(blocks_seen);
+    block_events.resize(reader.read<uint64_t>());
+    for (BlockEvent& block_event : block_events) {
+        load(reader, block_event);
+    }
+    uint64_t blocks_output_size = reader.read<uint64_t>();
+    if (!simulation.blocks_output.empty()) {
+        block_writer = std::unique_ptr<BlockEventWriter>(
+            new BlockEventWriter(simulation.blocks_output, network, blocks_output_size,
+                                 simulation.output_config.get_fields("blocks")));
+    }
+
+    // scheduled in time order, which is the order they are popped in
+    std::vector<Event> events;
+    uint64_t events_count = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < events_count; i++) {
+        uint32_t miner_id = reader.read<uint32_t>();
+        double time = reader.read<double>();
+        events.push_back(Event(miner_id, time));
+    }
+    std::sort(events.begin(), events.end(), [](const Event& left, const Event& right) {
+        return left.time < right.time || (left.time == right.time && left.miner_id < right.miner_id);
+    });
+    for (const Event& event : events) {
+        queue->schedule(event);
+    }
+
+    if (reader.read<bool>() != (sampler != nullptr)) {
+        throw mismatch();
+    }
+    if (sampler != nullptr) {
+        sampler->load(reader);
+    }
+
+    if (reader.read<uint64_t>() != fast_forward_pools.size()) {
+        throw mismatch();
+    }
+    for (auto& pool : fast_forward_pools) {
+        pool->load(reader);
+    }
+}
+
+void Simulator::output_result(const std::string& filepath, const json& result,
+                              const CompressionConfig& compression) {
     // FIXME: throw if the filepath does not exist or create it
 
-    if (filepath.substr(filepath.size() - 3, 3) != ".gz") {
-        std::ofstream o(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-        o << std::setw(4) << result << std::endl;
+    if (is_columnar_path(filepath)) {
+        throw std::invalid_argument("only the result of a single simulation can be written to " + filepath);
+    }
+
+    write_json(filepath, result, compression);
+}
+
+void Simulator::save_simulation_data() {
+    if (is_columnar_path(simulation.output)) {
+        save_columnar_result(simulation.output);
+    } else if (simulation.output_config.index) {
+        ResultIndexBuilder index;
+        std::vector<BlockPosition> blocks;
+        write_output(simulation.output, simulation.compression, [this, &index](std::ostream& stream) {
+            write_result(stream, &index);
+            stream << std::endl;
+        }, &blocks);
+        index.write(get_index_path(simulation.output), simulation.output,
+                    get_codec_name(simulation.output, simulation.compression), blocks);
+    } else {
+        write_output(simulation.output, simulation.compression, [this](std::ostream& stream) {
+            write_result(stream);
+            stream << std::endl;
+        });
+    }
+
+    std::string summary_path = simulation.output_config.get_summary_output(simulation.output);
+    if (!summary_path.empty()) {
+        write_output(summary_path, CompressionConfig(), [this](std::ostream& stream) {
+            write_summary(stream);
+            stream << std::endl;
+        });
+    }
+}
+
+// blocks of the records of each miner id, summed over the pools
+struct MinerTotals {
+    uint64_t blocks_mined = 0;
+    double blocks_received = 0;
+    // work per block received in each pool, only set for the tracked miners
+    json work_in_pool_per_block;
+};
+
+static std::vector<MinerTotals> get_miner_totals(const std::vector<std::shared_ptr<MiningPool>>& pools,
+                                                 const std::vector<uint32_t>& miner_ids,
+                                                 size_t miner_ids_count, const Selection& tracked_miners) {
+    std::vector<MinerTotals> miner_totals(miner_ids_count);
+    for (auto& pool : pools) {
+        pool->export_records(miner_ids, [&](const MinerRecord& record) {
+            MinerTotals& totals = miner_totals[record.get_miner_id()];
+            totals.blocks_mined += record.get_blocks_mined();
+            totals.blocks_received += record.get_blocks_received();
+            if (tracked_miners.has(record.get_miner_address())) {
+                totals.work_in_pool_per_block[pool->get_name()] =
+                    get_ratio((double) record.get_shares_count() * pool->get_difficulty(),
+                              record.get_blocks_received());
+            }
+        });
+    }
+    return miner_totals;
+}
+
+static std::vector<BehaviorSummary> get_behavior_summaries(const std::vector<std::shared_ptr<Miner>>& miners,
+                                                           const std::vector<MinerTotals>& miner_totals) {
+    std::map<std::string, BehaviorSummary> behaviors;
+    for (auto& miner : miners) {
+        if (miner) {
+            const MinerTotals& totals = miner_totals[miner->get_id()];
+            BehaviorSummary& behavior = behaviors[miner->get_handler_name()];
+            behavior.behavior = miner->get_handler_name();
+            behavior.miners++;
+            behavior.hashrate += miner->get_hashrate();
+            behavior.blocks_mined += totals.blocks_mined;
+            behavior.blocks_received += totals.blocks_received;
+            behavior.total_work += miner->get_total_work();
+        }
+    }
+    std::vector<BehaviorSummary> summaries;
+    for (auto& behavior : behaviors) {
+        summaries.push_back(behavior.second);
+    }
+    return summaries;
+}
+
+std::vector<BehaviorSummary> Simulator::get_behavior_summaries() const {
+    // no miner is tracked, as only the totals are needed
+    Selection none{std::set<std::string>()};
+    auto miner_totals = get_miner_totals(pools, miner_ids_by_address, network->get_miner_ids_count(), none);
+    return poolsim::get_behavior_summaries(miners, miner_totals);
+}
+
+std::vector<PoolSummary> Simulator::get_pool_summaries() const {
+    std::vector<PoolSummary> summaries;
+    for (auto& pool : pools) {
+        PoolSummary summary;
+        summary.name = pool->get_name();
+        summary.reward_scheme = pool->get_scheme_name();
+        summary.difficulty = pool->get_difficulty();
+        summary.blocks_mined = pool->get_blocks_mined();
+        summary.shares_count = pool->get_shares_count();
+        summary.expected_shares = (double) network->get_difficulty() / pool->get_difficulty();
+        summary.luck_distribution = pool->get_luck_distribution();
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+StoredRun Simulator::get_stored_run() const {
+    StoredRun run;
+    run.config = simulation.config;
+    run.seed = simulation.seed;
+    run.output = simulation.output;
+    run.blocks = network->get_current_block();
+    run.runtime_milliseconds = duration;
+    run.behaviors = get_behavior_summaries();
+    for (auto& behavior : run.behaviors) {
+        run.total_work += behavior.total_work;
+    }
+    run.pools = get_pool_summaries();
+    return run;
+}
+
+void Simulator::write_summary(std::ostream& stream) const {
+    std::vector<MinerTotals> miner_totals = get_miner_totals(pools, miner_ids_by_address,
+                                                             network->get_miner_ids_count(), tracked_miners);
+
+    // keys in alphabetical order
+    JsonWriter writer(stream, 4);
+    writer.begin_object();
+
+    writer.key("behaviors");
+    writer.begin_array();
+    for (auto& behavior : poolsim::get_behavior_summaries(miners, miner_totals)) {
+        write(writer, behavior);
+    }
+    writer.end_array();
+
+    writer.field("blocks", network->get_current_block());
+
+    writer.key("miners");
+    writer.begin_array();
+    uint64_t total_work = 0;
+    for (uint32_t miner_id : miner_ids_by_address) {
+        auto& miner = miners[miner_id];
+        total_work += miner->get_total_work();
+        if (tracked_miners.has(miner->get_address())) {
+            const MinerTotals& totals = miner_totals[miner->get_id()];
+            writer.begin_object();
+            writer.field("address", miner->get_address());
+            writer.field("behavior", miner->get_handler_name());
+            writer.field("blocks_mined", totals.blocks_mined);
+            writer.field("blocks_ratio", get_ratio(totals.blocks_received, totals.blocks_mined));
+            writer.field("blocks_received", totals.blocks_received);
+            writer.field("hashrate", miner->get_hashrate());
+            writer.field("total_work", miner->get_total_work());
+            writer.key("work_in_pool_per_block");
+            writer.value(totals.work_in_pool_per_block.is_null() ? json::object() : totals.work_in_pool_per_block);
+            writer.field("work_per_block", get_ratio(miner->get_total_work(), totals.blocks_received));
+            writer.field("work_per_block_solo", get_ratio(miner->get_total_work(), totals.blocks_mined));
+            writer.end_object();
+        }
+    }
+    writer.end_array();
+
+    writer.key("pools");
+    writer.begin_array();
+    for (auto& pool : get_pool_summaries()) {
+        write(writer, pool);
+    }
+    writer.end_array();
+
+    writer.field("runtime_milliseconds", duration);
+    writer.field("total_work", total_work);
+    writer.end_object();
+}
+
+void Simulator::save_columnar_result(const std::string& filepath) const {
+    // the miner address and pool of the records, and the address of the miners,
+    // are always written as they identify the rows
+    const OutputConfig& output_config = simulation.output_config;
+    Selection pool_fields = output_config.get_fields("pools");
+    Selection record_fields = output_config.get_fields("records");
+    Selection miner_fields = output_config.get_fields("miners");
+    Selection block_fields = output_config.get_fields("blocks");
+    ColumnarWriter writer;
+
+    std::vector<std::string> addresses;
+    for (uint32_t id = 0; id < network->get_miner_ids_count(); id++) {
+        addresses.push_back(network->get_miner_address(id));
+    }
+    writer.add_column(columnar_addresses_column, addresses);
+    writer.add_column("simulation.runtime_milliseconds", std::vector<uint64_t>{static_cast<uint64_t>(duration)});
+
+    std::vector<std::string> pool_names, pool_schemes;
+    std::vector<uint64_t> pool_difficulties;
+    std::vector<uint32_t> record_pools, record_miners;
+    std::vector<uint64_t> blocks_mined, uncles_mined, share_counts;
+    std::vector<double> blocks_received, uncles_received;
+    for (uint32_t i = 0; i < pools.size() && output_config.sections.has("pools"); i++) {
+        pool_names.push_back(pools[i]->get_name());
+        pool_schemes.push_back(pools[i]->get_scheme_name());
+        pool_difficulties.push_back(pools[i]->get_difficulty());
+        if (!pool_fields.has("miners")) {
+            continue;
+        }
+        pools[i]->export_records(miner_ids_by_address, [&](const MinerRecord& record) {
+            if (!tracked_miners.has(record.get_miner_address())) {
+                return;
+            }
+            record_pools.push_back(i);
+            record_miners.push_back(record.get_miner_id());
+            blocks_mined.push_back(record.get_blocks_mined());
+            blocks_received.push_back(record.get_blocks_received());
+            uncles_mined.push_back(record.get_uncles_mined());
+            uncles_received.push_back(record.get_uncles_received());
+            share_counts.push_back(record.get_shares_count());
+        });
+    }
+    if (output_config.sections.has("pools")) {
+        if (pool_fields.has("name")) {
+            writer.add_column("pools.name", pool_names);
+        }
+        if (pool_fields.has("difficulty")) {
+            writer.add_column("pools.difficulty", pool_difficulties);
+        }
+        if (pool_fields.has("reward_scheme")) {
+            writer.add_column("pools.reward_scheme", pool_schemes);
+        }
+    }
+    if (output_config.sections.has("pools") && pool_fields.has("miners")) {
+        writer.add_column("pool_miners.pool", record_pools);
+        writer.add_address_column("pool_miners.miner", record_miners);
+        if (record_fields.has("blocks_mined")) {
+            writer.add_column("pool_miners.blocks_mined", blocks_mined);
+        }
+        if (record_fields.has("blocks_received")) {
+            writer.add_column("pool_miners.blocks_received", blocks_received);
+        }
+        if (record_fields.has("uncles_mined")) {
+            writer.add_column("pool_miners.uncles_mined", uncles_mined);
+        }
+        if (record_fields.has("uncles_received")) {
+            writer.add_column("pool_miners.uncles_received", uncles_received);
+        }
+        if (record_fields.has("share_count")) {
+            writer.add_column("pool_miners.share_count", share_counts);
+        }
+    }
+
+    if (output_config.sections.has("miners")) {
+        std::vector<uint32_t> miner_ids;
+        std::vector<std::string> behaviors, handler_metadata;
+        std::vector<double> hashrates;
+        std::vector<uint64_t> blocks_found, total_work;
+        for (uint32_t miner_id : miner_ids_by_address) {
+            auto& miner = miners[miner_id];
+            if (tracked_miners.has(miner->get_address())) {
+                miner_ids.push_back(miner_id);
+                behaviors.push_back(miner->get_handler_name());
+                hashrates.push_back(miner->get_hashrate());
+                blocks_found.push_back(miner->get_blocks_found());
+                total_work.push_back(miner->get_total_work());
+                if (miner_fields.has("handler_metadata")) {
+                    handler_metadata.push_back(miner->get_handler_metadata().dump());
+                }
+            }
+        }
+        writer.add_address_column("miners.address", miner_ids);
+        if (miner_fields.has("behavior")) {
+            writer.add_column("miners.behavior", behaviors);
+        }
+        if (miner_fields.has("hashrate")) {
+            writer.add_column("miners.hashrate", hashrates);
+        }
+        if (miner_fields.has("blocks_found")) {
+            writer.add_column("miners.blocks_found", blocks_found);
+        }
+        if (miner_fields.has("total_work")) {
+            writer.add_column("miners.total_work", total_work);
+        }
+        if (miner_fields.has("handler_metadata")) {
+            writer.add_column("miners.handler_metadata", handler_metadata);
+        }
+    }
+
+    // the blocks streamed to the blocks output are not kept in memory
+    if (!simulation.blocks_output.empty()) {
+        writer.add_column("simulation.blocks_output", std::vector<std::string>{simulation.blocks_output});
+        writer.write(filepath);
+        return;
+    }
+    if (!output_config.sections.has("blocks")) {
+        writer.write(filepath);
         return;
     }
 
-    #ifdef USE_BOOST_IOSTREAMS
-    std::ofstream file(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-    boost::iostreams::filtering_streambuf<boost::iostreams::output> out;
-    out.push(boost::iostreams::gzip_compressor());
-    out.push(file);
+    size_t blocks_count = block_events.size();
+    std::vector<double> times(blocks_count), lucks(blocks_count);
+    std::vector<uint32_t> block_pools(blocks_count), block_miners(blocks_count);
+    std::vector<uint8_t> uncles(blocks_count);
+    std::vector<uint64_t> shares_per_block(blocks_count);
+    // only written when a pool uses the qb reward scheme
+    bool has_qb_data = false;
+    std::vector<uint64_t> credit_balances(blocks_count), reset_balances(blocks_count);
+    std::vector<uint32_t> receivers(blocks_count);
+    std::vector<double> prop_credits_lost(blocks_count), total_credits_lost(blocks_count),
+        average_credits_lost(blocks_count);
+    for (size_t i = 0; i < blocks_count; i++) {
+        auto& block = block_events[i];
+        auto& data = block.scheme_data.data;
+        times[i] = block.time;
+        block_pools[i] = block.pool_id;
+        block_miners[i] = block.miner_id;
+        uncles[i] = block.is_uncle;
+        shares_per_block[i] = data.shares_per_block;
+        lucks[i] = data.pool_luck;
+        has_qb_data = has_qb_data || block.scheme_data.type == BlockSchemeData::Type::qb;
+        credit_balances[i] = data.credit_balance_receiver;
+        reset_balances[i] = data.reset_balance_receiver;
+        receivers[i] = data.receiver_id;
+        prop_credits_lost[i] = data.prop_credits_lost;
+        total_credits_lost[i] = data.total_credits_lost;
+        average_credits_lost[i] = data.average_credits_lost;
+    }
+    if (block_fields.has("time")) {
+        writer.add_column("blocks.time", times);
+    }
+    if (block_fields.has("pool_name")) {
+        writer.add_column("blocks.pool", block_pools);
+    }
+    if (block_fields.has("miner_address")) {
+        writer.add_address_column("blocks.miner", block_miners);
+    }
+    if (block_fields.has("is_uncle")) {
+        writer.add_column("blocks.is_uncle", uncles);
+    }
+    if (block_fields.has("reward_scheme_data")) {
+        writer.add_column("blocks.shares_per_block", shares_per_block);
+        writer.add_column("blocks.pool_luck", lucks);
+    }
+    if (block_fields.has("reward_scheme_data") && has_qb_data) {
+        writer.add_column("blocks.credit_balance_receiver", credit_balances);
+        writer.add_address_column("blocks.receiver", receivers);
+        writer.add_column("blocks.reset_balance_receiver", reset_balances);
+        writer.add_column("blocks.proportion_credits_lost", prop_credits_lost);
+        writer.add_column("blocks.total_credits_lost", total_credits_lost);
+        writer.add_column("blocks.average_credits_lost", average_credits_lost);
+    }
 
-    std::ostream o(&out);
-    o << std::setw(4) << result << std::endl;
-    #else
-    throw std::invalid_argument("boost not found, cannot output gz");
-    #endif
+    writer.write(filepath);
 }
 
-void Simulator::save_simulation_data() {
+// removes the fields of the object which are not selected
+static void select_fields(json& object, const Selection& fields) {
+    for (auto it = object.begin(); it != object.end();) {
+        if (fields.has(it.key())) {
+            ++it;
+        } else {
+            it = object.erase(it);
+        }
+    }
+}
+
+json Simulator::get_result() const {
+    const OutputConfig& output_config = simulation.output_config;
     json result;
 
     result["runtime_milliseconds"] = duration;
 
-    result["blocks"] = json::array();
-    for (auto block : block_events) {
-        result["blocks"].push_back(block);
+    if (!simulation.blocks_output.empty()) {
+        result["blocks_output"] = simulation.blocks_output;
+    } else if (output_config.sections.has("blocks")) {
+        Selection fields = output_config.get_fields("blocks");
+        result["blocks"] = json::array();
+        for (const BlockEvent& block : block_events) {
+            json block_json;
+            to_json(block_json, block, *network);
+            select_fields(block_json, fields);
+            result["blocks"].push_back(block_json);
+        }
     }
 
-    result["pools"] = json::array();
-    for (auto pool : pools) {
-        result["pools"].push_back(*pool);
+    if (output_config.sections.has("pools")) {
+        Selection fields = output_config.get_fields("pools");
+        Selection record_fields = output_config.get_fields("records");
+        result["pools"] = json::array();
+        for (auto pool : pools) {
+            json pool_json = *pool;
+            pool_json["miners"] = pool->get_miners_metadata(miner_ids_by_address);
+            json records = json::array();
+            for (json& record : pool_json["miners"]) {
+                if (tracked_miners.has(record["address"].get<std::string>())) {
+                    select_fields(record["metadata"], record_fields);
+                    records.push_back(record);
+                }
+            }
+            pool_json["miners"] = records;
+            select_fields(pool_json, fields);
+            result["pools"].push_back(pool_json);
+        }
+    }
+
+    if (output_config.sections.has("miners")) {
+        Selection fields = output_config.get_fields("miners");
+        result["miners"] = json::array();
+        for (uint32_t miner_id : miner_ids_by_address) {
+            auto& miner = miners[miner_id];
+            if (tracked_miners.has(miner->get_address())) {
+                json miner_json = *miner;
+                select_fields(miner_json, fields);
+                result["miners"].push_back(miner_json);
+            }
+        }
+    }
+
+    return result;
+}
+
+void Simulator::write_result(std::ostream& stream, ResultIndexBuilder* index) const {
+    // keys in alphabetical order, as in get_result()
+    const OutputConfig& output_config = simulation.output_config;
+    JsonWriter writer(stream, 4);
+    writer.begin_object();
+
+    if (!simulation.blocks_output.empty()) {
+        writer.field("blocks_output", simulation.blocks_output);
+    } else if (output_config.sections.has("blocks")) {
+        Selection fields = output_config.get_fields("blocks");
+        writer.key("blocks");
+        writer.begin_array();
+        for (const BlockEvent& block : block_events) {
+            write(writer, block, *network, fields);
+        }
+        writer.end_array();
+    }
+
+    if (output_config.sections.has("miners")) {
+        Selection fields = output_config.get_fields("miners");
+        writer.key("miners");
+        writer.begin_array();
+        for (uint32_t miner_id : miner_ids_by_address) {
+            auto& miner = miners[miner_id];
+            if (tracked_miners.has(miner->get_address())) {
+                uint64_t offset = index ? writer.begin_entry() : 0;
+                write(writer, *miner, fields);
+                if (index) {
+                    index->add_miner(miner->get_address(), offset, writer.get_position() - offset);
+                }
+            }
+        }
+        writer.end_array();
     }
 
-    result["miners"] = json::array();
-    for (auto miner_kv : miners) {
-        result["miners"].push_back(*miner_kv.second);
+    if (output_config.sections.has("pools")) {
+        Selection fields = output_config.get_fields("pools");
+        Selection record_fields = output_config.get_fields("records");
+        writer.key("pools");
+        writer.begin_array();
+        for (size_t i = 0; i < pools.size(); i++) {
+            if (!index) {
+                write(writer, *pools[i], miner_ids_by_address, fields, record_fields, tracked_miners);
+                continue;
+            }
+            uint64_t offset = writer.begin_entry();
+            write(writer, *pools[i], miner_ids_by_address, fields, record_fields, tracked_miners,
+                  [index, i](const MinerRecord& record, uint64_t record_offset, uint64_t length) {
+                index->add_record(record.get_miner_address(), i, record_offset, length);
+            });
+            index->add_pool(pools[i]->get_name(), pools[i]->get_difficulty(), offset,
+                            writer.get_position() - offset);
+        }
+        writer.end_array();
     }
 
-    output_result(result);
+    writer.field("runtime_milliseconds", duration);
+    writer.end_object();
+}
+
+void Simulator::set_blocks_enabled(bool enabled) {
+    blocks_enabled = enabled;
 }
 
 void Simulator::schedule_all() {
-  for (auto miner_kv: miners) {
-    schedule_miner(miner_kv.second);
+  sort_miners();
+  for (uint32_t miner_id : miner_ids_by_address) {
+    schedule_miner(miners[miner_id]);
   }
 }
 
 void Simulator::process_event(const Event& event) {
     network->set_current_time(event.time);
-    auto miner = get_miner(event.miner_address);
+    auto miner = get_miner(event.miner_id);
+    Share share = draw_share(miner);
+    schedule_miner(miner);
+    miner->process_share(share);
+}
+
+void Simulator::initialize_sampler() {
+    // the alias table cannot be updated cheaply, so it is only used
+    // when no miner can move to another pool during the simulation
+    bool dynamic = false;
+    std::vector<double> rates(miners.size(), 0);
+    for (size_t i = 0; i < miners.size(); i++) {
+        if (miners[i]) {
+            rates[i] = get_share_rate(miners[i]);
+            dynamic = dynamic || miners[i]->can_change_pool();
+        }
+    }
+
+    if (dynamic) {
+        sampler = std::unique_ptr<WeightedSampler>(new FenwickTree(rates));
+    } else {
+        sampler = std::unique_ptr<WeightedSampler>(new AliasTable(rates));
+    }
+}
+
+void Simulator::process_next_share() {
+    // superposed Poisson processes: the next share of the network comes
+    // at the summed rate, and is found by each miner proportionally to its rate
+    double t = uniforms.next_exponential() / sampler->get_total_weight();
+    network->set_current_time(network->get_current_time() + t);
+    auto miner = get_miner(sampler->sample(uniforms.next()));
+    auto pool = miner->get_pool();
+
+    miner->process_share(draw_share(miner));
+
+    if (miner->get_pool() != pool) {
+        sampler->set_weight(miner->get_id(), get_share_rate(miner));
+    }
+}
+
+void Simulator::initialize_fast_forward() {
+    std::vector<bool> fast_forwarded = create_fast_forward_pools();
+    for (auto& pool : fast_forward_pools) {
+        pool->start_round(network->get_current_time());
+    }
+
+    for (uint32_t miner_id : miner_ids_by_address) {
+        if (!fast_forwarded[miner_id]) {
+            schedule_miner(miners[miner_id]);
+        }
+    }
+}
+
+std::vector<bool> Simulator::create_fast_forward_pools() {
+    // luck-based hopping depends on the state of every pool
+    // so nothing is fast forwarded when a miner may hop
+    bool can_change_pool = false;
+    for (auto miner : miners) {
+        can_change_pool = can_change_pool || (miner && miner->can_change_pool());
+    }
+
+    std::vector<bool> fast_forwarded(miners.size(), false);
+    for (auto pool : pools) {
+        if (can_change_pool) {
+            break;
+        }
+        std::vector<std::shared_ptr<Miner>> pool_miners;
+        for (uint32_t miner_id : pool->get_miners()) {
+            pool_miners.push_back(get_miner(miner_id));
+        }
+        if (!FastForwardPool::is_eligible(pool, pool_miners)) {
+            continue;
+        }
+        fast_forward_pools.push_back(std::unique_ptr<FastForwardPool>(
+            new FastForwardPool(pool, pool_miners, simulation.network_difficulty, pool->get_random())));
+        for (auto miner : pool_miners) {
+            fast_forwarded[miner->get_id()] = true;
+        }
+    }
+    return fast_forwarded;
+}
+
+void Simulator::process_next_fast_forward() {
+    FastForwardPool* next_pool = nullptr;
+    for (auto& pool : fast_forward_pools) {
+        if (next_pool == nullptr || pool->get_next_block_time() < next_pool->get_next_block_time()) {
+            next_pool = pool.get();
+        }
+    }
+
+    if (next_pool == nullptr ||
+        (!queue->is_empty() && queue->get_top().time <= next_pool->get_next_block_time())) {
+        process_event(queue->pop());
+        return;
+    }
+
+    network->set_current_time(next_pool->get_next_block_time());
+    auto miner = next_pool->complete_round();
+    miner->process_share(create_share(true));
+    next_pool->start_round(network->get_current_time());
+}
+
+size_t Simulator::get_fast_forward_pools_count() const {
+    return fast_forward_pools.size();
+}
+
+double Simulator::get_share_rate(const std::shared_ptr<Miner>& miner) const {
+    return miner->get_hashrate() / miner->get_pool()->get_difficulty();
+}
+
+Share Simulator::draw_share(const std::shared_ptr<Miner>& miner) {
     auto pool = miner->get_pool();
     double p = (double) pool->get_difficulty() / simulation.network_difficulty;
-    bool is_network_share = random->drand48() < p;
+    return create_share(next_uniform(miner) < p);
+}
+
+double Simulator::next_uniform(const std::shared_ptr<Miner>& miner) {
+    if (miner_randoms.empty()) {
+        return uniforms.next();
+    }
+    return miner_randoms[miner->get_id()]->drand48();
+}
+
+double Simulator::next_exponential(const std::shared_ptr<Miner>& miner) {
+    if (miner_randoms.empty()) {
+        return uniforms.next_exponential();
+    }
+    return -log(miner_randoms[miner->get_id()]->drand48());
+}
+
+Share Simulator::create_share(bool is_valid_block) {
     uint8_t share_flags = Share::Property::none;
-    if (is_network_share) {
+    if (is_valid_block) {
         network->inc_current_block();
         uint64_t current_block = network->get_current_block();
         if (current_block % 10000 == 0) {
@@ -182,38 +1170,64 @@ void Simulator::process_event(const Event& event) {
         }
         share_flags |= Share::Property::valid_block;
     }
-    Share share(share_flags);
-    schedule_miner(miner);
-    miner->process_share(share);
+    return Share(share_flags);
 }
 
 void Simulator::schedule_miner(const std::shared_ptr<Miner> miner) {
-  auto pool = miner->get_pool();
-  double lambda = miner->get_hashrate() / pool->get_difficulty();
-  double t = -log(random->drand48()) / lambda;
+  double lambda = get_share_rate(miner);
+  double t = next_exponential(miner) / lambda;
 
-  Event miner_next_event(miner->get_address(), network->get_current_time() + t);
-  queue.schedule(miner_next_event);
+  Event miner_next_event(miner->get_id(), network->get_current_time() + t);
+  queue->schedule(miner_next_event);
 }
 
 void Simulator::add_miner(std::shared_ptr<Miner> miner) {
-  miners[miner->get_address()] = miner;
+  // ids are assigned densely by the network, so this stays a flat array
+  uint32_t miner_id = miner->get_id();
+  if (miner_id >= miners.size()) {
+    miners.resize(miner_id + 1);
+  }
+  if (!miners[miner_id]) {
+    miners_count++;
+    if (!miner_ids_by_address.empty() &&
+        miner->get_address() < miners[miner_ids_by_address.back()]->get_address()) {
+      miners_sorted = false;
+    }
+    miner_ids_by_address.push_back(miner_id);
+  }
+  miners[miner_id] = miner;
 }
 
 void Simulator::add_pool(std::shared_ptr<MiningPool> pool) {
   pools.push_back(pool);
 }
 
-std::shared_ptr<Miner> Simulator::get_miner(const std::string& miner_address) {
-  return miners[miner_address];
+std::shared_ptr<Miner> Simulator::get_miner(uint32_t miner_id) {
+  return miners[miner_id];
 }
 
 std::shared_ptr<Network> Simulator::get_network() const {
     return network;
 }
 
+const std::vector<std::shared_ptr<MiningPool>>& Simulator::get_pools() const {
+  return pools;
+}
+
+const std::vector<uint32_t>& Simulator::get_miner_ids_by_address() const {
+  return miner_ids_by_address;
+}
+
+size_t Simulator::get_pool_index(const std::shared_ptr<MiningPool>& pool) const {
+  auto it = std::find(pools.begin(), pools.end(), pool);
+  if (it == pools.end()) {
+    throw std::invalid_argument("pool is not part of the simulation");
+  }
+  return it - pools.begin();
+}
+
 size_t Simulator::get_miners_count() const {
-  return miners.size();
+  return miners_count;
 }
 
 size_t Simulator::get_pools_count() const {
@@ -221,17 +1235,24 @@ size_t Simulator::get_pools_count() const {
 }
 
 size_t Simulator::get_events_count() const {
-  return queue.size();
+  return queue->size();
 }
 
 Event Simulator::get_next_event() const {
-  return queue.get_top();
+  return queue->get_top();
 }
 
 void Simulator::process(const BlockEvent& block_event) {
+    if (blocks_seen++ % simulation.output_config.blocks_every != 0) {
+        return;
+    }
     BlockEvent block_event_copy = block_event;
     block_event_copy.time = network->current_time;
-    block_events.push_back(block_event_copy);
+    if (block_writer != nullptr) {
+        block_writer->write(std::move(block_event_copy));
+    } else {
+        block_events.push_back(block_event_copy);
+    }
 }
 
 }
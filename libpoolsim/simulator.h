@@ -1,8 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
-#include <map>
 
 #include "miner.h"
 #include "mining_pool.h"
@@ -10,30 +10,124 @@
 #include "event_queue.h"
 #include "event.h"
 #include "random.h"
+#include "weighted_sampler.h"
+#include "fast_forward.h"
 
 #include "miner_creator.h"
 #include "observer.h"
 #include "block_event.h"
+#include "block_event_writer.h"
+#include "result_index.h"
+#include "result_store.h"
 
 namespace poolsim {
 
+// Miners of a simulation, drawn once and shared by the simulations with the
+// same miners config, seed and generator, e.g. the points of a sweep
+// Both vectors are indexed by miner config, in the order of the pools and of
+// their miner configs
+struct MinerPopulation {
+    std::vector<std::vector<MinerSpec>> specs;
+    // state of the random used to create the miners once their specs were
+    // drawn, which the share handlers then draw from, written by Random::save()
+    std::vector<std::string> random_states;
+};
+
 class Simulator :  public std::enable_shared_from_this<Simulator>,
                    public Observer<BlockEvent> {
 public:
-    explicit Simulator(Simulation simulation);
     Simulator(Simulation simulation, std::shared_ptr<Random> random);
     static std::shared_ptr<Simulator> from_config_file(const std::string& filepath);
+    // Creates a simulator for the given simulation, with its own random instance
+    static std::shared_ptr<Simulator> from_simulation(const Simulation& simulation);
 
-    // Runs the simulator
+    // Runs the simulator, from the start or from the loaded checkpoint
+    // When the simulation has a checkpoint path, a checkpoint is written every
+    // `checkpoint_every` blocks, and the simulation stops after writing one
+    // when request_checkpoint() is called, e.g. on SIGTERM
     void run();
 
+    // Returns whether the simulation ran all its blocks,
+    // rather than being stopped by request_checkpoint()
+    bool is_finished() const;
+
+    // Writes the state of the simulation to a file, with the config needed to
+    // resume it, replacing the previous checkpoint only once fully written
+    void save_checkpoint(const std::string& filepath) const;
+
+    // Initializes the simulator with the state of the checkpoint,
+    // which must have been written for the same simulation, so that
+    // run() continues exactly where the checkpointed simulation was
+    void load_checkpoint(const std::string& filepath);
+
+    // Returns the simulation a checkpoint was written for
+    static Simulation read_checkpoint_simulation(const std::string& filepath);
+
+    // Makes running simulations write a checkpoint and stop
+    // Safe to call from a signal handler
+    static void request_checkpoint();
+
     // Initializes the simulator
     // creates pools and miners
     void initialize();
 
+    // Sets whether the blocks are recorded, which is the default
+    // When disabled, pools do not build block events nor their metadata,
+    // which is also the case when the output config does not select the blocks
+    // Must be called before initialize()
+    void set_blocks_enabled(bool enabled);
+
+    // Sets the random instance used to create the miners
+    // Defaults to the random instance of the simulation, setting a separate one
+    // allows to simulate the same population with different random streams
+    void set_population_random(std::shared_ptr<Random> random);
+
+    // Creates the miners from the given population rather than from the
+    // miner creators of the config, with the same results
+    void set_population(std::shared_ptr<const MinerPopulation> population);
+
+    // Draws the miners of the simulation as initialize() does, from a random
+    // created with the generator and the seed of the simulation
+    static MinerPopulation create_population(const Simulation& simulation);
+
     // Saves the simulation data to a file
+    // as columns if the output ends with .psc, as json written by write_result() otherwise,
+    // with its index, and writes the summary of the simulation next to it,
+    // unless disabled in the output config
     void save_simulation_data();
 
+    // Writes the aggregates of the simulation, computed in a single pass over the records:
+    // the blocks and work of each pool with the distribution of its luck,
+    // the ratios of blocks received over mined and the work per block received
+    // of each miner and of each behavior, and the total work
+    void write_summary(std::ostream& stream) const;
+
+    // Returns the totals of the miners of each behavior, sorted by behavior
+    std::vector<BehaviorSummary> get_behavior_summaries() const;
+
+    // Returns the blocks, shares and luck of each pool
+    std::vector<PoolSummary> get_pool_summaries() const;
+
+    // Returns the summary of the run to append to a result store,
+    // with the seed of the simulation and no parameters
+    StoredRun get_stored_run() const;
+
+    // Writes the blocks, pools and miners of the simulation as columns
+    void save_columnar_result(const std::string& filepath) const;
+
+    // Returns the blocks, pools and miners of the simulation
+    nlohmann::json get_result() const;
+
+    // Writes the same json as get_result(), with an indent of 4, as the blocks,
+    // pools and miners are read, without building the result in memory
+    // The positions of the miners, pools and records are added to `index` if set
+    void write_result(std::ostream& stream, ResultIndexBuilder* index = nullptr) const;
+
+    // Writes the result to the file, compressed with the codec of the config
+    // or, by default, the codec of its extension (see get_codec_name)
+    static void output_result(const std::string& filepath, const nlohmann::json& result,
+                              const CompressionConfig& compression = CompressionConfig());
+
     // Schedules all the miners
     // This should only be used for the first initialization
     void schedule_all();
@@ -45,14 +139,33 @@ public:
     // Schedules a single miner
     void schedule_miner(const std::shared_ptr<Miner> miner);
 
+    // Builds the sampler used by the aggregated engine, with each miner
+    // weighted by its share rate
+    void initialize_sampler();
+
+    // Generates and processes the next share of the network
+    // Used by the aggregated engine instead of the event queue
+    void process_next_share();
+
+    // Sets up the fast forward engine: pools which only depend on share counts
+    // generate whole rounds, the miners of the other pools are scheduled in the event queue
+    void initialize_fast_forward();
+
+    // Processes either the next event of the queue or the next block
+    // of a fast forwarded pool, whichever comes first
+    void process_next_fast_forward();
+
+    // Returns the numbers of pools whose rounds are fast forwarded
+    size_t get_fast_forward_pools_count() const;
+
     // Adds a miner to the simulator
     void add_miner(std::shared_ptr<Miner> miner);
 
     // Adds a pool to the simulator
     void add_pool(std::shared_ptr<MiningPool> pool);
 
-    // Returns the miner with the given address:
-    std::shared_ptr<Miner> get_miner(const std::string& miner_address);
+    // Returns the miner with the given id
+    std::shared_ptr<Miner> get_miner(uint32_t miner_id);
 
     // Returns the numbers of pool
     size_t get_pools_count() const;
@@ -66,6 +179,12 @@ public:
     // Returns the network instance
     std::shared_ptr<Network> get_network() const;
 
+    // Returns the pools of the simulation
+    const std::vector<std::shared_ptr<MiningPool>>& get_pools() const;
+
+    // Returns the ids of the miners in the order of their addresses
+    const std::vector<uint32_t>& get_miner_ids_by_address() const;
+
     // Returns the next event
     Event get_next_event() const;
 
@@ -75,9 +194,21 @@ private:
     // Setup of the simulation to run
     Simulation simulation;
 
-    // List of block events
+    // List of block events, when they are not streamed to the blocks output
     std::vector<BlockEvent> block_events;
 
+    // Writes the block events to the blocks output as they are found
+    std::unique_ptr<BlockEventWriter> block_writer;
+
+    // Whether the simulator observes the blocks of the pools
+    bool blocks_enabled = true;
+
+    // Number of blocks observed, of which one out of `blocks_every` of the output config is kept
+    uint64_t blocks_seen = 0;
+
+    // Addresses of the miners written to the output, set by initialize()
+    Selection tracked_miners;
+
     // Information about the network
     std::shared_ptr<Network> network;
 
@@ -85,20 +216,87 @@ private:
     // used mostly for testing purposes
     std::shared_ptr<Random> random;
 
+    // Uniforms drawn in batches from `random` for the share generation
+    RandomBuffer uniforms;
+
+    // Random instance used to create the miners, defaults to `random`
+    std::shared_ptr<Random> population_random;
+
+    // Miners of the simulation, overriding the miner creators when set
+    std::shared_ptr<const MinerPopulation> population;
+
+    // Random streams of the miners, indexed by miner id
+    // only used when the random instance supports streams
+    std::vector<std::shared_ptr<Random>> miner_randoms;
+
     // Event queue of the simulator
-    EventQueue queue;
+    std::unique_ptr<EventQueue> queue;
+
+    // Picks the miner finding the next share in the aggregated engine
+    std::unique_ptr<WeightedSampler> sampler;
+
+    // Pools whose rounds are generated at once in the fast forward engine
+    std::vector<std::unique_ptr<FastForwardPool>> fast_forward_pools;
 
     // Pools in the current simulation
     std::vector<std::shared_ptr<MiningPool>> pools;
 
-    // Miners in the current simulation
-    std::map<std::string, std::shared_ptr<Miner>> miners;
+    // Miners in the current simulation, indexed by miner id
+    std::vector<std::shared_ptr<Miner>> miners;
+
+    // Number of miners added to the simulation
+    size_t miners_count = 0;
+
+    // Ids of the miners sorted by address, the order in which the miners are
+    // scheduled and written, as when they were stored by address
+    std::vector<uint32_t> miner_ids_by_address;
+    bool miners_sorted = true;
+
+    // Duration of the simulation, including the runs before the last checkpoint
+    int64_t duration = 0;
+
+    // Whether the engine has been set up, either by run() or load_checkpoint()
+    bool started = false;
+
+    // Sets up the data structures of the engine
+    // The first shares are only drawn when `schedule` is true, as they
+    // are part of the state restored from a checkpoint otherwise
+    void start_engine(bool schedule);
+
+    // Runs the engine until the given block or until a checkpoint is requested
+    void run_until(uint64_t stop_block, bool interruptible);
+
+    // Creates the fast forwarded pools and returns which miners they contain
+    std::vector<bool> create_fast_forward_pools();
+
+    // Returns the index of the pool in the simulation
+    size_t get_pool_index(const std::shared_ptr<MiningPool>& pool) const;
+
+    // Sorts the miner ids by address after miners have been added
+    void sort_miners();
+
+    // Selects the miners written to the output, and disables the metadata
+    // of the share handlers which is not written
+    void select_output_miners();
+
+    // Writes and reads everything which changes while the simulation runs
+    void save_state(CheckpointWriter& writer) const;
+    void load_state(CheckpointReader& reader);
+
+    // Returns the expected number of shares per time unit of the miner
+    double get_share_rate(const std::shared_ptr<Miner>& miner) const;
+
+    // Returns the next uniform drawn for the shares of the miner
+    double next_uniform(const std::shared_ptr<Miner>& miner);
+
+    // Returns the next exponential variate of rate 1 for the shares of the miner
+    double next_exponential(const std::shared_ptr<Miner>& miner);
 
-    // Duration of the simulation
-    int64_t duration;
+    // Draws whether the share found by the miner is a valid block
+    Share draw_share(const std::shared_ptr<Miner>& miner);
 
-    // Outputs the result to a file
-    void output_result(const nlohmann::json& result) const;
+    // Creates a share, moving the network to the next block if it is valid
+    Share create_share(bool is_valid_block);
 };
 
 }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace poolsim {
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread
+// Values are moved in and out of a ring of preallocated slots, the producer
+// only writing `tail` and the consumer only writing `head`
+template <typename T>
+class SpscQueue {
+public:
+  // The capacity is rounded up to a power of two
+  explicit SpscQueue(size_t capacity);
+
+  SpscQueue(SpscQueue const&) = delete;
+  void operator=(SpscQueue const&) = delete;
+
+  // Moves the value into the queue, returns false if the queue is full
+  // Must only be called by the producer
+  bool try_push(T& value);
+
+  // Moves the oldest value out of the queue, returns false if the queue is empty
+  // Must only be called by the consumer
+  bool try_pop(T& value);
+
+  // Returns whether the queue is empty, as seen from the calling thread
+  bool is_empty() const;
+
+  size_t capacity() const;
+
+private:
+  std::vector<T> slots;
+  size_t mask;
+  // head and tail are on separate cache lines, so that the two threads
+  // do not invalidate each other's line on every operation
+  char head_padding[64];
+  // index of the next value to pop, only ever increases
+  std::atomic<size_t> head;
+  char tail_padding[64];
+  // index of the next value to push, only ever increases
+  std::atomic<size_t> tail;
+  char end_padding[64];
+};
+
+template <typename T>
+SpscQueue<T>::SpscQueue(size_t capacity) : head(0), tail(0) {
+  size_t size = 1;
+  while (size < capacity) {
+    size *= 2;
+  }
+  slots.resize(size);
+  mask = size - 1;
+}
+
+template <typename T>
+bool SpscQueue<T>::try_push(T& value) {
+  size_t current_tail = tail.load(std::memory_order_relaxed);
+  if (current_tail - head.load(std::memory_order_acquire) == slots.size()) {
+    return false;
+  }
+  slots[current_tail & mask] = std::move(value);
+  tail.store(current_tail + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool SpscQueue<T>::try_pop(T& value) {
+  size_t current_head = head.load(std::memory_order_relaxed);
+  if (current_head == tail.load(std::memory_order_acquire)) {
+    return false;
+  }
+  value = std::move(slots[current_head & mask]);
+  head.store(current_head + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+bool SpscQueue<T>::is_empty() const {
+  return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t SpscQueue<T>::capacity() const {
+  return slots.size();
+}
+
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cmath>
+
+#include "codec.h"
+#include "summary.h"
+
+namespace poolsim {
+
+void LuckDistribution::add(double luck) {
+  min = count == 0 ? luck : std::min(min, luck);
+  max = count == 0 ? luck : std::max(max, luck);
+  count++;
+  double delta = luck - mean;
+  mean += delta / count;
+  m2 += delta * (luck - mean);
+  size_t bin = luck > 0 ? static_cast<size_t>(luck / luck_bin_width) : 0;
+  histogram[std::min(bin, luck_bins - 1)]++;
+}
+
+uint64_t LuckDistribution::get_count() const {
+  return count;
+}
+
+double LuckDistribution::get_mean() const {
+  return mean;
+}
+
+double LuckDistribution::get_stddev() const {
+  if (count < 2) {
+    return 0;
+  }
+  return std::sqrt(m2 / (count - 1));
+}
+
+double LuckDistribution::get_min() const {
+  return min;
+}
+
+double LuckDistribution::get_max() const {
+  return max;
+}
+
+const std::vector<uint64_t>& LuckDistribution::get_histogram() const {
+  return histogram;
+}
+
+void LuckDistribution::save(CheckpointWriter& writer) const {
+  writer.write(count);
+  writer.write(mean);
+  writer.write(m2);
+  writer.write(min);
+  writer.write(max);
+  writer.write(histogram);
+}
+
+void LuckDistribution::load(CheckpointReader& reader) {
+  reader.read(count);
+  reader.read(mean);
+  reader.read(m2);
+  reader.read(min);
+  reader.read(max);
+  reader.read(histogram);
+}
+
+void write(JsonWriter& writer, const LuckDistribution& distribution) {
+  writer.begin_object();
+  writer.key("histogram");
+  writer.begin_object();
+  writer.field("bin_width", luck_bin_width);
+  writer.field("counts", distribution.get_histogram());
+  writer.end_object();
+  writer.field("max", distribution.get_max());
+  writer.field("mean", distribution.get_mean());
+  writer.field("min", distribution.get_min());
+  writer.field("rounds", distribution.get_count());
+  writer.field("stddev", distribution.get_stddev());
+  writer.end_object();
+}
+
+
+void write(JsonWriter& writer, const BehaviorSummary& summary) {
+  writer.begin_object();
+  writer.field("behavior", summary.behavior);
+  writer.field("blocks_mined", summary.blocks_mined);
+  writer.field("blocks_ratio", get_ratio(summary.blocks_received, summary.blocks_mined));
+  writer.field("blocks_received", summary.blocks_received);
+  writer.field("hashrate", summary.hashrate);
+  writer.field("miners", summary.miners);
+  writer.field("total_work", summary.total_work);
+  writer.field("work_per_block", get_ratio(summary.total_work, summary.blocks_received));
+  writer.end_object();
+}
+
+nlohmann::json PoolSummary::get_luck() const {
+  return get_ratio(100.0 * blocks_mined * expected_shares, shares_count);
+}
+
+void write(JsonWriter& writer, const PoolSummary& summary) {
+  writer.begin_object();
+  writer.field("blocks_mined", summary.blocks_mined);
+  writer.field("difficulty", summary.difficulty);
+  writer.field("luck", summary.get_luck());
+  writer.key("luck_distribution");
+  write(writer, summary.luck_distribution);
+  writer.field("name", summary.name);
+  writer.field("reward_scheme", summary.reward_scheme);
+  writer.field("shares_count", summary.shares_count);
+  writer.field("work", (double) summary.shares_count * summary.difficulty);
+  writer.end_object();
+}
+
+nlohmann::json get_ratio(double numerator, double denominator) {
+  return denominator > 0 ? nlohmann::json(numerator / denominator) : nlohmann::json(nullptr);
+}
+
+std::string get_summary_path(const std::string& output) {
+  return replace_extensions(output, ".summary.json");
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "json_writer.h"
+
+namespace poolsim {
+
+// Width of the bins of the luck histograms, in percent
+const double luck_bin_width = 10;
+// Number of bins of the luck histograms, the last one also counting the higher lucks
+const size_t luck_bins = 31;
+
+// Distribution of the luck of the rounds of a pool, i.e. the expected
+// over the actual number of shares until a block, in percent
+class LuckDistribution {
+public:
+  void add(double luck);
+
+  // Returns the number of rounds
+  uint64_t get_count() const;
+  double get_mean() const;
+  // sample standard deviation
+  double get_stddev() const;
+  double get_min() const;
+  double get_max() const;
+
+  // Returns the number of rounds in each bin of `luck_bin_width` percent
+  const std::vector<uint64_t>& get_histogram() const;
+
+  void save(CheckpointWriter& writer) const;
+  void load(CheckpointReader& reader);
+
+private:
+  uint64_t count = 0;
+  double mean = 0;
+  double m2 = 0;
+  double min = 0;
+  double max = 0;
+  std::vector<uint64_t> histogram = std::vector<uint64_t>(luck_bins, 0);
+};
+
+void write(JsonWriter& writer, const LuckDistribution& distribution);
+
+
+// Totals of the miners with the same behavior
+struct BehaviorSummary {
+  std::string behavior;
+  uint64_t miners = 0;
+  double hashrate = 0;
+  uint64_t blocks_mined = 0;
+  double blocks_received = 0;
+  uint64_t total_work = 0;
+};
+
+// writes the totals with the ratio of blocks received over mined and the work per block
+void write(JsonWriter& writer, const BehaviorSummary& summary);
+
+// Blocks, shares and luck of a pool
+struct PoolSummary {
+  std::string name;
+  std::string reward_scheme;
+  uint64_t difficulty = 0;
+  uint64_t blocks_mined = 0;
+  uint64_t shares_count = 0;
+  // expected number of shares per block
+  double expected_shares = 0;
+  LuckDistribution luck_distribution;
+
+  // Returns the expected over the actual number of shares per block, in percent,
+  // or null when no share was submitted
+  nlohmann::json get_luck() const;
+};
+
+void write(JsonWriter& writer, const PoolSummary& summary);
+
+// Returns the ratio, or null when the denominator is zero
+nlohmann::json get_ratio(double numerator, double denominator);
+
+// Returns the path of the summary written next to the output,
+// with the extensions of the output replaced by .summary.json
+std::string get_summary_path(const std::string& output);
+
+}
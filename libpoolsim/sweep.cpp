@@ -0,0 +1,150 @@
+#include <future>
+#include <map>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#include "sweep.h"
+#include "simulator.h"
+#include "thread_pool.h"
+#include "random.h"
+#include "replicas.h"
+
+namespace poolsim {
+
+using nlohmann::json;
+
+
+std::vector<SweepPoint> expand_sweep(const Simulation& simulation) {
+  json base_config = simulation.config;
+  base_config.erase("sweep");
+
+  size_t points_count = 1;
+  for (const SweepAxis& axis : simulation.sweep) {
+    try {
+      base_config.at(json::json_pointer(axis.path));
+    } catch (const json::exception& e) {
+      throw std::invalid_argument("sweep path " + axis.path + " not found in the config");
+    }
+    points_count *= axis.values.size();
+  }
+
+  std::vector<SweepPoint> points;
+  for (size_t index = 0; index < points_count; index++) {
+    json config = base_config;
+    json parameters = json::object();
+    size_t remaining = index;
+    for (size_t i = simulation.sweep.size(); i-- > 0;) {
+      const SweepAxis& axis = simulation.sweep[i];
+      const json& value = axis.values[remaining % axis.values.size()];
+      remaining /= axis.values.size();
+      config[json::json_pointer(axis.path)] = value;
+      parameters[axis.path] = value;
+    }
+    points.push_back(SweepPoint {index, parameters, config.get<Simulation>()});
+  }
+  return points;
+}
+
+
+SweepRunner::SweepRunner(const Simulation& _simulation, size_t _threads)
+  : simulation(_simulation), threads(_threads) {}
+
+void SweepRunner::run() {
+  points = expand_sweep(simulation);
+
+  // populations only depend on the config of the miners of all the pools,
+  // which draw from the same random one after the other, and on the seed and
+  // the random generator, so points sharing those reuse the same population
+  std::map<std::string, std::shared_ptr<const MinerPopulation>> populations;
+  std::vector<std::shared_ptr<const MinerPopulation>> point_populations;
+  for (const SweepPoint& point : points) {
+    const Simulation& point_simulation = point.simulation;
+    json miners = json::array();
+    for (const json& pool : point_simulation.config["pools"]) {
+      miners.push_back(pool["miners"]);
+    }
+    json key = {point_simulation.seed, point_simulation.rng, miners};
+    auto it = populations.find(key.dump());
+    if (it == populations.end()) {
+      auto population = std::make_shared<const MinerPopulation>(Simulator::create_population(point_simulation));
+      it = populations.emplace(key.dump(), population).first;
+    }
+    point_populations.push_back(it->second);
+  }
+  populations_count = populations.size();
+
+  spdlog::info("running {} sweep points with {} populations on {} threads",
+               points.size(), populations_count, threads);
+
+  std::vector<std::future<json>> futures;
+  {
+    ThreadPool pool(threads);
+    for (size_t i = 0; i < points.size(); i++) {
+      futures.push_back(pool.submit([this, i, &point_populations]() {
+        return run_point(points[i], point_populations[i]);
+      }));
+    }
+  }
+
+  results.clear();
+  for (auto& future : futures) {
+    results.push_back(future.get());
+  }
+}
+
+json SweepRunner::run_point(const SweepPoint& point, std::shared_ptr<const MinerPopulation> population) const {
+  Simulation point_simulation = point.simulation;
+  // points are not resumable, as their miners are not created from their config
+  point_simulation.checkpoint_path.clear();
+  if (!point_simulation.blocks_output.empty()) {
+    point_simulation.blocks_output = ReplicaRunner::get_replica_output(point_simulation.blocks_output, point.index);
+  }
+  // the population leaves the random where a run of the point on its own
+  // would, so that the point gives the same result
+  auto simulator = std::make_shared<Simulator>(
+    point_simulation, RandomFactory::create(point_simulation.rng, point_simulation.seed));
+  simulator->set_population(population);
+  simulator->run();
+  spdlog::debug("sweep point {} done", point.index);
+  // the store of the sweep, which may have been given on the command line,
+  // and its output, which holds the result of the point
+  if (!simulation.store.empty()) {
+    StoredRun run = simulator->get_stored_run();
+    run.parameters = point.parameters;
+    run.output = simulation.output;
+    ResultStore(simulation.store).append(run);
+  }
+  return simulator->get_result();
+}
+
+json SweepRunner::get_output() const {
+  json output;
+  output["axes"] = json::array();
+  for (const SweepAxis& axis : simulation.sweep) {
+    output["axes"].push_back({{"path", axis.path}, {"values", axis.values}});
+  }
+  output["points"] = json::array();
+  for (size_t i = 0; i < results.size(); i++) {
+    output["points"].push_back({
+      {"index", points[i].index},
+      {"parameters", points[i].parameters},
+      {"result", results[i]}
+    });
+  }
+  return output;
+}
+
+void SweepRunner::save_output() const {
+  Simulator::output_result(simulation.output, get_output(), simulation.compression);
+}
+
+const std::vector<SweepPoint>& SweepRunner::get_points() const {
+  return points;
+}
+
+size_t SweepRunner::get_populations_count() const {
+  return populations_count;
+}
+
+}
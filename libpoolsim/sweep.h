@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "simulation.h"
+#include "simulator.h"
+
+namespace poolsim {
+
+// Point of a parameter sweep
+struct SweepPoint {
+  // index of the point in row-major order of the axes
+  size_t index;
+  // value of each axis at this point, keyed by path
+  nlohmann::json parameters;
+  // simulation with the values of the point applied to the config
+  Simulation simulation;
+};
+
+// Returns all the combinations of the values of the sweep axes,
+// the last axis varying the fastest
+std::vector<SweepPoint> expand_sweep(const Simulation& simulation);
+
+
+// Runs every point of a parameter sweep on a work-stealing thread pool
+// The miners are generated once for all the points where the miners config
+// of every pool, the seed and the generator are the same
+// Each point gives the same result as its config run on its own
+class SweepRunner {
+public:
+  SweepRunner(const Simulation& simulation, size_t threads);
+
+  // Runs all the points of the sweep
+  void run();
+
+  // Returns the axes and, for each point, its index, parameters and result
+  nlohmann::json get_output() const;
+
+  // Writes the output to the output of the simulation
+  void save_output() const;
+
+  const std::vector<SweepPoint>& get_points() const;
+
+  // Returns the number of miner populations generated for the sweep
+  size_t get_populations_count() const;
+
+private:
+  Simulation simulation;
+  size_t threads;
+  std::vector<SweepPoint> points;
+  // indexed by point
+  std::vector<nlohmann::json> results;
+  size_t populations_count = 0;
+
+  nlohmann::json run_point(const SweepPoint& point, std::shared_ptr<const MinerPopulation> population) const;
+};
+
+}
@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+
+namespace poolsim {
+
+namespace {
+// pool and index of the worker running on the current thread
+thread_local const void* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads) : next_queue(0) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    queues.emplace_back(new WorkQueue());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const {
+  return workers.size();
+}
+
+void ThreadPool::push(std::function<void()> task) {
+  // tasks submitted by a worker go to its own queue, where they are likely
+  // to be run while their data is still in cache
+  size_t index = current_pool == this ? current_worker : next_queue++ % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending++;
+  }
+  condition.notify_one();
+}
+
+bool ThreadPool::take(size_t worker, std::function<void()>& task) {
+  for (size_t offset = 0; offset < queues.size(); offset++) {
+    WorkQueue& queue = *queues[(worker + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    // the owner takes the newest task, thieves the oldest one
+    if (offset == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::work(size_t worker) {
+  current_pool = this;
+  current_worker = worker;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this]() { return stopping || pending > 0; });
+      if (pending == 0) {
+        return;
+      }
+      // reserves one of the queued tasks
+      pending--;
+    }
+    // tasks are queued before being counted, so there is always one to take
+    std::function<void()> task;
+    if (take(worker, task)) {
+      task();
+    }
+  }
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace poolsim {
+
+// Fixed set of worker threads running the submitted tasks
+// Each worker has its own queue: tasks are spread over the queues, a worker
+// runs the tasks of its own queue first and steals from the others when it is empty,
+// so that long tasks do not leave the other workers idle
+// The destructor waits for all the submitted tasks to complete
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool const&) = delete;
+  void operator=(ThreadPool const&) = delete;
+
+  // Schedules the task and returns a future to its result
+  // Exceptions thrown by the task are rethrown by the future
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> submit(F task);
+
+  // Returns the number of worker threads
+  size_t size() const;
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  // queue receiving the next task submitted from outside of the workers
+  std::atomic<size_t> next_queue;
+
+  // number of queued tasks, guarded by `mutex`
+  size_t pending = 0;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable condition;
+
+  void push(std::function<void()> task);
+  // Takes a task from the queue of the worker, or steals one from another queue
+  bool take(size_t worker, std::function<void()>& task);
+  void work(size_t worker);
+};
+
+template <typename F>
+std::future<typename std::result_of<F()>::type> ThreadPool::submit(F task) {
+  using Result = typename std::result_of<F()>::type;
+  // std::function needs a copyable callable
+  auto packaged = std::make_shared<std::packaged_task<Result()>>(task);
+  auto future = packaged->get_future();
+  push([packaged]() { (*packaged)(); });
+  return future;
+}
+
+}
@@ -0,0 +1,187 @@
+#include <stdexcept>
+
+#include "weighted_sampler.h"
+
+namespace poolsim {
+
+// fallback when rounding makes the search run past the last positive weight
+static size_t last_positive(const std::vector<double>& weights) {
+  size_t index = weights.size();
+  while (index > 0 && weights[index - 1] <= 0) {
+    index--;
+  }
+  if (index == 0) {
+    throw std::logic_error("cannot sample without positive weights");
+  }
+  return index - 1;
+}
+
+
+WeightedSampler::~WeightedSampler() {}
+
+
+AliasTable::AliasTable(const std::vector<double>& _weights)
+  : weights(_weights), probabilities(_weights.size()), aliases(_weights.size()) {
+  for (double weight : weights) {
+    total_weight += weight;
+  }
+}
+
+size_t AliasTable::size() const {
+  return weights.size();
+}
+
+void AliasTable::set_weight(size_t index, double weight) {
+  total_weight += weight - weights[index];
+  weights[index] = weight;
+  dirty = true;
+}
+
+double AliasTable::get_weight(size_t index) const {
+  return weights[index];
+}
+
+double AliasTable::get_total_weight() const {
+  return total_weight;
+}
+
+void AliasTable::build() {
+  size_t n = weights.size();
+  if (n == 0 || total_weight <= 0) {
+    throw std::logic_error("cannot sample without positive weights");
+  }
+
+  std::vector<uint32_t> small, large;
+  for (size_t i = 0; i < n; i++) {
+    probabilities[i] = weights[i] * n / total_weight;
+    aliases[i] = i;
+    if (probabilities[i] < 1) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    uint32_t less = small.back();
+    small.pop_back();
+    uint32_t more = large.back();
+    aliases[less] = more;
+    probabilities[more] -= 1 - probabilities[less];
+    if (probabilities[more] < 1) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+
+  // what is left only differs from 1 because of rounding
+  for (uint32_t i : small) {
+    probabilities[i] = weights[i] > 0 ? 1 : 0;
+    aliases[i] = weights[i] > 0 ? i : last_positive(weights);
+  }
+  for (uint32_t i : large) {
+    probabilities[i] = 1;
+  }
+  dirty = false;
+}
+
+size_t AliasTable::sample(double uniform) {
+  if (dirty) {
+    build();
+  }
+  // the integer part picks the column and the fractional part the side
+  double scaled = uniform * weights.size();
+  size_t column = static_cast<size_t>(scaled);
+  if (column >= weights.size()) {
+    column = weights.size() - 1;
+  }
+  return scaled - column < probabilities[column] ? column : aliases[column];
+}
+
+void AliasTable::save(CheckpointWriter& writer) const {
+  writer.write(weights);
+  writer.write(total_weight);
+}
+
+void AliasTable::load(CheckpointReader& reader) {
+  reader.read(weights);
+  reader.read(total_weight);
+  // the table only depends on the weights and is rebuilt on the next sample
+  probabilities.resize(weights.size());
+  aliases.resize(weights.size());
+  dirty = true;
+}
+
+
+FenwickTree::FenwickTree(const std::vector<double>& _weights)
+  : weights(_weights), tree(_weights.size() + 1, 0) {
+  size_t n = weights.size();
+  for (size_t i = 1; i <= n; i++) {
+    tree[i] += weights[i - 1];
+    size_t parent = i + (i & -i);
+    if (parent <= n) {
+      tree[parent] += tree[i];
+    }
+    total_weight += weights[i - 1];
+  }
+  top_bit = 1;
+  while (top_bit * 2 <= n) {
+    top_bit *= 2;
+  }
+}
+
+size_t FenwickTree::size() const {
+  return weights.size();
+}
+
+void FenwickTree::set_weight(size_t index, double weight) {
+  double delta = weight - weights[index];
+  weights[index] = weight;
+  total_weight += delta;
+  for (size_t i = index + 1; i < tree.size(); i += i & -i) {
+    tree[i] += delta;
+  }
+}
+
+double FenwickTree::get_weight(size_t index) const {
+  return weights[index];
+}
+
+double FenwickTree::get_total_weight() const {
+  return total_weight;
+}
+
+size_t FenwickTree::sample(double uniform) {
+  // descend the implicit tree to the first index whose prefix sum
+  // is greater than the target
+  double target = uniform * total_weight;
+  size_t position = 0;
+  for (size_t step = top_bit; step > 0; step >>= 1) {
+    size_t next = position + step;
+    if (next < tree.size() && tree[next] <= target) {
+      position = next;
+      target -= tree[next];
+    }
+  }
+  if (position >= weights.size() || weights[position] <= 0) {
+    return last_positive(weights);
+  }
+  return position;
+}
+
+void FenwickTree::save(CheckpointWriter& writer) const {
+  writer.write(weights);
+  writer.write(tree);
+  writer.write(total_weight);
+}
+
+void FenwickTree::load(CheckpointReader& reader) {
+  reader.read(weights);
+  reader.read(tree);
+  reader.read(total_weight);
+  if (tree.size() != weights.size() + 1) {
+    throw std::invalid_argument("invalid sampler in checkpoint");
+  }
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "checkpoint.h"
+
+namespace poolsim {
+
+// Draws an index with probability proportional to its weight
+// Used by the aggregated engine to pick which miner found a share
+class WeightedSampler {
+public:
+  virtual ~WeightedSampler();
+
+  // Returns the number of indices that can be sampled
+  virtual size_t size() const = 0;
+
+  // Sets the weight of the given index
+  virtual void set_weight(size_t index, double weight) = 0;
+
+  // Returns the weight of the given index
+  virtual double get_weight(size_t index) const = 0;
+
+  // Returns the sum of all the weights
+  virtual double get_total_weight() const = 0;
+
+  // Returns an index given a uniform number in [0, 1)
+  virtual size_t sample(double uniform) = 0;
+
+  // Writes the weights to a checkpoint, as they are, so that
+  // no rounding differs from the sampler which was saved
+  virtual void save(CheckpointWriter& writer) const = 0;
+
+  // Restores the state written by save()
+  virtual void load(CheckpointReader& reader) = 0;
+};
+
+
+// Walker's alias method, O(1) sampling with a single uniform
+// Changing a weight invalidates the table, which is rebuilt in O(n)
+// on the next sample, so this should be used for static weights
+class AliasTable : public WeightedSampler {
+public:
+  explicit AliasTable(const std::vector<double>& weights);
+
+  size_t size() const override;
+  void set_weight(size_t index, double weight) override;
+  double get_weight(size_t index) const override;
+  double get_total_weight() const override;
+  size_t sample(double uniform) override;
+  void save(CheckpointWriter& writer) const override;
+  void load(CheckpointReader& reader) override;
+private:
+  std::vector<double> weights;
+  // probability of keeping the index drawn for each column
+  std::vector<double> probabilities;
+  // index to use for the rest of each column
+  std::vector<uint32_t> aliases;
+  double total_weight = 0;
+  bool dirty = true;
+
+  void build();
+};
+
+
+// Fenwick (binary indexed) tree of weights
+// O(log n) sampling and weight updates, used when miners can change pool
+class FenwickTree : public WeightedSampler {
+public:
+  explicit FenwickTree(const std::vector<double>& weights);
+
+  size_t size() const override;
+  void set_weight(size_t index, double weight) override;
+  double get_weight(size_t index) const override;
+  double get_total_weight() const override;
+  size_t sample(double uniform) override;
+  void save(CheckpointWriter& writer) const override;
+  void load(CheckpointReader& reader) override;
+private:
+  std::vector<double> weights;
+  // 1-based tree, tree[i] holds the sum of weights in (i - lowbit(i), i]
+  std::vector<double> tree;
+  double total_weight = 0;
+  // highest power of two not greater than the size
+  size_t top_bit = 0;
+};
+
+}
@@ -11,10 +11,38 @@
 #include "random.h"
 #include "reward_scheme.h"
 #include "miner_record.h"
+#include "weighted_sampler.h"
+#include "replicas.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "fast_math.h"
+#include "spsc_queue.h"
+#include "columnar.h"
+#include "codec.h"
+#include "json_writer.h"
+#include "summary.h"
+#include "result_index.h"
+#include "result_store.h"
+#include "pplns_window.h"
+#include "credit_ranking.h"
+#include <algorithm>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <vector>
 #include <iterator>
+#include <map>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <thread>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 
 using namespace poolsim;
@@ -147,6 +175,7 @@ public:
 
 class MockShareHandler : public ShareHandler {
 public:
+    MockShareHandler() : ShareHandler(std::make_shared<MockRandom>()) {}
     MOCK_METHOD1(handle_share, void(const Share&));
     MOCK_METHOD0(get_json_metadata, nlohmann::json());
     std::string get_name() const override { return "mock"; }
@@ -155,12 +184,13 @@ public:
 
 class MockRewardScheme : public RewardScheme {
 public:
-    MOCK_METHOD2(handle_share, void(const std::string&, const Share&));
-    MOCK_METHOD0(get_json_metadata, nlohmann::json());
-    MOCK_METHOD1(get_miner_metadata, nlohmann::json (const std::string&));
+    using RewardScheme::handle_share;
+    MOCK_METHOD2(handle_share, void(uint32_t, const Share&));
+    MOCK_CONST_METHOD0(get_block_data, BlockSchemeData());
+    MOCK_CONST_METHOD2(export_records, void(const std::vector<uint32_t>&, const RecordCallback&));
     MOCK_METHOD1(get_blocks_mined, uint64_t (const std::string&));
     MOCK_METHOD1(get_blocks_received, double (const std::string&));
-    MOCK_METHOD1(handle_uncle, void(const std::string& miner_address));
+    MOCK_METHOD1(handle_uncle, void(uint32_t miner_id));
     MOCK_METHOD1(get_record, std::shared_ptr<MinerRecord> (const std::string&));
     std::string get_scheme_name() const override { return "mock"; }
 };
@@ -176,12 +206,16 @@ std::shared_ptr<Network> get_sample_network() {
     return std::make_shared<Network>(100);
 }
 
+std::shared_ptr<Random> get_sample_random() {
+    return RandomFactory::create("drand48", 0);
+}
+
 std::shared_ptr<Simulator> get_sample_simulator(std::shared_ptr<Random> random) {
     return std::make_shared<Simulator>(get_sample_simulation(), random);
 }
 
 std::shared_ptr<Simulator> get_sample_simulator() {
-    return std::make_shared<Simulator>(get_sample_simulation());
+    return get_sample_simulator(get_sample_random());
 }
 
 std::unique_ptr<MockShareHandler> get_mock_share_handler() {
@@ -202,50 +236,43 @@ std::unique_ptr<MockRewardScheme> get_mock_reward_scheme() {
 }
 
 
-// XXX: this should be at te top of the test suite
-// because it expects SystemRandom not to be initialized
-// and it performs the initialization
-// if we someday need to parallelize the test suite we can think
-// about how to make this less ugly but for now it should work just fine
-TEST(SystemRandom, initialization) {
-    ASSERT_THROW(SystemRandom::get_instance(), RandomInitException);
-    SystemRandom::initialize(0);
-    ASSERT_NO_THROW(SystemRandom::get_instance());
+TEST(SystemRandom, seed) {
     // NOTE: expected value with seed = 0
-    ASSERT_FLOAT_EQ(SystemRandom::get_instance()->drand48(), 0.170828);
+    ASSERT_FLOAT_EQ(get_sample_random()->drand48(), 0.170828);
 }
 
 TEST(SystemRandom, get_address) {
-    auto address = SystemRandom::get_instance()->get_address();
+    auto address = get_sample_random()->get_address();
     ASSERT_EQ(address.size(), 42);
     ASSERT_THAT(address, testing::MatchesRegex("0x[0-9a-f]{40}"));
 }
 
 TEST(Random, random_element) {
+    auto random = get_sample_random();
     std::vector<std::shared_ptr<MinerRecord>> records;
     for (size_t i = 0; i < 3; i++) {
-        std::shared_ptr<MinerRecord> record = std::make_shared<MinerRecord>("SomeMiner_"+std::to_string(1));
+        std::shared_ptr<MinerRecord> record = std::make_shared<MinerRecord>(i, "SomeMiner_"+std::to_string(1));
         record->inc_blocks_received(i);
         records.push_back(record);
     }
 
-    std::shared_ptr<MinerRecord> s = SystemRandom::get_instance()->random_element(records.begin(), records.end());
+    std::shared_ptr<MinerRecord> s = random->random_element(records.begin(), records.end());
     ASSERT_TRUE(IsBetweenInclusive(s->get_blocks_received(),0,2));
-    s = SystemRandom::get_instance()->random_element(records.begin(), records.end());
+    s = random->random_element(records.begin(), records.end());
     ASSERT_TRUE(IsBetweenInclusive(s->get_blocks_received(),0,2));
-    s = SystemRandom::get_instance()->random_element(records.begin(), records.end());
+    s = random->random_element(records.begin(), records.end());
     ASSERT_TRUE(IsBetweenInclusive(s->get_blocks_received(),0,2));
     records.clear();
 
     for (size_t i = 0; i < 200; i++) {
-        std::shared_ptr<MinerRecord> record = std::make_shared<MinerRecord>("SomeMiner_"+std::to_string(1));
+        std::shared_ptr<MinerRecord> record = std::make_shared<MinerRecord>(i, "SomeMiner_"+std::to_string(1));
         record->inc_blocks_received(i);
         records.push_back(record);
     }
 
-    s = SystemRandom::get_instance()->random_element(records.begin(), records.end());
+    s = random->random_element(records.begin(), records.end());
     ASSERT_TRUE(IsBetweenInclusive(s->get_blocks_received(),0,200));
-    s = SystemRandom::get_instance()->random_element(records.begin(), records.end());
+    s = random->random_element(records.begin(), records.end());
     ASSERT_TRUE(IsBetweenInclusive(s->get_blocks_received(),0,200));
 }
 
@@ -285,8 +312,10 @@ TEST(Network, setters_getters) {
     auto network = std::make_shared<Network>(1000);
     ASSERT_EQ(network->get_difficulty(), 1000);
     ASSERT_EQ(network->get_pools().size(), 0);
-    auto pool1 = MiningPool::create("pool1", 100, 0.001, get_mock_reward_scheme(), network);
-    auto pool2 = MiningPool::create("pool2", 100, 0.001, get_mock_reward_scheme(), network);
+    auto pool1 = MiningPool::create("pool1", 100, 0.001, get_mock_reward_scheme(),
+                                    network, get_sample_random());
+    auto pool2 = MiningPool::create("pool2", 100, 0.001, get_mock_reward_scheme(),
+                                    network, get_sample_random());
     network->register_pool(pool1);
     network->register_pool(pool2);
     ASSERT_EQ(pool1->get_network()->get_difficulty(), 1000);
@@ -309,7 +338,8 @@ TEST(RewardScheme, get_pool_luck) {
 
     auto pool = simulation.pools[0];
     auto network = std::make_shared<Network>(simulation.network_difficulty);
-    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(qb_ptr), network);
+    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(qb_ptr),
+                                          network, get_sample_random());
 
     ASSERT_EQ(mining_pool->get_network()->get_difficulty(), 1000);
     ASSERT_EQ(mining_pool->get_difficulty(), 100);
@@ -348,8 +378,10 @@ TEST(Miner, getters) {
 
 TEST(Miner, join_pool) {
     auto miner = Miner::create("random_address", 123, get_mock_share_handler(), get_sample_network());
-    auto pool1 = MiningPool::create("pool1", 100, 0.001, get_mock_reward_scheme(), get_sample_network());
-    auto pool2 = MiningPool::create("pool2", 100, 0.001, get_mock_reward_scheme(), get_sample_network());
+    auto pool1 = MiningPool::create("pool1", 100, 0.001, get_mock_reward_scheme(),
+                                    get_sample_network(), get_sample_random());
+    auto pool2 = MiningPool::create("pool2", 100, 0.001, get_mock_reward_scheme(),
+                                    get_sample_network(), get_sample_random());
     ASSERT_EQ(miner->get_pool(), nullptr);
     ASSERT_EQ(pool1->get_miners_count(), 0);
     ASSERT_EQ(pool2->get_miners_count(), 0);
@@ -370,7 +402,8 @@ TEST(Miner, handle_share) {
     MockShareHandler* share_handler_ptr = share_handler.get();
     auto network = get_sample_network();
     auto miner = Miner::create("random_address", 123, std::move(share_handler), network);
-    auto pool = MiningPool::create("pool", 100, 0.001, get_mock_reward_scheme(), get_sample_network());
+    auto pool = MiningPool::create("pool", 100, 0.001, get_mock_reward_scheme(),
+                                   get_sample_network(), get_sample_random());
     miner->join_pool(pool);
     Share share(Share::Property::none);
     EXPECT_CALL(*share_handler_ptr, handle_share(share));
@@ -397,18 +430,66 @@ TEST(MiningPool, submit_share) {
     auto random = std::make_shared<MockRandom>();
     MockRewardScheme* reward_scheme_ptr = reward_scheme.get();
 
-    auto pool = MiningPool::create("pool", 100, 0.3, std::move(reward_scheme), get_sample_network(), random);
+    auto network = get_sample_network();
+    auto pool = MiningPool::create("pool", 100, 0.3, std::move(reward_scheme), network, random);
+    uint32_t miner_id = network->get_miner_id("address");
 
-    EXPECT_CALL(*reward_scheme_ptr, handle_share("address", Share(Share::Property::none)));
-    pool->submit_share("address", Share(Share::Property::none));
+    EXPECT_CALL(*reward_scheme_ptr, handle_share(miner_id, Share(Share::Property::none)));
+    pool->submit_share(miner_id, Share(Share::Property::none));
 
     EXPECT_CALL(*random, drand48()).WillOnce(testing::Return(0.5));
-    EXPECT_CALL(*reward_scheme_ptr, handle_share("address", Share(Share::Property::valid_block)));
-    pool->submit_share("address", Share(Share::Property::valid_block));
+    EXPECT_CALL(*reward_scheme_ptr, handle_share(miner_id, Share(Share::Property::valid_block)));
+    pool->submit_share(miner_id, Share(Share::Property::valid_block));
 
     EXPECT_CALL(*random, drand48()).WillOnce(testing::Return(0.2));
-    EXPECT_CALL(*reward_scheme_ptr, handle_share("address", Share(Share::Property::valid_block | Share::Property::uncle)));
-    pool->submit_share("address", Share(Share::Property::valid_block));
+    EXPECT_CALL(*reward_scheme_ptr, handle_share(miner_id, Share(Share::Property::valid_block | Share::Property::uncle)));
+    pool->submit_share(miner_id, Share(Share::Property::valid_block));
+}
+
+class BlockEventRecorder : public Observer<BlockEvent> {
+public:
+    void process(const BlockEvent& block_event) override { block_events.push_back(block_event); }
+    std::vector<BlockEvent> block_events;
+};
+
+TEST(MiningPool, block_events) {
+    auto reward_scheme = get_mock_reward_scheme();
+    auto random = std::make_shared<MockRandom>();
+    MockRewardScheme* reward_scheme_ptr = reward_scheme.get();
+
+    auto network = get_sample_network();
+    auto pool = MiningPool::create("pool", 100, 0.3, std::move(reward_scheme), network, random);
+    network->register_pool(MiningPool::create("other", 100, 0.3, get_mock_reward_scheme(), network, random));
+    network->register_pool(pool);
+    uint32_t miner_id = network->get_miner_id("address");
+
+    // the metadata is not built when no one records the blocks
+    EXPECT_CALL(*random, drand48()).WillRepeatedly(testing::Return(0.5));
+    EXPECT_CALL(*reward_scheme_ptr, handle_share(miner_id, testing::_));
+    EXPECT_CALL(*reward_scheme_ptr, get_block_data()).Times(0);
+    pool->submit_share(miner_id, Share(Share::Property::valid_block));
+    testing::Mock::VerifyAndClearExpectations(reward_scheme_ptr);
+
+    auto recorder = std::make_shared<BlockEventRecorder>();
+    pool->add_observer(recorder);
+    QBBlockMetaData metadata;
+    metadata.shares_per_block = 12;
+    metadata.receiver_id = miner_id;
+    EXPECT_CALL(*reward_scheme_ptr, handle_share(miner_id, testing::_));
+    EXPECT_CALL(*reward_scheme_ptr, get_block_data()).WillOnce(testing::Return(BlockSchemeData(metadata)));
+    pool->submit_share(miner_id, Share(Share::Property::valid_block));
+    ASSERT_EQ(recorder->block_events.size(), 1);
+    auto& block_event = recorder->block_events[0];
+    ASSERT_EQ(block_event.pool_id, 1);
+    ASSERT_EQ(block_event.miner_id, miner_id);
+    ASSERT_EQ(block_event.scheme_data.type, BlockSchemeData::Type::qb);
+
+    nlohmann::json block_json;
+    to_json(block_json, block_event, *network);
+    ASSERT_EQ(block_json["pool_name"], "pool");
+    ASSERT_EQ(block_json["miner_address"], "address");
+    ASSERT_EQ(block_json["reward_scheme_data"]["shares_per_block"], 12);
+    ASSERT_EQ(block_json["reward_scheme_data"]["receiver_address"], "address");
 }
 
 TEST(QBRewardScheme, update_record) {
@@ -425,7 +506,8 @@ TEST(QBRewardScheme, update_record) {
     
     auto pool = simulation.pools[0];
     auto network = std::make_shared<Network>(simulation.network_difficulty);
-    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(qb_ptr), network);
+    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(qb_ptr),
+                                          network, get_sample_random());
 
     qb->handle_share("address_A", Share(Share::Property::none));
     qb->handle_share("address_B", Share(Share::Property::none));
@@ -453,6 +535,260 @@ TEST(QBRewardScheme, update_record) {
 
     qb->handle_share("address_B", Share(Share::Property::uncle));
     ASSERT_EQ(qb->get_credits("address_B"), 500);
+
+    // the records sorted by the payouts are still found by miner id
+    const RecordStore& store = mining_pool->get_record_store<QBRewardScheme>();
+    ASSERT_EQ(&store, &qb->get_record_store());
+    ASSERT_EQ(store.size(), 3);
+    for (uint32_t slot = 0; slot < store.size(); slot++) {
+        ASSERT_EQ(qb->get_credits(network->get_miner_address(store.miner_ids[slot])), store.credits[slot]);
+    }
+    // the view follows the records added afterwards, unlike a copy
+    auto records = qb->copy_records();
+    qb->handle_share("address_D", Share(Share::Property::none));
+    ASSERT_EQ(store.size(), 4);
+    ASSERT_EQ(records.size(), 3);
+}
+
+TEST(RecordStore, views) {
+    RecordStore store;
+    RecordView first(store, store.add(7));
+    first.inc_shares_count(3);
+    first.inc_blocks_received(0.5);
+    first.set_credits(200);
+    // the view stays valid as records are added
+    RecordView second(store, store.add(2));
+    for (int i = 0; i < 100; i++) {
+        store.add(100 + i);
+    }
+    second.inc_blocks_mined();
+    first.inc_credits(100);
+    ASSERT_EQ(store.size(), 102);
+    ASSERT_EQ(store.shares_count[0], 3);
+    ASSERT_EQ(store.credits[0], 300);
+    ASSERT_EQ(second.get_miner_id(), 2);
+    ASSERT_EQ(second.get_blocks_mined(), 1);
+
+    QBRecord record(store, first.get_slot(), "miner_A");
+    ASSERT_EQ(record.get_miner_id(), 7);
+    ASSERT_EQ(record.get_miner_address(), "miner_A");
+    ASSERT_EQ(record.get_shares_count(), 3);
+    ASSERT_FLOAT_EQ(record.get_blocks_received(), 0.5);
+    ASSERT_EQ(record.get_credits(), 300);
+
+    std::stringstream stream;
+    CheckpointWriter writer(stream);
+    store.save(writer);
+    RecordStore loaded;
+    CheckpointReader reader(stream);
+    loaded.load(reader);
+    ASSERT_EQ(loaded.miner_ids, store.miner_ids);
+    ASSERT_EQ(loaded.credits, store.credits);
+    ASSERT_EQ(loaded.blocks_received, store.blocks_received);
+}
+
+TEST(CreditRanking, ranks) {
+    CreditRanking ranking;
+    std::map<uint32_t, uint64_t> credits;
+    std::mt19937 generator(42);
+    for (int i = 0; i < 2000; i++) {
+        // few distinct balances so that many miners are tied
+        uint32_t miner_id = generator() % 100;
+        uint64_t balance = (generator() % 20) * 100;
+        ranking.set_credits(miner_id, balance);
+        credits[miner_id] = balance;
+    }
+
+    // sorted by credits, then by id
+    std::vector<uint32_t> expected;
+    uint64_t credits_sum = 0;
+    for (auto& miner : credits) {
+        expected.push_back(miner.first);
+        credits_sum += miner.second;
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&credits](uint32_t a, uint32_t b) {
+        return credits[a] > credits[b];
+    });
+
+    ASSERT_EQ(ranking.size(), expected.size());
+    ASSERT_EQ(ranking.get_credits_sum(), credits_sum);
+    ASSERT_EQ(ranking.top_n(10), std::vector<uint32_t>(expected.begin(), expected.begin() + 10));
+    ASSERT_EQ(ranking.top_n(1000), expected);
+    for (size_t rank = 0; rank < expected.size(); rank++) {
+        ASSERT_EQ(ranking.at(rank), expected[rank]);
+        ASSERT_EQ(ranking.rank_of(expected[rank]), rank);
+        ASSERT_EQ(ranking.get_credits(expected[rank]), credits[expected[rank]]);
+        uint32_t successor = rank + 1 < expected.size() ? expected[rank + 1] : invalid_miner_id;
+        ASSERT_EQ(ranking.successor_of(expected[rank]), successor);
+    }
+    ASSERT_EQ(ranking.rank_of(500), ranking.size());
+    ASSERT_EQ(ranking.successor_of(500), invalid_miner_id);
+    ASSERT_THROW(ranking.at(ranking.size()), std::out_of_range);
+}
+
+// QB pool of difficulty 100 on a network of difficulty 1000,
+// so that each share gives 100 credits and a block is expected every 10 shares
+std::shared_ptr<MiningPool> create_qb_pool(const std::string& name, std::shared_ptr<Network> network) {
+    auto pool = MiningPool::create(name, 100, 0, RewardSchemeFactory::create("qb", nlohmann::json::object()),
+                                   network, std::make_shared<SystemRandom>(1));
+    network->register_pool(pool);
+    return pool;
+}
+
+std::shared_ptr<Miner> create_qb_miner(const std::string& address, const std::string& behavior,
+                                       const nlohmann::json& params, std::shared_ptr<MiningPool> pool) {
+    auto share_handler = ShareHandlerFactory::create(behavior, params, std::make_shared<SystemRandom>(2));
+    share_handler->initialize();
+    auto miner = Miner::create(address, 10, std::move(share_handler), pool->get_network());
+    miner->join_pool(pool);
+    return miner;
+}
+
+// Victim of a QB handler as it was found before the credit ranking, scanning
+// the records sorted by credits, with ties broken by id as in the ranking
+uint32_t find_victim_by_sort(const std::map<uint32_t, uint64_t>& credits, uint32_t miner_id,
+                             uint64_t top_n, double threshold) {
+    std::vector<std::pair<uint32_t, uint64_t>> records(credits.begin(), credits.end());
+    std::stable_sort(records.begin(), records.end(),
+                     [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+        return a.second > b.second;
+    });
+    for (size_t i = 0; i + 1 < records.size() && i < top_n; i++) {
+        if (records[i].first == miner_id && records[i].second * threshold <= records[i + 1].second) {
+            return records[i + 1].first;
+        }
+    }
+    return invalid_miner_id;
+}
+
+TEST(QBShareHandler, victims) {
+    std::mt19937 generator(7);
+    std::map<std::string, size_t> attacks, skipped;
+    for (const std::string& behavior : {"share_donation", "qb_share_withholding", "multiple_addresses"}) {
+        for (int run = 0; run < 200; run++) {
+            auto network = std::make_shared<Network>(1000);
+            auto pool = create_qb_pool("pool", network);
+            uint64_t top_n = 1 + generator() % 4;
+            double threshold = std::vector<double>{0.5, 0.75, 1}[generator() % 3];
+            nlohmann::json params = {{"top_n", top_n}, {"threshold", threshold}, {"addresses", 2}};
+            auto attacker = create_qb_miner("attacker", behavior, params, pool);
+
+            // few shares per miner, so that many credits are tied, some miners not being ranked at all
+            std::vector<uint32_t> miner_ids = {attacker->get_id()};
+            for (const std::string& address : std::vector<std::string>{"b", "c", "d", "e", "f"}) {
+                miner_ids.push_back(network->get_miner_id(address));
+            }
+            for (uint32_t miner_id : miner_ids) {
+                for (uint32_t share = generator() % 4; share > 0; share--) {
+                    pool->submit_share(miner_id, Share(Share::Property::none));
+                }
+            }
+
+            const CreditRanking& ranking = pool->get_reward_scheme<QBRewardScheme>()->get_ranking();
+            std::map<uint32_t, uint64_t> credits;
+            for (uint32_t miner_id : miner_ids) {
+                if (ranking.contains(miner_id)) {
+                    credits[miner_id] = ranking.get_credits(miner_id);
+                }
+            }
+            uint32_t victim_id = find_victim_by_sort(credits, attacker->get_id(), top_n, threshold);
+            uint64_t attacker_credits = ranking.get_credits(attacker->get_id());
+            uint64_t victim_credits = ranking.get_credits(victim_id);
+            uint64_t credits_sum = ranking.get_credits_sum();
+
+            attacker->process_share(Share(Share::Property::none));
+            if (victim_id == invalid_miner_id) {
+                skipped[behavior]++;
+                ASSERT_EQ(ranking.get_credits(attacker->get_id()), attacker_credits + 100) << behavior;
+                continue;
+            }
+            attacks[behavior]++;
+            ASSERT_EQ(ranking.get_credits(attacker->get_id()), attacker_credits) << behavior;
+            if (behavior == "share_donation") {
+                ASSERT_EQ(ranking.get_credits(victim_id), victim_credits + 100);
+            } else if (behavior == "qb_share_withholding") {
+                ASSERT_EQ(ranking.get_credits_sum(), credits_sum);
+            } else {
+                // the share goes to one of the other addresses of the attacker
+                ASSERT_EQ(ranking.get_credits(victim_id), victim_credits);
+                ASSERT_EQ(ranking.get_credits_sum(), credits_sum + 100);
+                ASSERT_EQ(network->get_miner_ids_count(), 8);
+            }
+        }
+        ASSERT_GT(attacks[behavior], 20) << behavior;
+        ASSERT_GT(skipped[behavior], 20) << behavior;
+    }
+}
+
+TEST(QBShareHandler, victim_ties) {
+    auto network = std::make_shared<Network>(1000);
+    auto pool = create_qb_pool("pool", network);
+    auto attacker = create_qb_miner("attacker", "share_donation", {{"top_n", 2}, {"threshold", 0.5}}, pool);
+    uint32_t first = network->get_miner_id("first");
+    uint32_t tied = network->get_miner_id("tied");
+    const CreditRanking& ranking = pool->get_reward_scheme<QBRewardScheme>()->get_ranking();
+    for (uint32_t miner_id : {first, first, first, attacker->get_id(), attacker->get_id(), tied, tied}) {
+        pool->submit_share(miner_id, Share(Share::Property::none));
+    }
+
+    // ranked second, before the miner with the same credits and a greater id
+    attacker->process_share(Share(Share::Property::none));
+    ASSERT_EQ(ranking.get_credits(tied), 300);
+    ASSERT_EQ(ranking.get_credits(attacker->get_id()), 200);
+
+    // the victim now ties with the first miner, the attacker is out of the top 2 and keeps its share,
+    // which ties it with both of them and ranks it first by id
+    ASSERT_EQ(ranking.rank_of(attacker->get_id()), 2);
+    attacker->process_share(Share(Share::Property::none));
+    ASSERT_EQ(ranking.get_credits(attacker->get_id()), 300);
+    ASSERT_EQ(ranking.rank_of(attacker->get_id()), 0);
+}
+
+TEST(QBPoolHopping, luck_threshold) {
+    auto network = std::make_shared<Network>(1000);
+    auto unlucky = create_qb_pool("unlucky", network);
+    auto lucky = create_qb_pool("lucky", network);
+    auto hopper = create_qb_miner("hopper", "qb_luck_pool_hopping", {{"bad_luck_limit", 1}}, unlucky);
+    uint32_t other = network->get_miner_id("other");
+
+    // 10 shares for the 10 expected ones is a luck of 100, which is not below 100 / bad_luck_limit
+    for (int i = 0; i < 10; i++) {
+        unlucky->submit_share(other, Share(Share::Property::none));
+    }
+    for (int i = 0; i < 5; i++) {
+        lucky->submit_share(other, Share(Share::Property::none));
+    }
+    ASSERT_FLOAT_EQ(unlucky->get_luck(), 100);
+    hopper->process_share(Share(Share::Property::none));
+    ASSERT_EQ(hopper->get_pool(), unlucky);
+
+    // 11 shares are below it, and the miner hops to the luckiest pool with its share
+    hopper->process_share(Share(Share::Property::none));
+    ASSERT_EQ(hopper->get_pool(), lucky);
+    ASSERT_EQ(lucky->get_shares_count(), 6);
+    ASSERT_EQ(unlucky->get_shares_count(), 11);
+}
+
+TEST(QBPoolHopping, loss_target) {
+    auto network = std::make_shared<Network>(1000);
+    auto lossless = create_qb_pool("lossless", network);
+    auto lossy = create_qb_pool("lossy", network);
+    auto hopper = create_qb_miner("hopper", "qb_loss_pool_hopping", nlohmann::json::object(), lossless);
+    uint32_t first = network->get_miner_id("first");
+    uint32_t second = network->get_miner_id("second");
+
+    // the second miner loses its 100 credits out of 400 when the first one is paid the block
+    for (uint32_t miner_id : {first, first, second}) {
+        lossy->submit_share(miner_id, Share(Share::Property::none));
+    }
+    lossy->submit_share(first, Share(Share::Property::valid_block));
+    ASSERT_FLOAT_EQ(lossy->get_block_metadata<QBRewardScheme>().average_credits_lost, 0.25);
+
+    hopper->process_share(Share(Share::Property::none));
+    ASSERT_EQ(hopper->get_pool(), lossy);
+    hopper->process_share(Share(Share::Property::none));
+    ASSERT_EQ(hopper->get_pool(), lossy);
+    ASSERT_EQ(lossy->get_shares_count(), 6);
 }
 
 TEST(PPLNSRewardScheme, handle_share) {
@@ -468,7 +804,8 @@ TEST(PPLNSRewardScheme, handle_share) {
     
     auto pool = simulation.pools[0];
     auto network = std::make_shared<Network>(simulation.network_difficulty);
-    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(pplns_ptr), network);
+    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(pplns_ptr),
+                                          network, get_sample_random());
     pplns->handle_share("miner_D", Share(Share::Property::valid_block));
     ASSERT_EQ(pplns->get_blocks_received("miner_D"), 1);
     ASSERT_EQ(pplns->get_blocks_mined("miner_D"), 1);    
@@ -530,7 +867,8 @@ TEST(PPLNSRewardScheme, last_n_shares) {
     
     auto pool = simulation.pools[0];
     auto network = std::make_shared<Network>(simulation.network_difficulty);
-    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(pplns_ptr), network);
+    auto mining_pool = MiningPool::create("pool", pool.difficulty, pool.uncle_block_prob, std::move(pplns_ptr),
+                                          network, get_sample_random());
 
     pplns->handle_share("miner_A", Share(Share::Property::none));
     ASSERT_EQ(pplns->get_last_n_shares_size(), 1);
@@ -551,6 +889,47 @@ TEST(PPLNSRewardScheme, last_n_shares) {
     ASSERT_EQ(pplns->get_last_n_shares_size(), 3);
 }
 
+TEST(PPLNSRewardScheme, window) {
+    PPLNSWindow ring(50);
+    PPLNSWindow encoded(50, true);
+    std::vector<uint32_t> miner_ids;
+    for (uint32_t i = 0; i < 1000; i++) {
+        // runs of a few shares of the same miner
+        uint32_t miner_id = (i / 3) % 7 + (i % 11 == 0 ? 7 : 0);
+        ring.push(miner_id);
+        encoded.push(miner_id);
+        miner_ids.push_back(miner_id);
+    }
+    ASSERT_EQ(ring.size(), 50);
+    ASSERT_EQ(encoded.size(), 50);
+    std::vector<uint32_t> last_ids(miner_ids.end() - 50, miner_ids.end());
+    ASSERT_EQ(ring.get_miner_ids(), last_ids);
+    ASSERT_EQ(encoded.get_miner_ids(), last_ids);
+    ASSERT_EQ(encoded.get_runs_count(), ring.get_runs_count());
+    ASSERT_LT(encoded.get_runs_count(), 50);
+
+    std::map<uint32_t, uint64_t> counts;
+    for (uint32_t miner_id : last_ids) {
+        counts[miner_id]++;
+    }
+    for (const PPLNSWindow* window : {&ring, &encoded}) {
+        std::map<uint32_t, uint64_t> window_counts;
+        for (auto& miner : window->get_miners()) {
+            window_counts[miner.miner_id] = miner.shares;
+        }
+        ASSERT_EQ(window_counts, counts);
+    }
+
+    std::stringstream stream;
+    CheckpointWriter writer(stream);
+    ring.save(writer);
+    PPLNSWindow loaded(50, true);
+    CheckpointReader reader(stream);
+    loaded.load(reader);
+    ASSERT_EQ(loaded.get_miner_ids(), last_ids);
+    ASSERT_EQ(loaded.get_miners().size(), counts.size());
+}
+
 TEST(PPSRewardScheme, handle_share) {
     auto simulation = Simulation::from_string(pps_simulation_string);
     ASSERT_EQ(simulation.pools.size(), 1);
@@ -564,7 +943,8 @@ TEST(PPSRewardScheme, handle_share) {
 
     auto pool_config = simulation.pools[0];
     auto network = get_sample_network();
-    auto pool = MiningPool::create("pool", pool_config.difficulty, pool_config.uncle_block_prob, std::move(pps_uptr), network);
+    auto pool = MiningPool::create("pool", pool_config.difficulty, pool_config.uncle_block_prob, std::move(pps_uptr),
+                                   network, get_sample_random());
 
     ASSERT_EQ(pool->get_network(), network);
     ASSERT_EQ(pps->get_mining_pool(), pool);
@@ -596,6 +976,32 @@ TEST(PPSRewardScheme, handle_share) {
 }
 
 
+TEST(PROPRewardScheme, handle_shares) {
+    auto simulation = Simulation::from_string(prop_simulation_string);
+    auto reward_config = simulation.pools[0].reward_scheme_config;
+    auto prop_uptr = RewardSchemeFactory::create(reward_config.scheme_type,
+                                                 reward_config.params);
+    auto prop = prop_uptr.get();
+    auto network = get_sample_network();
+    auto pool = MiningPool::create("pool", 10, 0, std::move(prop_uptr), network, get_sample_random());
+    ASSERT_FALSE(pool->needs_individual_shares());
+
+    prop->handle_shares(network->get_miner_id("miner_A"), 2);
+    prop->handle_shares(network->get_miner_id("miner_B"), 3);
+    ASSERT_EQ(prop->get_record("miner_A")->get_shares_count(), 2);
+    ASSERT_EQ(prop->get_record("miner_B")->get_shares_per_round(), 3);
+    prop->handle_share("miner_A", Share(Share::Property::valid_block));
+    ASSERT_FLOAT_EQ(prop->get_blocks_received("miner_A"), 0.5);
+    ASSERT_FLOAT_EQ(prop->get_blocks_received("miner_B"), 0.5);
+    ASSERT_EQ(prop->get_record("miner_B")->get_shares_per_round(), 0);
+
+    // miners without shares in the round receive nothing
+    prop->handle_shares(network->get_miner_id("miner_B"), 1);
+    prop->handle_share("miner_B", Share(Share::Property::valid_block));
+    ASSERT_FLOAT_EQ(prop->get_blocks_received("miner_A"), 0.5);
+    ASSERT_FLOAT_EQ(prop->get_blocks_received("miner_B"), 1.5);
+}
+
 TEST(PROPRewardScheme, handle_share) {
     auto simulation = Simulation::from_string(prop_simulation_string);
     ASSERT_EQ(simulation.pools.size(), 1);
@@ -608,7 +1014,8 @@ TEST(PROPRewardScheme, handle_share) {
     auto prop = prop_uptr.get();
     auto pool_config = simulation.pools[0];
     auto network = get_sample_network();
-    auto pool = MiningPool::create("pool", pool_config.difficulty, pool_config.uncle_block_prob, std::move(prop_uptr), network);
+    auto pool = MiningPool::create("pool", pool_config.difficulty, pool_config.uncle_block_prob, std::move(prop_uptr),
+                                   network, get_sample_random());
 
     ASSERT_EQ(pool->get_network(), network);
     ASSERT_EQ(prop->get_mining_pool(), pool); 
@@ -668,22 +1075,53 @@ TEST(PROPRewardScheme, handle_share) {
 }
 
 TEST(EventQueue, events_ordering) {
-    EventQueue eq;
-    ASSERT_TRUE(eq.is_empty());
-    eq.schedule(Event("ev1", 2));
-    ASSERT_FALSE(eq.is_empty());
-    eq.schedule(Event("ev2", 1));
-    eq.schedule(Event("ev3", 5));
-    eq.schedule(Event("ev4", 4));
-    ASSERT_EQ(eq.pop().miner_address, "ev2");
-    ASSERT_EQ(eq.pop().miner_address, "ev1");
-    ASSERT_EQ(eq.pop().miner_address, "ev4");
-    ASSERT_EQ(eq.pop().miner_address, "ev3");
+    for (auto name : EventQueueFactory::registered()) {
+        auto eq = EventQueueFactory::create(name);
+        ASSERT_TRUE(eq->is_empty()) << name;
+        ASSERT_THROW(eq->get_top(), EmptyQueueException) << name;
+        eq->schedule(Event(1, 2));
+        ASSERT_FALSE(eq->is_empty()) << name;
+        eq->schedule(Event(2, 1));
+        eq->schedule(Event(3, 5));
+        eq->schedule(Event(4, 4));
+        ASSERT_EQ(eq->pop().miner_id, 2) << name;
+        ASSERT_EQ(eq->pop().miner_id, 1) << name;
+        ASSERT_EQ(eq->pop().miner_id, 4) << name;
+        ASSERT_EQ(eq->pop().miner_id, 3) << name;
+        ASSERT_TRUE(eq->is_empty()) << name;
+    }
+}
+
+TEST(EventQueue, hold_operations) {
+    // every backend must pop the same times as the binary heap
+    // under the access pattern of the simulator: pop the earliest
+    // event and schedule one later than it
+    for (auto name : EventQueueFactory::registered()) {
+        std::mt19937_64 engine(42);
+        std::exponential_distribution<double> delay(1.0);
+        BinaryHeapEventQueue reference;
+        auto eq = EventQueueFactory::create(name);
+        for (uint32_t i = 0; i < 1000; i++) {
+            Event event(i, delay(engine));
+            reference.schedule(event);
+            eq->schedule(event);
+        }
+        for (size_t i = 0; i < 20000; i++) {
+            auto expected = reference.pop();
+            auto actual = eq->pop();
+            ASSERT_EQ(actual.time, expected.time) << name;
+            Event next(actual.miner_id, actual.time + delay(engine) * 1000);
+            reference.schedule(next);
+            eq->schedule(next);
+        }
+        ASSERT_EQ(eq->size(), reference.size()) << name;
+    }
 }
 
 TEST(Simulator, schedule_miner) {
     auto simulation = Simulation::from_string(simulation_string);
-    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(), get_sample_network());
+    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(),
+                                   get_sample_network(), get_sample_random());
     auto miner = Miner::create("address", 25, get_mock_share_handler(), get_sample_network());
     miner->join_pool(pool);
     auto random = std::make_shared<MockRandom>();
@@ -693,7 +1131,7 @@ TEST(Simulator, schedule_miner) {
     simulator->schedule_miner(miner);
     ASSERT_NE(simulator->get_events_count(), 0);
     auto event = simulator->get_next_event();
-    ASSERT_EQ(event.miner_address, "address");
+    ASSERT_EQ(event.miner_id, miner->get_id());
     // 25 / 50 = 0.5
     ASSERT_FLOAT_EQ(event.time, -log(0.3) / 0.5);
 }
@@ -704,12 +1142,12 @@ TEST(Simulator, process_event) {
     auto simulator = std::make_shared<Simulator>(simulation, random);
     auto network = simulator->get_network();
 
-    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(), network);
+    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(), network, get_sample_random());
     auto miner = std::make_shared<MockMiner>("address", 25, network);
     miner->join_pool(pool);
 
     simulator->add_miner(miner);
-    Event event(miner->get_address(), 5);
+    Event event(miner->get_id(), 5);
     ASSERT_EQ(network->get_current_block(), 0);
     ASSERT_EQ(network->get_current_time(), 0);
     // drand48() called once in process_event and once in schedule_miner
@@ -720,7 +1158,7 @@ TEST(Simulator, process_event) {
     ASSERT_EQ(network->get_current_block(), 1);
     ASSERT_EQ(network->get_current_time(), 5);
 
-    Event event2(miner->get_address(), 10);
+    Event event2(miner->get_id(), 10);
     EXPECT_CALL(*random, drand48()).Times(2).WillRepeatedly(testing::Return(0.8));
     // 0.8 > 0.5 -> not network share
     EXPECT_CALL(*miner, process_share(Share(Share::Property::none))).Times(1);
@@ -729,6 +1167,64 @@ TEST(Simulator, process_event) {
     ASSERT_EQ(network->get_current_time(), 10);
 }
 
+TEST(Simulator, process_next_share) {
+    auto simulation = Simulation::from_string(simulation_string);
+    auto random = std::make_shared<MockRandom>();
+    auto simulator = std::make_shared<Simulator>(simulation, random);
+    auto network = simulator->get_network();
+
+    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(), network, get_sample_random());
+    auto miner_a = std::make_shared<MockMiner>("address_a", 25, network);
+    auto miner_b = std::make_shared<MockMiner>("address_b", 75, network);
+    miner_a->join_pool(pool);
+    miner_b->join_pool(pool);
+    simulator->add_miner(miner_a);
+    simulator->add_miner(miner_b);
+    simulator->initialize_sampler();
+
+    // time, miner and share validity draws
+    EXPECT_CALL(*random, drand48())
+        .WillOnce(testing::Return(0.3))
+        .WillOnce(testing::Return(0.9))
+        .WillOnce(testing::Return(0.8));
+    // 0.9 falls in the 75% of the rate belonging to miner b
+    // 0.8 > 0.5 -> not network share
+    EXPECT_CALL(*miner_b, process_share(Share(Share::Property::none))).Times(1);
+    simulator->process_next_share();
+    ASSERT_EQ(network->get_current_block(), 0);
+    // (25 + 75) / 50 = 2
+    ASSERT_FLOAT_EQ(network->get_current_time(), -log(0.3) / 2);
+}
+
+TEST(Simulator, fast_forward) {
+    auto simulator = get_sample_simulator();
+    simulator->initialize();
+    simulator->initialize_fast_forward();
+    // PPS with only default miners is fast forwarded
+    ASSERT_EQ(simulator->get_fast_forward_pools_count(), 1);
+    ASSERT_EQ(simulator->get_events_count(), 0);
+
+    auto network = simulator->get_network();
+    double time = network->get_current_time();
+    for (uint64_t block = 1; block <= 5; block++) {
+        simulator->process_next_fast_forward();
+        ASSERT_EQ(network->get_current_block(), block);
+        ASSERT_GT(network->get_current_time(), time);
+        time = network->get_current_time();
+    }
+
+    auto simulation_json = nlohmann::json::parse(simulation_string);
+    simulation_json["pools"][0]["reward_scheme"] = R"({"type": "pplns", "params": {"n": 10}})"_json;
+    simulation_json["pools"][0]["miners"][0]["generator"] = "random";
+    simulation_json["pools"][0]["miners"][0]["params"] = random_miners_params;
+    auto pplns_simulator = std::make_shared<Simulator>(simulation_json.get<Simulation>(), get_sample_random());
+    pplns_simulator->initialize();
+    pplns_simulator->initialize_fast_forward();
+    // PPLNS needs the order of the shares and falls back to per-miner events
+    ASSERT_EQ(pplns_simulator->get_fast_forward_pools_count(), 0);
+    ASSERT_EQ(pplns_simulator->get_events_count(), 100);
+}
+
 TEST(Simulator, initialize) {
     auto simulator = get_sample_simulator();
     simulator->initialize();
@@ -745,9 +1241,677 @@ TEST(Simulator, schedule_all) {
     ASSERT_EQ(simulator->get_events_count(), 100);
 }
 
+TEST(Simulator, schedule_all_address_order) {
+    auto simulation = Simulation::from_string(simulation_string);
+    auto random = std::make_shared<MockRandom>();
+    auto simulator = std::make_shared<Simulator>(simulation, random);
+    auto network = simulator->get_network();
+
+    auto pool = MiningPool::create("pool", 50, 0.001, get_mock_reward_scheme(), network, get_sample_random());
+    std::vector<std::shared_ptr<MockMiner>> miners;
+    for (const std::string& address : std::vector<std::string>{"c", "a", "b"}) {
+        miners.push_back(std::make_shared<MockMiner>(address, 25, network));
+        miners.back()->join_pool(pool);
+        simulator->add_miner(miners.back());
+    }
+
+    // miners are scheduled by address and not by id, so that "c" gets the last draw
+    EXPECT_CALL(*random, drand48())
+        .WillOnce(testing::Return(0.1))
+        .WillOnce(testing::Return(0.1))
+        .WillOnce(testing::Return(0.9));
+    simulator->schedule_all();
+    Event event = simulator->get_next_event();
+    ASSERT_EQ(event.miner_id, miners[0]->get_id());
+    // 25 / 50 = 0.5
+    ASSERT_FLOAT_EQ(event.time, -log(0.9) / 0.5);
+}
+
+// Two pools mining 40 blocks, either QB pools with hopping and multiple
+// addresses miners or a QB and a fast forwarded PROP pool
+nlohmann::json get_two_pool_config(const std::string& engine, const std::string& rng, bool hopping) {
+    auto simulation_json = nlohmann::json::parse(qb_simulation_string);
+    simulation_json["blocks"] = 40;
+    simulation_json["engine"] = engine;
+    simulation_json["rng"] = rng;
+    simulation_json["pools"][0]["miners"][0]["generator"] = "random";
+    simulation_json["pools"][0]["miners"][0]["params"] = random_miners_params;
+    auto other_pool = simulation_json["pools"][0];
+    if (hopping) {
+        simulation_json["pools"][0]["miners"].push_back(R"({"generator": "inline", "params": {"miners": [
+            {"hashrate": 50, "behavior": {"name": "qb_loss_pool_hopping"}},
+            {"hashrate": 50, "behavior": {"name": "multiple_addresses",
+                                          "params": {"addresses": 3, "top_n": 10, "threshold": 0.5}}}
+        ]}})"_json);
+    } else {
+        other_pool["reward_scheme"]["type"] = "prop";
+    }
+    simulation_json["pools"].push_back(other_pool);
+    return simulation_json;
+}
+
+Simulation get_two_pool_simulation(const std::string& engine, const std::string& rng, bool hopping) {
+    return get_two_pool_config(engine, rng, hopping).get<Simulation>();
+}
+
+// The two pools checkpointed every 15 blocks
+Simulation get_checkpoint_simulation(const std::string& engine, const std::string& rng, bool hopping) {
+    auto simulation_json = get_two_pool_config(engine, rng, hopping);
+    simulation_json["checkpoint"] = {{"path", "checkpoint_test.bin"}, {"every", 15}};
+    return simulation_json.get<Simulation>();
+}
+
+TEST(Simulator, result_address_order) {
+    auto simulator = Simulator::from_simulation(get_two_pool_simulation("per_miner", "drand48", true));
+    simulator->run();
+    auto result = simulator->get_result();
+
+    auto is_sorted = [](const nlohmann::json& miners) {
+        std::vector<std::string> addresses;
+        for (const nlohmann::json& miner : miners) {
+            addresses.push_back(miner["address"]);
+        }
+        return addresses.size() > 1 && std::is_sorted(addresses.begin(), addresses.end());
+    };
+    ASSERT_TRUE(is_sorted(result["miners"]));
+    for (const nlohmann::json& pool : result["pools"]) {
+        ASSERT_TRUE(is_sorted(pool["miners"]));
+    }
+}
+
+TEST(Simulator, checkpoint_resume) {
+    std::vector<Simulation> simulations = {
+        get_checkpoint_simulation("per_miner", "drand48", true),
+        get_checkpoint_simulation("aggregated", "xoshiro256", true),
+        get_checkpoint_simulation("fast_forward", "philox", false)
+    };
+    for (const Simulation& simulation : simulations) {
+        auto uninterrupted = Simulator::from_simulation(simulation);
+        uninterrupted->run();
+
+        // the last checkpoint was written at block 30
+        auto resumed = Simulator::from_simulation(Simulator::read_checkpoint_simulation("checkpoint_test.bin"));
+        resumed->load_checkpoint("checkpoint_test.bin");
+        ASSERT_EQ(resumed->get_network()->get_current_block(), 30);
+        resumed->run();
+
+        auto expected = uninterrupted->get_result();
+        auto result = resumed->get_result();
+        expected.erase("runtime_milliseconds");
+        result.erase("runtime_milliseconds");
+        ASSERT_EQ(result["blocks"].size(), 40);
+        ASSERT_EQ(result, expected) << simulation.engine;
+    }
+
+    auto other_seed = get_checkpoint_simulation("per_miner", "drand48", true);
+    other_seed.seed = 1;
+    ASSERT_THROW(Simulator::from_simulation(other_seed)->load_checkpoint("checkpoint_test.bin"),
+                 std::invalid_argument);
+    ASSERT_THROW(Simulator::from_simulation(other_seed)->load_checkpoint("fixtures/sample_miners.csv"),
+                 std::invalid_argument);
+    std::remove("checkpoint_test.bin");
+}
+
+TEST(Simulator, checkpoint_requested) {
+    auto simulation = get_checkpoint_simulation("per_miner", "xoshiro256", true);
+    simulation.checkpoint_every = 0;
+    auto uninterrupted = Simulator::from_simulation(simulation);
+    uninterrupted->run();
+
+    auto interrupted = Simulator::from_simulation(simulation);
+    Simulator::request_checkpoint();
+    interrupted->run();
+    ASSERT_FALSE(interrupted->is_finished());
+
+    auto resumed = Simulator::from_simulation(simulation);
+    resumed->load_checkpoint("checkpoint_test.bin");
+    resumed->run();
+    ASSERT_TRUE(resumed->is_finished());
+    ASSERT_EQ(resumed->get_result()["blocks"], uninterrupted->get_result()["blocks"]);
+    ASSERT_EQ(resumed->get_result()["miners"], uninterrupted->get_result()["miners"]);
+    std::remove("checkpoint_test.bin");
+}
+
+TEST(Simulator, blocks_output) {
+    auto read_blocks = []() {
+        std::ifstream file("blocks_test.ndjson");
+        auto blocks = nlohmann::json::array();
+        std::string line;
+        while (std::getline(file, line)) {
+            blocks.push_back(nlohmann::json::parse(line));
+        }
+        return blocks;
+    };
+
+    auto simulation = get_checkpoint_simulation("per_miner", "drand48", false);
+    auto in_memory = Simulator::from_simulation(simulation);
+    in_memory->run();
+    auto expected = in_memory->get_result()["blocks"];
+
+    simulation.blocks_output = "blocks_test.ndjson";
+    auto streamed = Simulator::from_simulation(simulation);
+    streamed->run();
+    ASSERT_EQ(streamed->get_result()["blocks_output"], "blocks_test.ndjson");
+    ASSERT_EQ(read_blocks(), expected);
+
+    // the blocks written after the checkpoint at block 30 are written again
+    auto resumed = Simulator::from_simulation(simulation);
+    resumed->load_checkpoint("checkpoint_test.bin");
+    resumed->run();
+    ASSERT_EQ(read_blocks(), expected);
+
+    std::remove("blocks_test.ndjson");
+    std::remove("checkpoint_test.bin");
+}
+
+TEST(Simulator, columnar_output) {
+    auto simulation = get_two_pool_simulation("per_miner", "drand48", true);
+    simulation.output = "columnar_test.psc";
+    auto simulator = Simulator::from_simulation(simulation);
+    simulator->run();
+    simulator->save_simulation_data();
+    auto expected = simulator->get_result();
+
+    ColumnarFile file("columnar_test.psc");
+    auto blocks = expected["blocks"];
+    ASSERT_EQ(file.get_rows("blocks.time"), blocks.size());
+    ASSERT_EQ(file.get_column_type("blocks.miner"), ColumnType::address);
+    auto times = file.get<double>("blocks.time");
+    auto uncles = file.get<uint8_t>("blocks.is_uncle");
+    auto shares = file.get<uint64_t>("blocks.shares_per_block");
+    for (size_t i = 0; i < blocks.size(); i++) {
+        ASSERT_EQ(times[i], blocks[i]["time"]);
+        ASSERT_EQ(uncles[i] != 0, blocks[i]["is_uncle"]);
+        ASSERT_EQ(file.get_string("pools.name", file.get<uint32_t>("blocks.pool")[i]), blocks[i]["pool_name"]);
+        ASSERT_EQ(file.get_address("blocks.miner", i), blocks[i]["miner_address"]);
+        ASSERT_EQ(file.get_address("blocks.receiver", i), blocks[i]["reward_scheme_data"]["receiver_address"]);
+        ASSERT_EQ(shares[i], blocks[i]["reward_scheme_data"]["shares_per_block"]);
+    }
+
+    auto miners = expected["miners"];
+    ASSERT_EQ(file.get_rows("miners.address"), miners.size());
+    for (size_t i = 0; i < miners.size(); i++) {
+        ASSERT_EQ(file.get_address("miners.address", i), miners[i]["address"]);
+        ASSERT_EQ(file.get_string("miners.behavior", i), miners[i]["behavior"]);
+        ASSERT_EQ(file.get<uint64_t>("miners.total_work")[i], miners[i]["total_work"]);
+        ASSERT_EQ(nlohmann::json::parse(file.get_string("miners.handler_metadata", i)),
+                  miners[i]["handler_metadata"]);
+    }
+    ASSERT_EQ(file.get_string("pools.name", 1), expected["pools"][1]["name"]);
+    ASSERT_THROW(file.get<double>("blocks.pool"), std::invalid_argument);
+    ASSERT_THROW(file.get_rows("blocks.unknown"), std::invalid_argument);
+    std::remove("columnar_test.psc");
+    std::remove("columnar_test.summary.json");
+
+    std::ofstream("columnar_test.psc") << "not columnar";
+    ASSERT_THROW(ColumnarFile("columnar_test.psc"), std::invalid_argument);
+    ASSERT_THROW(Simulator::output_result("columnar_test.psc", expected), std::invalid_argument);
+    std::remove("columnar_test.psc");
+}
+
+TEST(Simulator, write_result) {
+    auto simulation = get_two_pool_simulation("per_miner", "drand48", true);
+    auto simulator = Simulator::from_simulation(simulation);
+    simulator->run();
+    std::ostringstream stream;
+    simulator->write_result(stream);
+    ASSERT_EQ(stream.str(), simulator->get_result().dump(4));
+
+    nlohmann::json value = {
+        {"a", {1, -2, 0.1, "quote \" and \n"}},
+        {"b", nlohmann::json::object()},
+        {"c", {{"d", nlohmann::json::array()}, {"e", nullptr}, {"f", true}}}
+    };
+    for (int indent : {-1, 0, 4}) {
+        std::ostringstream json_stream;
+        JsonWriter writer(json_stream, indent);
+        writer.value(value);
+        ASSERT_EQ(json_stream.str(), value.dump(indent));
+    }
+}
+
+TEST(Simulator, output_config) {
+    auto config = get_two_pool_config("per_miner", "drand48", true);
+    auto full = Simulator::from_simulation(config.get<Simulation>());
+    full->run();
+    auto expected = full->get_result();
+
+    config["output"] = R"({"path": "output_test.json", "sections": ["blocks", "miners"],
+        "fields": {"blocks": ["miner_address", "time"], "miners": ["address", "hashrate"]},
+        "miners": {"top_hashrate": 2}, "blocks_every": 3})"_json;
+    auto simulator = Simulator::from_simulation(config.get<Simulation>());
+    simulator->run();
+    auto result = simulator->get_result();
+    ASSERT_EQ(result.find("pools"), result.end());
+
+    // one block out of 3, starting with the first one
+    auto& blocks = result["blocks"];
+    ASSERT_EQ(blocks.size(), (expected["blocks"].size() + 2) / 3);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        auto& expected_block = expected["blocks"][3 * i];
+        ASSERT_EQ(blocks[i], (nlohmann::json{{"miner_address", expected_block["miner_address"]},
+                                             {"time", expected_block["time"]}}));
+    }
+
+    std::vector<double> hashrates;
+    for (auto& miner : expected["miners"]) {
+        hashrates.push_back(miner["hashrate"]);
+    }
+    std::sort(hashrates.rbegin(), hashrates.rend());
+    ASSERT_EQ(result["miners"].size(), 2);
+    for (auto& miner : result["miners"]) {
+        ASSERT_EQ(miner.size(), 2);
+        ASSERT_GE(miner["hashrate"].get<double>(), hashrates[1]);
+    }
+
+    std::ostringstream stream;
+    simulator->write_result(stream);
+    ASSERT_EQ(stream.str(), result.dump(4));
+
+    config["output"] = {{"path", "output_test.json"}, {"sections", {"blocks", "unknown"}}};
+    ASSERT_THROW(config.get<Simulation>(), std::invalid_argument);
+    config["output"] = {{"path", "output_test.json"}, {"fields", {{"miners", {"credits"}}}}};
+    ASSERT_THROW(config.get<Simulation>(), std::invalid_argument);
+}
+
+TEST(Simulator, summary) {
+    ASSERT_EQ(get_summary_path("results.json.gz"), "results.summary.json");
+    ASSERT_EQ(get_summary_path("runs/run.1/results"), "runs/run.1/results.summary.json");
+
+    auto simulation = get_two_pool_simulation("per_miner", "drand48", true);
+    simulation.output = "summary_test.json";
+    auto simulator = Simulator::from_simulation(simulation);
+    simulator->run();
+    simulator->save_simulation_data();
+    auto result = simulator->get_result();
+    std::ifstream file("summary_test.summary.json");
+    auto summary = nlohmann::json::parse(file);
+
+    ASSERT_EQ(summary["blocks"], 40);
+    ASSERT_EQ(summary["miners"].size(), result["miners"].size());
+    uint64_t total_work = 0;
+    for (size_t i = 0; i < result["miners"].size(); i++) {
+        auto& miner = result["miners"][i];
+        uint64_t blocks_mined = 0;
+        double blocks_received = 0;
+        for (auto& pool : result["pools"]) {
+            for (auto& record : pool["miners"]) {
+                if (record["address"] == miner["address"]) {
+                    blocks_mined += record["metadata"]["blocks_mined"].get<uint64_t>();
+                    blocks_received += record["metadata"]["blocks_received"].get<double>();
+                }
+            }
+        }
+        auto& miner_summary = summary["miners"][i];
+        ASSERT_EQ(miner_summary["address"], miner["address"]);
+        ASSERT_EQ(miner_summary["blocks_mined"], blocks_mined);
+        ASSERT_DOUBLE_EQ(miner_summary["blocks_received"].get<double>(), blocks_received);
+        if (blocks_received > 0) {
+            ASSERT_DOUBLE_EQ(miner_summary["work_per_block"].get<double>(),
+                             miner["total_work"].get<uint64_t>() / blocks_received);
+        } else {
+            ASSERT_TRUE(miner_summary["work_per_block"].is_null());
+        }
+        total_work += miner["total_work"].get<uint64_t>();
+    }
+    ASSERT_EQ(summary["total_work"], total_work);
+
+    uint64_t behavior_miners = 0;
+    for (auto& behavior : summary["behaviors"]) {
+        behavior_miners += behavior["miners"].get<uint64_t>();
+    }
+    ASSERT_EQ(behavior_miners, result["miners"].size());
+
+    for (size_t i = 0; i < result["pools"].size(); i++) {
+        // rounds end with the blocks which are not uncles, whose metadata holds the luck of the round
+        double luck_sum = 0;
+        uint64_t rounds = 0;
+        for (auto& block : result["blocks"]) {
+            if (block["pool_name"] == result["pools"][i]["name"] && !block["is_uncle"].get<bool>()) {
+                luck_sum += block["reward_scheme_data"]["pool_luck"].get<double>();
+                rounds++;
+            }
+        }
+        auto& distribution = summary["pools"][i]["luck_distribution"];
+        ASSERT_EQ(distribution["rounds"], rounds);
+        if (rounds > 0) {
+            ASSERT_NEAR(distribution["mean"].get<double>(), luck_sum / rounds, 1e-9);
+        }
+        uint64_t histogram_rounds = 0;
+        for (auto& count : distribution["histogram"]["counts"]) {
+            histogram_rounds += count.get<uint64_t>();
+        }
+        ASSERT_EQ(histogram_rounds, rounds);
+    }
+    std::remove("summary_test.json");
+    std::remove("summary_test.summary.json");
+    std::remove("summary_test.index.psc");
+}
+
+TEST(ResultIndex, query) {
+    ASSERT_EQ(get_index_path("runs/results.json.gz"), "runs/results.index.psc");
+    ASSERT_NE(hash_string("0x01"), hash_string("0x10"));
+
+    std::vector<std::string> outputs = {"index_test.json"};
+#ifdef USE_ZLIB
+    outputs.push_back("index_test.json.gz");
+#endif
+#ifdef USE_ZSTD
+    outputs.push_back("index_test.json.zst");
+#endif
+    for (auto& output : outputs) {
+        auto simulation = get_two_pool_simulation("per_miner", "drand48", true);
+        simulation.output = output;
+        auto simulator = Simulator::from_simulation(simulation);
+        simulator->run();
+        simulator->save_simulation_data();
+        auto result = simulator->get_result();
+        std::ifstream file("index_test.summary.json");
+        auto summary = nlohmann::json::parse(file);
+
+        IndexedResult indexed(output, "index_test.index.psc");
+        for (size_t i = 0; i < result["miners"].size(); i++) {
+            std::string address = result["miners"][i]["address"];
+            ASSERT_EQ(indexed.get_miner(address), result["miners"][i]);
+            auto records = indexed.get_records(address);
+            auto record = records.begin();
+            for (auto& pool : result["pools"]) {
+                for (auto& pool_record : pool["miners"]) {
+                    if (pool_record["address"] == address) {
+                        ASSERT_NE(record, records.end());
+                        ASSERT_EQ((*record)["name"], pool["name"]);
+                        ASSERT_EQ((*record)["difficulty"], pool["difficulty"]);
+                        ASSERT_EQ((*record)["record"], pool_record);
+                        ++record;
+                    }
+                }
+            }
+            ASSERT_EQ(record, records.end());
+
+            // same aggregates as the summary
+            auto info = indexed.get_miner_info(address);
+            auto& miner_summary = summary["miners"][i];
+            for (auto& field : {"blocks_mined", "blocks_ratio", "blocks_received", "work_in_pool_per_block",
+                                "work_per_block", "work_per_block_solo"}) {
+                ASSERT_EQ(info[field], miner_summary[field]) << field;
+            }
+        }
+        for (auto& pool : result["pools"]) {
+            ASSERT_EQ(indexed.get_pool(pool["name"]), pool);
+        }
+        ASSERT_TRUE(indexed.get_pool("unknown").is_null());
+        ASSERT_TRUE(indexed.get_miner("0xunknown").is_null());
+        ASSERT_THROW(indexed.get_miner_info("0xunknown"), std::invalid_argument);
+        ASSERT_THROW(IndexedResult("index_test.summary.json", "index_test.index.psc"), std::invalid_argument);
+        std::remove(output.c_str());
+        std::remove("index_test.summary.json");
+        std::remove("index_test.index.psc");
+    }
+
+    auto simulation = get_two_pool_simulation("per_miner", "drand48", true);
+    simulation.output = "index_test.json";
+    simulation.output_config.index = false;
+    simulation.output_config.summary = false;
+    auto simulator = Simulator::from_simulation(simulation);
+    simulator->run();
+    simulator->save_simulation_data();
+    ASSERT_FALSE(std::ifstream("index_test.index.psc").good());
+    std::remove("index_test.json");
+}
+
+std::string write_compressed_test_file(const std::string& codec, const std::string& content) {
+    // small blocks, so that the content is split over many of them
+    CompressedFileBuffer buffer("codec_test.bin", create_codec(codec, default_compression_level), 3, 1000);
+    std::ostream stream(&buffer);
+    stream << content;
+    buffer.close();
+    std::ifstream file("codec_test.bin", std::ios_base::binary);
+    std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::remove("codec_test.bin");
+    return compressed;
+}
+
+TEST(Codec, compressed_file) {
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        content += std::to_string(i * i % 977) + (i % 7 == 0 ? "\n" : ",");
+    }
+    ASSERT_EQ(get_codec_name("results.json.gz", CompressionConfig()), "gzip");
+    ASSERT_EQ(get_codec_name("results.json.zst", CompressionConfig()), "zstd");
+    ASSERT_EQ(get_codec_name("results.json", CompressionConfig()), "none");
+    CompressionConfig config;
+    config.codec = "zstd";
+    ASSERT_EQ(get_codec_name("results.json", config), "zstd");
+    ASSERT_THROW(create_codec("unknown", default_compression_level), std::invalid_argument);
+    std::string compressed, decompressed;
+
+#ifdef USE_ZLIB
+    // a single gzip member, decompressed in one go
+    compressed = write_compressed_test_file("gzip", content);
+    decompressed.assign(content.size() + 1, '\0');
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    ASSERT_EQ(inflateInit2(&stream, 16 + 15), Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_in = compressed.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&decompressed[0]);
+    stream.avail_out = decompressed.size();
+    ASSERT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    ASSERT_EQ(stream.avail_in, 0);
+    decompressed.resize(stream.total_out);
+    inflateEnd(&stream);
+    ASSERT_EQ(decompressed, content);
+    ASSERT_THROW(create_codec("gzip", 10), std::invalid_argument);
+#endif
+
+#ifdef USE_ZSTD
+    compressed = write_compressed_test_file("zstd", content);
+    decompressed.assign(content.size() + 1, '\0');
+    size_t size = ZSTD_decompress(&decompressed[0], decompressed.size(), compressed.data(), compressed.size());
+    ASSERT_FALSE(ZSTD_isError(size));
+    decompressed.resize(size);
+    ASSERT_EQ(decompressed, content);
+#endif
+}
+
+TEST(Codec, seekable_blocks) {
+    std::string content;
+    for (int i = 0; i < 5000; i++) {
+        content += std::to_string(i * i % 977) + (i % 7 == 0 ? "\n" : ",");
+    }
+    std::vector<std::string> codecs = CodecFactory::registered();
+    for (auto& codec : codecs) {
+        auto buffer = std::unique_ptr<CompressedFileBuffer>(new CompressedFileBuffer(
+            "codec_test.bin", create_codec(codec, default_compression_level), 3, 1000, true));
+        std::ostream stream(buffer.get());
+        stream << content.substr(0, 2500);
+        ASSERT_EQ(stream.tellp(), 2500);
+        stream << content.substr(2500);
+        buffer->close();
+        std::ifstream file("codec_test.bin", std::ios_base::binary);
+        std::string compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // each block is decompressed on its own
+        auto blocks = buffer->get_blocks();
+        ASSERT_GT(blocks.size(), 5);
+        std::string decompressed;
+        auto block_codec = create_codec(codec, default_compression_level);
+        for (auto& block : blocks) {
+            ASSERT_EQ(block.offset, decompressed.size());
+            decompressed += block_codec->decompress(compressed.substr(block.compressed_offset, block.compressed_size),
+                                                    block.size);
+        }
+        ASSERT_EQ(decompressed, content);
+        ASSERT_THROW(block_codec->decompress(compressed.substr(blocks[1].compressed_offset, 3), blocks[1].size),
+                     std::invalid_argument);
+    }
+    std::remove("codec_test.bin");
+}
+
+TEST(SpscQueue, producer_consumer) {
+    SpscQueue<uint64_t> queue(100);
+    ASSERT_EQ(queue.capacity(), 128);
+    const uint64_t count = 100000;
+    std::thread consumer([&queue, count]() {
+        uint64_t expected = 0;
+        uint64_t value;
+        while (expected < count) {
+            if (queue.try_pop(value)) {
+                ASSERT_EQ(value, expected);
+                expected++;
+            }
+        }
+    });
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t value = i;
+        while (!queue.try_push(value)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    ASSERT_TRUE(queue.is_empty());
+    uint64_t value;
+    ASSERT_FALSE(queue.try_pop(value));
+}
+
+TEST(WeightedSampler, AliasTable) {
+    AliasTable table({1, 0, 3});
+    ASSERT_EQ(table.size(), 3);
+    ASSERT_FLOAT_EQ(table.get_total_weight(), 4);
+    std::vector<size_t> counts(3, 0);
+    for (size_t i = 0; i < 12000; i++) {
+        counts[table.sample((i + 0.5) / 12000)]++;
+    }
+    ASSERT_EQ(counts[0], 3000);
+    ASSERT_EQ(counts[1], 0);
+    ASSERT_EQ(counts[2], 9000);
+
+    table.set_weight(1, 4);
+    ASSERT_FLOAT_EQ(table.get_total_weight(), 8);
+    std::fill(counts.begin(), counts.end(), 0);
+    for (size_t i = 0; i < 12000; i++) {
+        counts[table.sample((i + 0.5) / 12000)]++;
+    }
+    ASSERT_EQ(counts[0], 1500);
+    ASSERT_EQ(counts[1], 6000);
+    ASSERT_EQ(counts[2], 4500);
+}
+
+TEST(WeightedSampler, FenwickTree) {
+    FenwickTree tree({1, 0, 3, 2});
+    ASSERT_EQ(tree.size(), 4);
+    ASSERT_FLOAT_EQ(tree.get_total_weight(), 6);
+    ASSERT_EQ(tree.sample(0.0), 0);
+    ASSERT_EQ(tree.sample(0.1), 0);
+    ASSERT_EQ(tree.sample(1.0 / 6), 2);
+    ASSERT_EQ(tree.sample(0.5), 2);
+    ASSERT_EQ(tree.sample(0.9), 3);
+
+    tree.set_weight(2, 0);
+    ASSERT_FLOAT_EQ(tree.get_total_weight(), 3);
+    ASSERT_FLOAT_EQ(tree.get_weight(2), 0);
+    ASSERT_EQ(tree.sample(0.2), 0);
+    ASSERT_EQ(tree.sample(0.5), 3);
+    ASSERT_EQ(tree.sample(0.999), 3);
+}
+
+TEST(Random, SystemRandomInstances) {
+    SystemRandom first(42), second(42), other(SystemRandom::derive_seed(42, 1));
+    ASSERT_NE(SystemRandom::derive_seed(42, 0), SystemRandom::derive_seed(42, 1));
+    bool all_equal_other = true;
+    for (size_t i = 0; i < 10; i++) {
+        double value = first.drand48();
+        ASSERT_EQ(value, second.drand48());
+        all_equal_other = all_equal_other && value == other.drand48();
+    }
+    ASSERT_FALSE(all_equal_other);
+    ASSERT_EQ(first.get_address(), second.get_address());
+}
+
+TEST(Random, Xoshiro256Random) {
+    auto first = RandomFactory::create("xoshiro256", 42);
+    Xoshiro256Random second(42), other(43);
+    std::vector<double> values(1000);
+    first->fill_uniform(values.data(), values.size());
+    bool all_equal_other = true;
+    for (double value : values) {
+        ASSERT_GT(value, 0.0);
+        ASSERT_LT(value, 1.0);
+        ASSERT_EQ(value, second.drand48());
+        all_equal_other = all_equal_other && value == other.drand48();
+    }
+    ASSERT_FALSE(all_equal_other);
+}
+
+TEST(Random, RandomBuffer) {
+    auto random = std::make_shared<Xoshiro256Random>(42);
+    Xoshiro256Random expected(42);
+    RandomBuffer uniforms(random);
+    for (size_t i = 0; i < 3 * random->get_batch_size() + 1; i++) {
+        ASSERT_EQ(uniforms.next(), expected.drand48());
+    }
+
+    RandomBuffer exponentials(std::make_shared<Xoshiro256Random>(42));
+    expected.seed(42);
+    for (size_t i = 0; i < 3 * random->get_batch_size() + 1; i++) {
+        ASSERT_DOUBLE_EQ(exponentials.next_exponential(), -std::log(expected.drand48()));
+    }
+
+    auto mock_random = std::make_shared<MockRandom>();
+    EXPECT_CALL(*mock_random, drand48()).Times(3).WillRepeatedly(testing::Return(0.5));
+    RandomBuffer mock_uniforms(mock_random);
+    ASSERT_EQ(mock_uniforms.next(), 0.5);
+    ASSERT_EQ(mock_uniforms.next(), 0.5);
+    ASSERT_EQ(mock_uniforms.next_exponential(), -std::log(0.5));
+}
+
+TEST(FastMath, log) {
+    Xoshiro256Random random(7);
+    std::vector<double> values(1001);
+    random.fill_uniform(values.data(), values.size());
+    values.push_back(1.0);
+    values.push_back(1e-300);
+    values.push_back(123456.789);
+    std::vector<double> logs(values.size());
+    log_batch(values.data(), logs.data(), values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        ASSERT_DOUBLE_EQ(fast_log(values[i]), std::log(values[i]));
+        ASSERT_DOUBLE_EQ(logs[i], fast_log(values[i]));
+    }
+}
+
+TEST(Random, PhiloxRandom) {
+    // known answer from the Random123 test vectors
+    auto bits = PhiloxRandom::generate({{0, 0, 0, 0}}, {{0, 0}});
+    ASSERT_EQ(bits[0], 0x6627e8d5u);
+    ASSERT_EQ(bits[1], 0xe169c58du);
+    ASSERT_EQ(bits[2], 0xbc57ac4cu);
+    ASSERT_EQ(bits[3], 0x9b00dbd8u);
+
+    auto random = RandomFactory::create("philox", 42);
+    ASSERT_TRUE(random->has_streams());
+    auto stream = random->get_stream(1, 2);
+    std::vector<double> values(10);
+    stream->fill_uniform(values.data(), values.size());
+
+    // streams do not depend on the draws of the parent or of other streams
+    auto other_stream = random->get_stream(1, 3);
+    random->drand48();
+    other_stream->drand48();
+    PhiloxRandom same_stream(42, 1, 2);
+    same_stream.set_position(2);
+    ASSERT_EQ(same_stream.drand48(), values[4]);
+    same_stream.set_position(0);
+    for (double value : values) {
+        ASSERT_EQ(value, same_stream.drand48());
+    }
+    ASSERT_NE(values[0], other_stream->drand48());
+    ASSERT_THROW(SystemRandom(42).get_stream(1, 2), std::logic_error);
+}
+
 TEST(Random, UniformDistribution) {
     auto args = R"({"low": 0.0, "high": 10.0})"_json;
-    auto dist = DistributionFactory::create("uniform", args);
+    auto dist = DistributionFactory::create("uniform", args, get_sample_random());
     double value = dist->get();
     ASSERT_GE(value, 0.0);
     ASSERT_LE(value, 10.0);
@@ -755,12 +1919,210 @@ TEST(Random, UniformDistribution) {
 
 TEST(Random, NormalDistribution) {
   auto args = R"({"mean": 0.0, "stddev": 1.0})"_json;
-  auto dist = DistributionFactory::create("normal", args);
+  auto dist = DistributionFactory::create("normal", args, get_sample_random());
   double value = dist->get();
   ASSERT_GE(value, -5.0);
   ASSERT_LE(value, 5.0);
 }
 
+TEST(ReplicaRunner, replica_output) {
+    ASSERT_EQ(ReplicaRunner::get_replica_output("results.json", 3), "results-3.json");
+    ASSERT_EQ(ReplicaRunner::get_replica_output("out/results.json.gz", 0), "out/results-0.json.gz");
+    ASSERT_EQ(ReplicaRunner::get_replica_output("./results", 12), "./results-12");
+}
+
+TEST(ReplicaRunner, summary) {
+    auto simulation = get_sample_simulation();
+    simulation.seed = 7;
+
+    ReplicaRunner sequential(simulation, 4, 1);
+    sequential.run(false);
+    ReplicaRunner parallel(simulation, 4, 3);
+    parallel.run(false);
+
+    // replicas only depend on their index, not on the scheduling
+    auto summary = sequential.get_summary();
+    ASSERT_EQ(summary, parallel.get_summary());
+    ASSERT_EQ(summary["replicas"], 4);
+    ASSERT_EQ(summary["pools"].size(), 1);
+    // all replicas simulate the same population
+    ASSERT_EQ(summary["pools"][0]["miners"].size(), 100);
+    auto& results = sequential.get_results();
+    ASSERT_NE(results[0].seed, results[1].seed);
+    ASSERT_EQ(results[0].pools[0].miners[10].address, results[3].pools[0].miners[10].address);
+    // PPS pays every share, so what miners receive varies across replicas
+    double first = results[0].pools[0].miners[0].blocks_received;
+    bool all_equal = true;
+    for (auto& result : results) {
+        all_equal = all_equal && result.pools[0].miners[0].blocks_received == first;
+    }
+    ASSERT_FALSE(all_equal);
+}
+
+TEST(ReplicaRunner, philox_threads) {
+    auto simulation = get_sample_simulation();
+    simulation.rng = "philox";
+
+    ReplicaRunner runner(simulation, 4, 4);
+    runner.run(false);
+    ASSERT_TRUE(runner.check_single_thread());
+    auto& results = runner.get_results();
+    ASSERT_NE(results[0].pools[0].luck, results[1].pools[0].luck);
+}
+
+Simulation get_sweep_simulation() {
+    auto simulation_json = nlohmann::json::parse(simulation_string);
+    simulation_json["pools"][0]["miners"][0]["generator"] = "random";
+    simulation_json["pools"][0]["miners"][0]["params"] = random_miners_params;
+    simulation_json["sweep"] = R"({"axes": [
+        {"path": "/pools/0/uncle_block_prob", "values": [0.0, 0.5]},
+        {"path": "/pools/0/difficulty", "grid": {"start": 10, "stop": 30, "step": 10}}
+    ]})"_json;
+    return simulation_json.get<Simulation>();
+}
+
+TEST(Sweep, expand_sweep) {
+    auto simulation = get_sweep_simulation();
+    ASSERT_EQ(simulation.sweep.size(), 2);
+    ASSERT_EQ(simulation.sweep[1].values, std::vector<nlohmann::json>({10, 20, 30}));
+
+    auto points = expand_sweep(simulation);
+    ASSERT_EQ(points.size(), 6);
+    ASSERT_EQ(points[4].index, 4);
+    ASSERT_EQ(points[4].parameters["/pools/0/uncle_block_prob"], 0.5);
+    ASSERT_EQ(points[4].parameters["/pools/0/difficulty"], 20);
+    ASSERT_EQ(points[4].simulation.pools[0].difficulty, 20);
+    ASSERT_FLOAT_EQ(points[4].simulation.pools[0].uncle_block_prob, 0.5);
+    ASSERT_TRUE(points[4].simulation.sweep.empty());
+
+    simulation.sweep[0].path = "/pools/0/unknown/key";
+    ASSERT_THROW(expand_sweep(simulation), std::invalid_argument);
+}
+
+TEST(Sweep, run) {
+    auto simulation = get_sweep_simulation();
+    SweepRunner runner(simulation, 3);
+    runner.run();
+    // the miners are not swept, so they are generated once
+    ASSERT_EQ(runner.get_populations_count(), 1);
+    auto output = runner.get_output();
+    ASSERT_EQ(output["axes"].size(), 2);
+    ASSERT_EQ(output["points"].size(), 6);
+    ASSERT_EQ(output["points"][5]["parameters"]["/pools/0/difficulty"], 30);
+    ASSERT_EQ(output["points"][5]["result"]["miners"].size(), 100);
+    ASSERT_EQ(output["points"][5]["result"]["miners"][0]["address"],
+              output["points"][0]["result"]["miners"][0]["address"]);
+
+    SweepRunner single_thread(simulation, 1);
+    single_thread.run();
+    auto single_thread_output = single_thread.get_output();
+    for (size_t i = 0; i < 6; i++) {
+        ASSERT_EQ(output["points"][i]["result"]["blocks"], single_thread_output["points"][i]["result"]["blocks"]);
+    }
+}
+
+TEST(Sweep, standalone_point) {
+    // multiple addresses miners draw their addresses between the miners of the two pools
+    for (const std::string& rng : std::vector<std::string>{"drand48", "philox"}) {
+        auto config = get_two_pool_config("per_miner", rng, true);
+        config["sweep"] = R"({"axes": [{"path": "/pools/1/difficulty", "values": [10, 20]}]})"_json;
+        SweepRunner runner(config.get<Simulation>(), 2);
+        runner.run();
+        ASSERT_EQ(runner.get_populations_count(), 1);
+        auto output = runner.get_output();
+
+        for (const SweepPoint& point : runner.get_points()) {
+            auto standalone = Simulator::from_simulation(point.simulation);
+            standalone->run();
+            auto expected = standalone->get_result();
+            auto result = output["points"][point.index]["result"];
+            expected.erase("runtime_milliseconds");
+            result.erase("runtime_milliseconds");
+            ASSERT_EQ(result, expected) << rng;
+        }
+    }
+}
+
+#ifdef USE_SQLITE3
+TEST(ResultStore, append) {
+    const std::string path = "store_test.sqlite";
+    auto simulation = get_sample_simulation();
+    simulation.store = path;
+    // replicas append from several threads at once
+    ReplicaRunner replicas(simulation, 8, 4);
+    replicas.run(false);
+    auto sweep_simulation = get_sweep_simulation();
+    sweep_simulation.store = path;
+    SweepRunner sweep(sweep_simulation, 3);
+    sweep.run();
+
+    ResultStore store(path);
+    auto runs = store.query("SELECT r.replica, r.seed, r.config_hash, p.luck FROM runs r "
+                            "JOIN pools p ON p.run_id = r.id WHERE r.replica IS NOT NULL ORDER BY r.replica");
+    ASSERT_EQ(runs.size(), 8);
+    for (size_t i = 0; i < runs.size(); i++) {
+        ASSERT_EQ(runs[i]["replica"], i);
+        ASSERT_EQ(runs[i]["seed"], std::to_string(replicas.get_results()[i].seed));
+        ASSERT_EQ(runs[i]["config_hash"], get_config_hash(simulation.config));
+        ASSERT_DOUBLE_EQ(runs[i]["luck"].get<double>(), replicas.get_results()[i].pools[0].luck);
+    }
+    auto miners = store.query("SELECT SUM(miners) AS miners FROM behaviors GROUP BY run_id");
+    ASSERT_EQ(miners.size(), 8 + 6);
+    for (auto& run : miners) {
+        ASSERT_EQ(run["miners"], 100);
+    }
+
+    // the points are found by their parameters
+    auto points = store.query("SELECT p.value AS difficulty, COUNT(*) AS runs, AVG(b.blocks_ratio) AS blocks_ratio "
+                              "FROM behaviors b JOIN parameters p ON p.run_id = b.run_id "
+                              "AND p.path = '/pools/0/difficulty' GROUP BY p.value ORDER BY p.value");
+    ASSERT_EQ(points.size(), 3);
+    ASSERT_EQ(points[0]["difficulty"], 10);
+    ASSERT_EQ(points[2]["runs"], 2);
+    ASSERT_TRUE(points[2]["blocks_ratio"].is_number());
+    ASSERT_EQ(store.query("SELECT COUNT(DISTINCT config_hash) AS configs FROM runs")[0]["configs"], 1 + 6);
+    ASSERT_THROW(store.query("SELECT unknown FROM runs"), std::invalid_argument);
+
+    for (auto suffix : {"", "-wal", "-shm"}) {
+        std::remove((path + suffix).c_str());
+    }
+}
+#endif
+
+TEST(ThreadPool, submit) {
+    std::vector<std::future<size_t>> futures;
+    std::vector<std::future<size_t>> nested_futures(100);
+    {
+        ThreadPool pool(4);
+        ASSERT_EQ(pool.size(), 4);
+        for (size_t i = 0; i < 100; i++) {
+            futures.push_back(pool.submit([i, &pool, &nested_futures]() {
+                // tasks submitted from a worker go to its own queue
+                nested_futures[i] = pool.submit([i]() { return 2 * i; });
+                return i;
+            }));
+        }
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        ASSERT_EQ(futures[i].get(), i);
+        ASSERT_EQ(nested_futures[i].get(), 2 * i);
+    }
+    ThreadPool pool(2);
+    auto failing = pool.submit([]() -> int { throw std::runtime_error("failed"); });
+    ASSERT_THROW(failing.get(), std::runtime_error);
+}
+
+TEST(SummaryStatistics, mean_stddev) {
+    SummaryStatistics statistics;
+    for (double value : {2, 4, 4, 4, 5, 5, 7, 9}) {
+        statistics.add(value);
+    }
+    ASSERT_EQ(statistics.get_count(), 8);
+    ASSERT_FLOAT_EQ(statistics.get_mean(), 5);
+    ASSERT_FLOAT_EQ(statistics.get_stddev(), std::sqrt(32.0 / 7));
+    ASSERT_FLOAT_EQ(statistics.get_ci95(), 1.96 * std::sqrt(32.0 / 7) / std::sqrt(8));
+}
+
 TEST(MinerCreatorStopCondition, TotalHashrate) {
     auto args = R"({"value": 20})"_json;
     auto cond = MinerCreatorStopConditionFactory::create("total_hashrate", args);
@@ -793,7 +2155,7 @@ TEST(MinerCreator, RandomMinerCreator) {
             "params": {"value": 100}
         }
     })"_json;
-    auto creator = MinerCreatorFactory::create("random", get_sample_network());
+    auto creator = MinerCreatorFactory::create("random", get_sample_network(), get_sample_random());
     auto miners = creator->create_miners(args);
     ASSERT_EQ(miners.size(), 100);
 
@@ -814,7 +2176,7 @@ TEST(MinerCreator, CSVMinerCreator) {
         "behavior": {"name": "default", "params": {}},
         "path": "fixtures/sample_miners.csv"
     })"_json;
-    auto creator = MinerCreatorFactory::create("csv", get_sample_network());
+    auto creator = MinerCreatorFactory::create("csv", get_sample_network(), get_sample_random());
     auto miners = creator->create_miners(args);
     ASSERT_EQ(miners.size(), 3);
     ASSERT_FLOAT_EQ(miners[0]->get_hashrate(), 1);
@@ -831,7 +2193,7 @@ TEST(MinerCreator, InlineMinerCreator) {
              "hashrate": 10}
         ]
     })"_json;
-    auto creator = MinerCreatorFactory::create("inline", get_sample_network());
+    auto creator = MinerCreatorFactory::create("inline", get_sample_network(), get_sample_random());
     auto miners = creator->create_miners(args);
     ASSERT_EQ(miners.size(), 2);
     ASSERT_EQ(miners[0]->get_handler_name(), "default");
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <CLI11.hpp>
+
+#include "columnar.h"
+
+using poolsim::ColumnarFile;
+
+
+// Quotes the value if needed to be a CSV field
+static std::string quote(const std::string& value) {
+  if (value.find_first_of(",\"\n") == std::string::npos) {
+    return value;
+  }
+  std::string result = "\"";
+  for (char c : value) {
+    if (c == '"') {
+      result.push_back('"');
+    }
+    result.push_back(c);
+  }
+  result.push_back('"');
+  return result;
+}
+
+static void list_columns(const ColumnarFile& file) {
+  for (auto& name : file.get_column_names()) {
+    std::cout << name << " " << poolsim::get_column_type_name(file.get_column_type(name))
+              << " " << file.get_rows(name) << std::endl;
+  }
+}
+
+// Prints the columns named `table.*` as CSV, with the addresses decoded
+static void print_table(const ColumnarFile& file, const std::string& table) {
+  std::string prefix = table + ".";
+  std::vector<std::string> columns;
+  for (auto& name : file.get_column_names()) {
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+      columns.push_back(name);
+    }
+  }
+  if (columns.empty()) {
+    throw std::invalid_argument("no table " + table);
+  }
+
+  for (size_t i = 0; i < columns.size(); i++) {
+    std::cout << (i > 0 ? "," : "") << columns[i].substr(prefix.size());
+  }
+  std::cout << "\n";
+  uint64_t rows = file.get_rows(columns[0]);
+  for (uint64_t row = 0; row < rows; row++) {
+    for (size_t i = 0; i < columns.size(); i++) {
+      std::cout << (i > 0 ? "," : "") << quote(file.format_value(columns[i], row));
+    }
+    std::cout << "\n";
+  }
+}
+
+static void print_column(const ColumnarFile& file, const std::string& column) {
+  for (uint64_t row = 0; row < file.get_rows(column); row++) {
+    std::cout << file.format_value(column, row) << "\n";
+  }
+}
+
+
+int main(int argc, char* argv[]) {
+  CLI::App app("poolsim-dump: prints the content of a columnar result file");
+  std::string input, table, column;
+  app.add_option("-i,--input", input, "columnar result file (.psc)")
+     ->required()
+     ->check(CLI::ExistingFile);
+  app.add_option("--table", table, "print the table (blocks, pools, pool_miners or miners) as CSV");
+  app.add_option("--column", column, "print the values of the column, one per line");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    return app.exit(e);
+  }
+
+  try {
+    ColumnarFile file(input);
+    if (!table.empty()) {
+      print_table(file, table);
+    } else if (!column.empty()) {
+      print_column(file, column);
+    } else {
+      list_columns(file);
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
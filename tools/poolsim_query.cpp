@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string>
+
+#include <CLI11.hpp>
+#include <nlohmann/json.hpp>
+
+#include "result_index.h"
+
+using poolsim::IndexedResult;
+
+
+int main(int argc, char* argv[]) {
+  CLI::App app("poolsim-query: reads the entries of a miner or a pool from an indexed result");
+  std::string input, index_path, address, pool;
+  bool entries = false;
+  app.add_option("-i,--input", input, "json result file, possibly compressed")
+     ->required()
+     ->check(CLI::ExistingFile);
+  app.add_option("--index", index_path, "index of the result, next to it by default");
+  app.add_option("--address", address, "print the blocks and work per block of the miner");
+  app.add_option("--pool", pool, "print the entry of the pool");
+  app.add_flag("--entries", entries, "print the entries of the miner instead of its aggregates");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    return app.exit(e);
+  }
+  if (address.empty() == pool.empty()) {
+    std::cerr << "either --address or --pool is required" << std::endl;
+    return 1;
+  }
+
+  try {
+    IndexedResult result(input, index_path.empty() ? poolsim::get_index_path(input) : index_path);
+    if (!pool.empty()) {
+      nlohmann::json entry = result.get_pool(pool);
+      if (entry.is_null()) {
+        std::cerr << "pool " << pool << " does not exist" << std::endl;
+        return 1;
+      }
+      std::cout << entry.dump() << std::endl;
+    } else if (entries) {
+      nlohmann::json miner_entries = {
+        {"miner", result.get_miner(address)},
+        {"records", result.get_records(address)}
+      };
+      std::cout << miner_entries.dump() << std::endl;
+    } else {
+      std::cout << result.get_miner_info(address).dump() << std::endl;
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}